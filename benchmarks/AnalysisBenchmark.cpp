@@ -0,0 +1,388 @@
+// Measures the function distance, basic block distance and DAFL analyses on
+// generated modules of increasing size. Each measurement runs in a forked
+// process, which reports the wall time and the number of allocations of the
+// analysis; its peak resident set size is read when it exits. Target detection
+// and the call graph are computed before the measurement starts, while the
+// pointer analysis is part of the DAFL measurement.
+
+#include <Analysis/BasicBlockDistance.hpp>
+#include <Analysis/CompactCallGraph.hpp>
+#include <Analysis/DAFL.hpp>
+#include <Analysis/DistanceCache.hpp>
+#include <Analysis/DistanceFile.hpp>
+#include <Analysis/ExtendedCallGraph.hpp>
+#include <Analysis/FunctionDistance.hpp>
+#include <Analysis/PointerAnalysis.hpp>
+#include <Analysis/TargetDetection.hpp>
+
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace llvm;
+
+enum class BenchmarkedAnalysis { FunctionDistance, BBDistance, DAFL };
+
+static cl::list<BenchmarkedAnalysis> ClAnalyses(
+    "analyses", cl::desc("Analyses to measure (default: all)"),
+    cl::values(
+        clEnumValN(BenchmarkedAnalysis::FunctionDistance, "function-distance",
+                   "AFLGoFunctionDistanceAnalysis"),
+        clEnumValN(BenchmarkedAnalysis::BBDistance, "bb-distance",
+                   "AFLGoBasicBlockDistanceAnalysis, for all functions"),
+        clEnumValN(BenchmarkedAnalysis::DAFL, "dafl", "DAFLAnalysis")),
+    cl::CommaSeparated);
+
+static cl::list<unsigned int>
+    ClFunctions("functions",
+                cl::desc("Numbers of functions of the generated modules "
+                         "(default: 100,1000,10000)"),
+                cl::CommaSeparated);
+
+static cl::opt<unsigned int>
+    ClBlocks("blocks", cl::desc("Number of basic blocks per function"),
+             cl::init(20));
+
+static cl::opt<unsigned int>
+    ClSuccessors("successors",
+                 cl::desc("Number of successors per basic block"),
+                 cl::init(2));
+
+static cl::opt<unsigned int>
+    ClCalls("calls", cl::desc("Number of calls per function"), cl::init(4));
+
+static cl::opt<unsigned int> ClTargets("targets",
+                                       cl::desc("Number of target blocks"),
+                                       cl::init(4));
+
+static cl::opt<bool> ClHawkeyeDistance("hawkeye",
+                                       cl::desc("Use the Hawkeye distance"),
+                                       cl::init(false));
+
+static cl::opt<unsigned int> ClDistanceThreads(
+    "distance-threads",
+    cl::desc("Number of threads used to compute distances (0 uses all "
+             "available threads)"),
+    cl::init(1));
+
+static cl::opt<unsigned int> ClSeed("seed", cl::desc("Random seed"),
+                                    cl::init(0));
+
+// Allocations through the malloc family, which operator new uses as well.
+// Only counted with glibc, where the real allocator can be called directly.
+static std::atomic<uint64_t> Allocations{0};
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t Size);
+void *__libc_calloc(size_t Count, size_t Size);
+void *__libc_realloc(void *Ptr, size_t Size);
+
+void *malloc(size_t Size) noexcept {
+  Allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(Size);
+}
+
+void *calloc(size_t Count, size_t Size) noexcept {
+  Allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(Count, Size);
+}
+
+void *realloc(void *Ptr, size_t Size) noexcept {
+  Allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(Ptr, Size);
+}
+}
+#endif
+
+// Functions with random branches between their blocks, as in the basic block
+// distance benchmark. Each block loads a global, which the branches and calls
+// depend on, so that the pointer analysis has some data flow to follow.
+static std::unique_ptr<Module> generateModule(LLVMContext &C,
+                                              unsigned int NumFunctions,
+                                              std::mt19937 &Rand) {
+  auto M = std::make_unique<Module>("analysis-benchmark", C);
+  auto *Int32Ty = Type::getInt32Ty(C);
+  auto *FTy = FunctionType::get(Type::getVoidTy(C), {Int32Ty}, false);
+  auto *Global =
+      new GlobalVariable(*M, Int32Ty, false, GlobalValue::ExternalLinkage,
+                         ConstantInt::get(Int32Ty, 0), "g");
+  auto TargetFn = M->getOrInsertFunction(
+      AFLGoTargetDetectionAnalysis::TargetFunctionName, Type::getVoidTy(C),
+      Int32Ty);
+
+  SmallVector<Function *, 0> Functions;
+  for (unsigned int Idx = 0; Idx < NumFunctions; ++Idx) {
+    Functions.push_back(Function::Create(FTy, GlobalValue::ExternalLinkage,
+                                         formatv("f{0}", Idx), *M));
+  }
+
+  std::uniform_int_distribution<unsigned int> BlockDist(0, ClBlocks - 1);
+  // The entry block cannot have predecessors.
+  std::uniform_int_distribution<unsigned int> SuccDist(
+      1, std::max(ClBlocks - 1, 1U));
+  std::uniform_int_distribution<unsigned int> FunctionDist(0, NumFunctions - 1);
+  SmallVector<LoadInst *, 0> Loads;
+  for (auto *F : Functions) {
+    SmallVector<BasicBlock *, 0> Blocks;
+    for (unsigned int Block = 0; Block < ClBlocks; ++Block) {
+      Blocks.push_back(BasicBlock::Create(C, "", F));
+    }
+
+    SmallVector<LoadInst *, 0> FunctionLoads;
+    for (unsigned int Block = 0; Block < ClBlocks; ++Block) {
+      IRBuilder<> IRB(Blocks[Block]);
+      auto *Load = IRB.CreateLoad(Int32Ty, Global);
+      FunctionLoads.push_back(Load);
+      Loads.push_back(Load);
+
+      if (Block + 1 == ClBlocks) {
+        IRB.CreateRetVoid();
+        continue;
+      }
+
+      // Block I always branches to block I + 1, so every block is reachable
+      // from the entry.
+      auto *Switch = IRB.CreateSwitch(Load, Blocks[Block + 1], ClSuccessors);
+      for (unsigned int Succ = 1; Succ < ClSuccessors; ++Succ) {
+        Switch->addCase(IRB.getInt32(Succ), Blocks[SuccDist(Rand)]);
+      }
+    }
+
+    for (unsigned int Call = 0; Call < ClCalls; ++Call) {
+      auto *Load = FunctionLoads[BlockDist(Rand)];
+      IRBuilder<> IRB(Load->getNextNode());
+      IRB.CreateCall(FTy, Functions[FunctionDist(Rand)], {Load});
+    }
+  }
+
+  // Targets look like the ones injected by the compiler pass: a call to the
+  // target function and an annotated instruction in the same block.
+  std::uniform_int_distribution<size_t> LoadDist(0, Loads.size() - 1);
+  DenseSet<LoadInst *> TargetLoads;
+  while (TargetLoads.size() < std::min<size_t>(ClTargets, Loads.size())) {
+    TargetLoads.insert(Loads[LoadDist(Rand)]);
+  }
+  for (auto *Load : TargetLoads) {
+    IRBuilder<> IRB(Load->getNextNode());
+    IRB.CreateCall(TargetFn, {IRB.getInt32(0)});
+    Load->addAnnotationMetadata(
+        AFLGoTargetDetectionAnalysis::TargetInstructionAnnotation);
+  }
+
+  return M;
+}
+
+// Peak resident set size of this process so far, in kilobytes
+static uint64_t getPeakRSS() {
+  auto *Status = fopen("/proc/self/status", "r");
+  if (!Status) {
+    return 0;
+  }
+
+  char Line[256];
+  uint64_t PeakRSS = 0;
+  while (fgets(Line, sizeof(Line), Status)) {
+    if (strncmp(Line, "VmHWM:", 6) == 0) {
+      PeakRSS = strtoull(Line + 6, nullptr, 10);
+      break;
+    }
+  }
+  fclose(Status);
+  return PeakRSS;
+}
+
+struct Measurement {
+  double WallMs;
+  uint64_t Allocations;
+  // Peak resident set size before the analysis runs, in kilobytes
+  uint64_t ModuleRSS;
+};
+
+static Measurement measure(BenchmarkedAnalysis Analysis,
+                           unsigned int NumFunctions) {
+  LLVMContext C;
+  std::mt19937 Rand(ClSeed);
+  auto M = generateModule(C, NumFunctions, Rand);
+
+  LoopAnalysisManager LAM;
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+
+  FAM.registerPass([] { return AFLGoTargetDetectionAnalysis(); });
+  MAM.registerPass([] {
+    return DAFLAnalysis("", /*NoTargetsNoError=*/false, /*DebugFiles=*/false,
+                        /*Verbose=*/false);
+  });
+  MAM.registerPass([] { return SVFPointerAnalysis(/*Verbose=*/false); });
+  MAM.registerPass([] { return ExtendedCallGraphAnalysis(); });
+  MAM.registerPass(
+      [] { return CompactCallGraphAnalysis(/*UseExtendedCG=*/false); });
+  MAM.registerPass([] { return DistanceCacheAnalysis(); });
+  MAM.registerPass([] { return DistanceFileAnalysis(); });
+  MAM.registerPass([] {
+    return AFLGoFunctionDistanceAnalysis(ClHawkeyeDistance, ClDistanceThreads);
+  });
+  MAM.registerPass([] { return AFLGoBasicBlockDistanceAnalysis(); });
+
+  PassBuilder PB;
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  for (auto &F : *M) {
+    FAM.getResult<AFLGoTargetDetectionAnalysis>(F);
+  }
+  if (Analysis != BenchmarkedAnalysis::DAFL) {
+    MAM.getResult<CompactCallGraphAnalysis>(*M);
+  }
+  if (Analysis == BenchmarkedAnalysis::BBDistance) {
+    MAM.getResult<AFLGoFunctionDistanceAnalysis>(*M);
+  }
+
+  Measurement Result;
+  Result.ModuleRSS = getPeakRSS();
+  auto AllocationsBefore = Allocations.load();
+  auto Start = std::chrono::steady_clock::now();
+
+  switch (Analysis) {
+  case BenchmarkedAnalysis::FunctionDistance:
+    MAM.getResult<AFLGoFunctionDistanceAnalysis>(*M);
+    break;
+  case BenchmarkedAnalysis::BBDistance: {
+    auto &BBDistances = MAM.getResult<AFLGoBasicBlockDistanceAnalysis>(*M);
+    for (auto &F : *M) {
+      if (!F.isDeclaration()) {
+        BBDistances.computeBBDistances(F);
+      }
+    }
+    break;
+  }
+  case BenchmarkedAnalysis::DAFL:
+    MAM.getResult<DAFLAnalysis>(*M);
+    break;
+  }
+
+  auto End = std::chrono::steady_clock::now();
+  Result.WallMs =
+      std::chrono::duration<double, std::milli>(End - Start).count();
+  Result.Allocations = Allocations.load() - AllocationsBefore;
+  return Result;
+}
+
+static StringRef getName(BenchmarkedAnalysis Analysis) {
+  switch (Analysis) {
+  case BenchmarkedAnalysis::FunctionDistance:
+    return "function-distance";
+  case BenchmarkedAnalysis::BBDistance:
+    return "bb-distance";
+  case BenchmarkedAnalysis::DAFL:
+    return "dafl";
+  }
+  llvm_unreachable("unknown analysis");
+}
+
+// Runs a measurement in a child process, so that its peak resident set size is
+// not affected by the previous ones. Returns false if the child failed.
+static bool measureInChild(BenchmarkedAnalysis Analysis,
+                           unsigned int NumFunctions) {
+  int Pipe[2];
+  if (pipe(Pipe) != 0) {
+    errs() << "could not create a pipe: " << strerror(errno) << '\n';
+    return false;
+  }
+
+  outs().flush();
+  auto Pid = fork();
+  if (Pid < 0) {
+    errs() << "could not fork: " << strerror(errno) << '\n';
+    return false;
+  }
+
+  if (Pid == 0) {
+    close(Pipe[0]);
+    auto Result = measure(Analysis, NumFunctions);
+    auto Written = write(Pipe[1], &Result, sizeof(Result));
+    _exit(Written == sizeof(Result) ? 0 : 1);
+  }
+
+  close(Pipe[1]);
+  Measurement Result;
+  auto Read = read(Pipe[0], &Result, sizeof(Result));
+  close(Pipe[0]);
+
+  int Status;
+  struct rusage Usage;
+  if (wait4(Pid, &Status, 0, &Usage) != Pid || !WIFEXITED(Status) ||
+      WEXITSTATUS(Status) != 0 || Read != sizeof(Result)) {
+    errs() << formatv("{0} failed on {1} functions\n", getName(Analysis),
+                      NumFunctions);
+    return false;
+  }
+
+  // ru_maxrss is in kilobytes on Linux.
+  outs() << formatv("{0},{1},{2},{3},{4},{5},{6:f2},{7},{8},{9}\n",
+                    getName(Analysis), NumFunctions, ClBlocks, ClSuccessors,
+                    ClCalls, ClTargets, Result.WallMs, Usage.ru_maxrss,
+                    Result.ModuleRSS, Result.Allocations);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "Distance analyses benchmark\n");
+
+  if (ClBlocks < 1 || ClSuccessors < 1 || ClTargets < 1) {
+    errs() << "at least 1 block, 1 successor and 1 target are needed\n";
+    return 1;
+  }
+
+  SmallVector<BenchmarkedAnalysis, 3> Analyses(ClAnalyses.begin(),
+                                               ClAnalyses.end());
+  if (Analyses.empty()) {
+    Analyses = {BenchmarkedAnalysis::FunctionDistance,
+                BenchmarkedAnalysis::BBDistance, BenchmarkedAnalysis::DAFL};
+  }
+
+  SmallVector<unsigned int, 8> Sweep(ClFunctions.begin(), ClFunctions.end());
+  if (Sweep.empty()) {
+    Sweep = {100, 1000, 10000};
+  }
+  if (is_contained(Sweep, 0u)) {
+    errs() << "at least 1 function is needed\n";
+    return 1;
+  }
+
+  outs() << "analysis,functions,blocks,successors,calls,targets,wall_ms,"
+            "peak_rss_kb,module_rss_kb,allocations\n";
+
+  auto Failures = 0;
+  for (auto Analysis : Analyses) {
+    for (auto NumFunctions : Sweep) {
+      if (!measureInChild(Analysis, NumFunctions)) {
+        ++Failures;
+      }
+    }
+  }
+
+  return Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+// Compares the basic block distance engine with the original per-origin
+// breadth-first search on large generated CFGs, and checks that both produce
+// the same distances.
+
+#include <Analysis/BasicBlockDistance.hpp>
+
+#include <llvm/ADT/BreadthFirstIterator.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<unsigned int> ClFunctions("functions",
+                                         cl::desc("Number of functions"),
+                                         cl::init(8));
+
+static cl::opt<unsigned int>
+    ClBlocks("blocks", cl::desc("Number of basic blocks per function"),
+             cl::init(5000));
+
+static cl::opt<unsigned int>
+    ClFanOut("fan-out", cl::desc("Number of successors per basic block"),
+             cl::init(3));
+
+static cl::opt<unsigned int>
+    ClOrigins("origins", cl::desc("Number of origin blocks per function"),
+              cl::init(200));
+
+static cl::opt<unsigned int> ClSeed("seed", cl::desc("Random seed"),
+                                    cl::init(0));
+
+using BBToDistanceTy = BBDistanceEngine::BBToDistanceTy;
+
+// Function with random branches between its blocks. Block I always branches
+// to block I + 1, so every block is reachable from the entry.
+static Function *generateFunction(Module &M, unsigned int Idx,
+                                  std::mt19937 &Rand) {
+  auto &C = M.getContext();
+  auto *Int32Ty = Type::getInt32Ty(C);
+  auto *FTy = FunctionType::get(Type::getVoidTy(C), {Int32Ty}, false);
+  auto *F = Function::Create(FTy, GlobalValue::ExternalLinkage,
+                             formatv("f{0}", Idx), M);
+
+  SmallVector<BasicBlock *, 0> Blocks;
+  for (unsigned int Block = 0; Block < ClBlocks; ++Block) {
+    Blocks.push_back(BasicBlock::Create(C, "", F));
+  }
+
+  std::uniform_int_distribution<unsigned int> BlockDist(0, ClBlocks - 1);
+  for (unsigned int Block = 0; Block < ClBlocks; ++Block) {
+    IRBuilder<> IRB(Blocks[Block]);
+    if (Block + 1 == ClBlocks) {
+      IRB.CreateRetVoid();
+      continue;
+    }
+
+    auto *Switch =
+        IRB.CreateSwitch(F->getArg(0), Blocks[Block + 1], ClFanOut - 1);
+    for (unsigned int Succ = 1; Succ < ClFanOut; ++Succ) {
+      Switch->addCase(IRB.getInt32(Succ), Blocks[BlockDist(Rand)]);
+    }
+  }
+
+  return F;
+}
+
+static BBToDistanceTy generateOrigins(Function &F, std::mt19937 &Rand) {
+  SmallVector<BasicBlock *, 0> Blocks;
+  for (auto &BB : F) {
+    Blocks.push_back(&BB);
+  }
+
+  // Same shape as real distances: targets are 0, calls are multiples of the
+  // function distance magnification factor.
+  std::uniform_int_distribution<unsigned int> BlockDist(0, Blocks.size() - 1);
+  std::uniform_int_distribution<unsigned int> DistanceDist(0, 20);
+  BBToDistanceTy OriginBBs;
+  while (OriginBBs.size() < std::min<size_t>(ClOrigins, Blocks.size())) {
+    OriginBBs[Blocks[BlockDist(Rand)]] = DistanceDist(Rand) * 10.0;
+  }
+
+  return OriginBBs;
+}
+
+// The original implementation, with one inverse breadth-first search per
+// origin and the distances of each block collected in a vector.
+static BBToDistanceTy computeReference(const BBToDistanceTy &OriginBBs) {
+  auto DistanceMap = BBToDistanceTy();
+  std::map<BasicBlock *, std::vector<double>> DistancesFromOrigins;
+  for (auto &OriginBBPair : OriginBBs) {
+    auto *OriginBB = OriginBBPair.first;
+    auto OriginBBDistance = OriginBBPair.second;
+    DistanceMap[OriginBB] = OriginBBDistance;
+
+    auto InverseOriginBB = static_cast<Inverse<BasicBlock *>>(OriginBB);
+    for (auto BFIter = bf_begin(InverseOriginBB);
+         BFIter != bf_end(InverseOriginBB); ++BFIter) {
+      if (OriginBBs.find(*BFIter) != OriginBBs.end()) {
+        continue;
+      }
+
+      DistancesFromOrigins[*BFIter].push_back(OriginBBDistance +
+                                              BFIter.getLevel());
+    }
+  }
+
+  for (auto &DistancesFromOriginPair : DistancesFromOrigins) {
+    auto &Distances = DistancesFromOriginPair.second;
+
+    double HarmonicMean = 0;
+    for (auto Distance : Distances) {
+      HarmonicMean += 1.0 / Distance;
+    }
+    HarmonicMean = Distances.size() / HarmonicMean;
+
+    DistanceMap[DistancesFromOriginPair.first] = HarmonicMean;
+  }
+
+  return DistanceMap;
+}
+
+template <typename FnTy> static double measureMs(FnTy Fn) {
+  auto Start = std::chrono::steady_clock::now();
+  Fn();
+  auto End = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(End - Start).count();
+}
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Basic block distance engine benchmark\n");
+
+  if (ClBlocks < 2 || ClFanOut < 1) {
+    errs() << "at least 2 blocks and 1 successor are needed\n";
+    return 1;
+  }
+
+  LLVMContext C;
+  Module M("bb-distance-benchmark", C);
+  std::mt19937 Rand(ClSeed);
+
+  SmallVector<std::pair<Function *, BBToDistanceTy>, 0> Functions;
+  for (unsigned int Idx = 0; Idx < ClFunctions; ++Idx) {
+    auto *F = generateFunction(M, Idx, Rand);
+    Functions.push_back({F, generateOrigins(*F, Rand)});
+  }
+
+  std::vector<BBToDistanceTy> ReferenceResults;
+  auto ReferenceMs = measureMs([&] {
+    for (auto &FunctionOrigins : Functions) {
+      ReferenceResults.push_back(computeReference(FunctionOrigins.second));
+    }
+  });
+
+  BBDistanceEngine Engine;
+  std::vector<BBToDistanceTy> EngineResults;
+  auto EngineMs = measureMs([&] {
+    for (auto &FunctionOrigins : Functions) {
+      EngineResults.push_back(
+          Engine.compute(*FunctionOrigins.first, FunctionOrigins.second));
+    }
+  });
+
+  auto Mismatches = 0;
+  for (unsigned int Idx = 0; Idx < Functions.size(); ++Idx) {
+    auto &Reference = ReferenceResults[Idx];
+    auto &Result = EngineResults[Idx];
+    if (Reference.size() != Result.size()) {
+      ++Mismatches;
+      continue;
+    }
+
+    for (auto &DistanceEntry : Reference) {
+      auto It = Result.find(DistanceEntry.first);
+      if (It == Result.end() || It->second != DistanceEntry.second) {
+        ++Mismatches;
+        break;
+      }
+    }
+  }
+
+  outs() << "functions,blocks,fan_out,origins,reference_ms,engine_ms,speedup,"
+            "mismatches\n";
+  outs() << formatv("{0},{1},{2},{3},{4:f2},{5:f2},{6:f2},{7}\n", ClFunctions,
+                    ClBlocks, ClFanOut, ClOrigins, ReferenceMs, EngineMs,
+                    ReferenceMs / EngineMs, Mismatches);
+
+  return Mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+
+"""Compares dense and sparse distance probes on the test harnesses: builds each
+harness in both modes, reporting how many probes sparse placement removes, and
+fuzzes each build for a while, reporting the executions per second."""
+
+import os
+import re
+import subprocess
+import sys
+import tempfile
+from argparse import ArgumentParser
+from pathlib import Path
+
+TEST_DIR = Path(__file__).resolve().parent.parent / "test"
+
+TARGET_RE = re.compile(r"%s:(\d+)")
+PROBES_RE = re.compile(r"sparse distance probes: (\d+) probes for (\d+) basic blocks")
+EXECS_RE = re.compile(r"exec/sec: ([0-9.]+)([kMG]?)")
+EXECS_SCALE = {"": 1, "k": 1e3, "M": 1e6, "G": 1e9}
+
+
+def get_targets(harness: Path):
+    # Targets are set by the first RUN line of each harness.
+    for line in harness.read_text().splitlines():
+        if line.startswith("// RUN:") and "targets.txt" in line:
+            return [f"{harness}:{number}" for number in TARGET_RE.findall(line)]
+    return []
+
+
+def build(cc: Path, harness: Path, output: Path, targets: Path, sparse: bool):
+    env = dict(os.environ)
+    env["AFLGO_TARGETS"] = str(targets)
+    env["AFLGO_SPARSE_DISTANCE_PROBES"] = "1" if sparse else "0"
+    result = subprocess.run(
+        [sys.executable, str(cc), str(harness), "-o", str(output)],
+        env=env,
+        stderr=subprocess.PIPE,
+        text=True,
+        check=True,
+    )
+
+    match = PROBES_RE.search(result.stderr)
+    return (int(match[1]), int(match[2])) if match else None
+
+
+def fuzz(binary: Path, work_dir: Path, seconds: int):
+    input_dir = work_dir / "input"
+    input_dir.mkdir(exist_ok=True)
+    (input_dir / "yolo.txt").write_text("yolo\n")
+    output_dir = work_dir / f"output-{binary.name}"
+    log = work_dir / f"{binary.name}.log"
+
+    subprocess.run(
+        ["timeout", "--preserve-status", f"{seconds}s", str(binary)]
+        + ["-i", str(input_dir), "-o", str(output_dir), "-l", str(log)],
+        stdout=subprocess.DEVNULL,
+        stderr=subprocess.DEVNULL,
+    )
+
+    # The last report covers the whole run.
+    matches = EXECS_RE.findall(log.read_text()) if log.exists() else []
+    if not matches:
+        return None
+    value, suffix = matches[-1]
+    return float(value) * EXECS_SCALE[suffix]
+
+
+def main():
+    parser = ArgumentParser(description=__doc__)
+    parser.add_argument("cc", type=Path, help="libaflgo_aflgo_cc wrapper")
+    parser.add_argument(
+        "--seconds", type=int, default=10, help="fuzzing time of each build"
+    )
+    parser.add_argument(
+        "harnesses",
+        type=Path,
+        nargs="*",
+        default=sorted(TEST_DIR.glob("harness*.c")),
+    )
+    args = parser.parse_args()
+
+    print("harness,dense_probes,sparse_probes,dense_execs,sparse_execs,speedup")
+    with tempfile.TemporaryDirectory() as tmp:
+        work_dir = Path(tmp)
+        for harness in args.harnesses:
+            targets = work_dir / f"{harness.stem}.targets.txt"
+            targets.write_text("\n".join(get_targets(harness)))
+
+            dense = work_dir / f"{harness.stem}-dense"
+            sparse = work_dir / f"{harness.stem}-sparse"
+            try:
+                build(args.cc, harness, dense, targets, sparse=False)
+                probes = build(args.cc, harness, sparse, targets, sparse=True)
+            except subprocess.CalledProcessError as ex:
+                print(f"{harness.name}: build failed\n{ex.stderr}", file=sys.stderr)
+                continue
+
+            sparse_probes, dense_probes = probes if probes else (0, 0)
+            dense_execs = fuzz(dense, work_dir, args.seconds)
+            sparse_execs = fuzz(sparse, work_dir, args.seconds)
+            speedup = (
+                f"{sparse_execs / dense_execs:.3f}"
+                if dense_execs and sparse_execs
+                else ""
+            )
+            print(
+                f"{harness.name},{dense_probes},{sparse_probes},"
+                f"{dense_execs or ''},{sparse_execs or ''},{speedup}"
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -1,4 +1,4 @@
-//! A singlethreaded libfuzzer-like fuzzer that can auto-restart.
+//! A libfuzzer-like fuzzer that can auto-restart, on one or more cores.
 use mimalloc::MiMalloc;
 #[global_allocator]
 static GLOBAL: MiMalloc = MiMalloc;
@@ -8,6 +8,7 @@ use std::{
     env,
     fs::{self, File, OpenOptions},
     io::{self, Read, Write},
+    net::SocketAddr,
     os::fd::AsRawFd,
     path::{Path, PathBuf},
     process::{self, exit},
@@ -17,26 +18,33 @@ use std::{
 use clap::{Parser, ValueEnum};
 use libafl::{
     bolts::{
+        core_affinity::{CoreId, Cores},
         current_nanos, current_time,
         os::dup2,
         rands::StdRand,
         shmem::{ShMemProvider, StdShMemProvider},
         tuples::{tuple_list, Merge},
-        AsSlice,
+        AsMutSlice, AsSlice,
     },
     corpus::{Corpus, InMemoryOnDiskCorpus, OnDiskCorpus},
-    events::SimpleRestartingEventManager,
-    executors::{inprocess::InProcessExecutor, ExitKind, TimeoutExecutor},
+    events::{
+        launcher::Launcher, EventConfig, HasCustomBufHandlers, LlmpRestartingEventManager,
+        SimpleRestartingEventManager,
+    },
+    executors::{
+        inprocess::{InProcessExecutor, TimeoutInProcessForkExecutor},
+        ExitKind, TimeoutExecutor,
+    },
     feedback_or,
     feedbacks::{CrashFeedback, MaxMapFeedback, TimeFeedback},
     fuzzer::{Fuzzer, StdFuzzer},
     inputs::{BytesInput, HasTargetBytes},
-    monitors::SimpleMonitor,
+    monitors::{MultiMonitor, SimpleMonitor},
     mutators::{
         scheduled::havoc_mutations, token_mutations::I2SRandReplace, tokens_mutations,
         StdMOptMutator, StdScheduledMutator, Tokens,
     },
-    observers::{HitcountsMapObserver, TimeObserver},
+    observers::{HitcountsMapObserver, StdMapObserver, TimeObserver},
     schedulers::{powersched::PowerSchedule, IndexesLenTimeMinimizerScheduler},
     stages::{calibrate::CalibrationStage, StdMutationalStage, TracingStage},
     state::{HasCorpus, HasMetadata, StdState},
@@ -46,15 +54,21 @@ use libafl::{
 use libafl_targets::autotokens;
 use libafl_targets::{
     libfuzzer_initialize, libfuzzer_test_one_input, std_edges_map_observer, CmpLogObserver,
+    EDGES_MAP_PTR, MAX_EDGES_NUM,
 };
 
 use libaflgo::{
-    CoolingSchedule, DistanceFeedback, DistancePowerMutationalStage, DistanceWeightedScheduler,
-    SimilarityFeedback,
+    merge_synced_range, spawn_node_gateway, CoolingSchedule, DistanceFeedback,
+    DistanceFenwickScheduler, DistanceMetadata, DistancePowerMutationalStage,
+    FilteringEventManager, RangeSyncStage, SimilarityFeedback, SimilarityMetadata,
+    TargetsTelemetryFeedback,
 };
 use libaflgo_targets::{
-    distance::InProcessDistanceObserver, similarity::InProcessSimilarityObserver,
-    target::get_targets_map_observer,
+    distance::InProcessDistanceObserver,
+    shared::{share_stats, SharedStats},
+    similarity::InProcessSimilarityObserver,
+    target::{get_shared_targets_map_observer, get_targets_map_observer, target_locations},
+    triage::{self, TriageOrder},
 };
 
 /// LibAFL-based in-process reimplementation of AFLGo
@@ -85,6 +99,52 @@ struct Args {
     #[arg(short = 'D', long)]
     show_target_output: bool,
 
+    /// Runs each input in a forked child process, so that the state of the
+    /// target does not carry over between inputs; requires call probes and
+    /// disables the comparison tracing and Input2State stages
+    #[arg(long)]
+    fork: bool,
+
+    /// Ranks the input seeds by distance to the targets instead of fuzzing, and
+    /// writes the ranking to triage.csv in the output directory
+    #[arg(long)]
+    triage: bool,
+
+    /// Number of forked processes that run the seeds when triaging
+    #[arg(short, long, default_value = "1", requires = "triage")]
+    jobs: usize,
+
+    /// Also copies to the 'seeds' directory of the output the best seeds that
+    /// together hit all the edges and targets of the input ones
+    #[arg(long, requires = "triage")]
+    minimize: bool,
+
+    /// Spawns a client bound to each of these cores, e.g., 0-3,8; clients
+    /// share their finds and the range of the directed metrics
+    #[arg(long)]
+    cores: Option<String>,
+
+    /// Port of the broker of the clients when fuzzing on multiple cores
+    #[arg(long, default_value = "1337")]
+    broker_port: u16,
+
+    /// Port of the gateway through which the clients share finds with other
+    /// nodes, which connect to it with --remote-node
+    #[arg(long, requires = "cores")]
+    node_port: Option<u16>,
+
+    /// Connects the gateway of this node to the one of another node, e.g.,
+    /// 10.0.0.2:1338, or to another local one, e.g., 127.0.0.1:1338; can be
+    /// repeated. Finds are not relayed between nodes, so every pair of nodes
+    /// must be connected, e.g., each node connects to those started before it
+    #[arg(long = "remote-node", requires = "node_port")]
+    remote_nodes: Vec<SocketAddr>,
+
+    /// Share of the finds that do not improve the directed metric that is sent
+    /// to other nodes
+    #[arg(long, default_value = "0.05")]
+    coverage_share: f64,
+
     /// Cooling schedule used for directed fuzzing
     #[arg(short = 'z', long, default_value = "exp")]
     cooling_schedule: CoolingScheduleClap,
@@ -160,6 +220,27 @@ pub fn libafl_main() {
         return;
     }
 
+    if args.triage {
+        if let Err(error) = run_triage(
+            &in_dir,
+            &out_dir,
+            args.jobs,
+            args.minimize,
+            Duration::from_millis(args.timeout),
+        ) {
+            eprintln!("An error occurred while triaging: {error}");
+        }
+        return;
+    }
+
+    let cores = match args.cores.as_deref().map(Cores::from_cmdline).transpose() {
+        Ok(cores) => cores,
+        Err(error) => {
+            eprintln!("Invalid cores: {error}");
+            return;
+        }
+    };
+
     if let Err(error) = fuzz(
         out_dir.join("queue"),
         out_dir.join("crashes"),
@@ -168,6 +249,12 @@ pub fn libafl_main() {
         args.logfile,
         Duration::from_millis(args.timeout),
         args.show_target_output,
+        args.fork,
+        cores,
+        args.broker_port,
+        args.node_port,
+        args.remote_nodes,
+        args.coverage_share,
         args.cooling_schedule.0,
         Duration::from_secs(args.time_to_exploit * 60),
     ) {
@@ -198,6 +285,47 @@ fn run_testcases(filenames: &[impl AsRef<Path>]) {
     }
 }
 
+fn run_triage(
+    seed_dir: &Path,
+    out_dir: &Path,
+    jobs: usize,
+    minimize: bool,
+    timeout: Duration,
+) -> Result<(), Error> {
+    // Call LLVMFUzzerInitialize() if present, once for all the workers.
+    let args: Vec<String> = env::args().collect();
+    if libfuzzer_initialize(&args) == -1 {
+        println!("Warning: LLVMFuzzerInitialize failed with -1");
+    }
+
+    let seeds = triage::seed_files(seed_dir)?;
+    println!("Triaging {} seeds on {jobs} workers", seeds.len());
+
+    let mut harness = |buf: &[u8]| {
+        libfuzzer_test_one_input(buf);
+    };
+    let mut reports = triage::triage_seeds(&mut harness, &seeds, jobs, timeout, out_dir)?;
+    triage::sort_reports(&mut reports, TriageOrder::Distance);
+
+    let csv = out_dir.join("triage.csv");
+    triage::write_csv(&csv, &reports)?;
+    println!("Ranking written to {}", csv.display());
+
+    if minimize {
+        let minimized = triage::minimize(&reports);
+        let minimized_dir = out_dir.join("seeds");
+        triage::copy_seeds(&minimized, &minimized_dir)?;
+        println!(
+            "Kept {} of {} seeds in {}",
+            minimized.len(),
+            reports.len(),
+            minimized_dir.display()
+        );
+    }
+
+    Ok(())
+}
+
 /// The actual fuzzer
 #[allow(clippy::too_many_arguments)]
 fn fuzz<P: AsRef<Path>>(
@@ -208,6 +336,12 @@ fn fuzz<P: AsRef<Path>>(
     logfile: P,
     timeout: Duration,
     show_target_output: bool,
+    fork: bool,
+    cores: Option<Cores>,
+    broker_port: u16,
+    node_port: Option<u16>,
+    remote_nodes: Vec<SocketAddr>,
+    coverage_share: f64,
     cooling_schedule: CoolingSchedule,
     time_to_exploit: Duration,
 ) -> Result<(), Error> {
@@ -221,224 +355,347 @@ fn fuzz<P: AsRef<Path>>(
     #[cfg(unix)]
     let file_null = File::open("/dev/null")?;
 
-    // While the monitor are state, they are usually used in the broker - which is likely never restarted
-    let monitor = SimpleMonitor::with_user_monitor(
-        |s| {
-            println!("{s}");
-            writeln!(log.borrow_mut(), "{:?} {s}", current_time()).unwrap();
-        },
-        true,
-    );
+    let print_fn = |s: String| {
+        println!("{s}");
+        writeln!(log.borrow_mut(), "{:?} {s}", current_time()).unwrap();
+    };
 
     // We need a shared map to store our state before a crash.
     // This way, we are able to continue fuzzing afterwards.
     let mut shmem_provider = StdShMemProvider::new()?;
 
-    let (state, mut mgr) = match SimpleRestartingEventManager::launch(monitor, &mut shmem_provider)
-    {
-        // The restarting state will spawn the same process again as child, then restarted it each time it crashes.
-        Ok(res) => res,
-        Err(err) => match err {
-            Error::ShuttingDown => {
-                return Ok(());
+    // Loads the initial inputs with $executor, silences the target and fuzzes
+    // until the client restarts.
+    macro_rules! fuzz_with {
+        ($fuzzer:ident, $stages:ident, $executor:ident, $state:ident, $mgr:ident) => {{
+            // In case the corpus is empty (on first run), reset
+            if $state.must_load_initial_inputs() {
+                $state
+                    .load_initial_inputs(
+                        &mut $fuzzer,
+                        &mut $executor,
+                        &mut $mgr,
+                        &[seed_dir.as_ref().to_path_buf()],
+                    )
+                    .unwrap_or_else(|error| {
+                        println!(
+                            "Failed to load initial corpus in {}: {}",
+                            seed_dir.as_ref().display(),
+                            error,
+                        );
+                        process::exit(0);
+                    });
+                println!("We imported {} inputs from disk.", $state.corpus().count());
             }
-            _ => {
-                panic!("Failed to setup the restarter: {err}");
-            }
-        },
-    };
-
-    // Create an observation channel using the coverage map
-    // We don't use the hitcounts (see the Cargo.toml, we use pcguard_edges)
-    let edges_observer = HitcountsMapObserver::new(unsafe { std_edges_map_observer("edges") });
-
-    // Create an observation channel to keep track of the execution time
-    let time_observer = TimeObserver::new("time");
-
-    // Create an observation channel to keep track of the distance of test cases
-    let distance_observer = InProcessDistanceObserver::new(String::from("distance"));
-
-    // Create an observation channel to keep track of the similarity of test cases
-    let similarity_observer = InProcessSimilarityObserver::new(String::from("similarity"));
-
-    let targets_observer =
-        HitcountsMapObserver::new(unsafe { get_targets_map_observer("targets") });
-
-    let cmplog_observer = CmpLogObserver::new("cmplog", true);
-
-    let map_feedback = MaxMapFeedback::tracking(&edges_observer, true, false);
 
-    let targets_feedback = MaxMapFeedback::new(&targets_observer);
-
-    let calibration = CalibrationStage::new(&map_feedback);
-
-    // Feedback to rate the interestingness of an input
-    // This one is composed by two Feedbacks in OR
-    let mut feedback = feedback_or!(
-        // New maximization map feedback linked to the edges observer and the feedback state
-        map_feedback,
-        // Time feedback, this one does not need a feedback state
-        TimeFeedback::with_observer(&time_observer),
-        // Distance feedback, it adds the distace of a test case as metadata
-        DistanceFeedback::with_observer(
-            &distance_observer,
-            Some(cooling_schedule),
-            time_to_exploit
-        ),
-        // Similarity feedback, it adds the similarity of a test case as metadata
-        SimilarityFeedback::with_observer(&similarity_observer),
-        targets_feedback
-    );
-
-    // A feedback to choose if an input is a solution or not
-    let mut objective = CrashFeedback::new();
-
-    // If not restarting, create a State from scratch
-    let mut state = state.unwrap_or_else(|| {
-        StdState::new(
-            // RNG
-            StdRand::with_seed(current_nanos()),
-            // Corpus that will be evolved, we keep it in memory for performance
-            InMemoryOnDiskCorpus::new(corpus_dir).unwrap(),
-            // Corpus in which we store solutions (crashes in this example),
-            // on disk so the user can get them after stopping the fuzzer
-            OnDiskCorpus::new(objective_dir).unwrap(),
-            // States of the feedbacks.
-            // The feedbacks can report the data that should persist in the State.
-            &mut feedback,
-            // Same for objective feedbacks
-            &mut objective,
-        )
-        .unwrap()
-    });
+            // Remove target ouput (logs still survive)
+            if !show_target_output {
+                #[cfg(unix)]
+                {
+                    let null_fd = file_null.as_raw_fd();
+                    dup2(null_fd, io::stdout().as_raw_fd())?;
+                    dup2(null_fd, io::stderr().as_raw_fd())?;
+                }
+            }
+            // reopen file to make sure we're at the end
+            log.replace(
+                OpenOptions::new()
+                    .append(true)
+                    .create(true)
+                    .open(&logfile)?,
+            );
+
+            $fuzzer.fuzz_loop(&mut $stages, &mut $executor, &mut $state, &mut $mgr)?;
+
+            // Never reached
+            Ok(())
+        }};
+    }
 
-    println!("Let's fuzz :)");
+    // Sets up a client on top of the event manager $mgr, starting from $state
+    // when the client restarts, and fuzzes. $sync is set when the event
+    // manager merges the ranges of the directed metrics of the other clients.
+    macro_rules! run_client {
+        ($state:expr, $mgr:expr, $sync:expr) => {{
+            let mut mgr = $mgr;
+
+            // With --fork, the target runs in child processes, so the edges map
+            // and the directed stats are shared with them. The regions must
+            // outlive the observers.
+            let mut shared = if fork {
+                let mut provider = StdShMemProvider::new()?;
+                let mut edges = provider.new_shmem(unsafe { MAX_EDGES_NUM })?;
+                unsafe { EDGES_MAP_PTR = edges.as_mut_slice().as_mut_ptr() };
+                let stats = share_stats(&mut provider)?;
+                Some((edges, stats))
+            } else {
+                None
+            };
+
+            // Create an observation channel using the coverage map, to keep
+            // track of the distance and the similarity of test cases, and one
+            // for the targets
+            let (edges_observer, distance_observer, similarity_observer, targets_observer) =
+                match &mut shared {
+                    Some((edges, stats)) => {
+                        let stats: &SharedStats = SharedStats::from_region(stats.as_mut_slice())?;
+                        let edges = unsafe { StdMapObserver::new("edges", edges.as_mut_slice()) };
+                        let targets = unsafe { get_shared_targets_map_observer("targets", stats) };
+                        (
+                            HitcountsMapObserver::new(edges),
+                            InProcessDistanceObserver::with_shared_stats(
+                                String::from("distance"),
+                                stats,
+                            ),
+                            InProcessSimilarityObserver::with_shared_stats(
+                                String::from("similarity"),
+                                stats,
+                            ),
+                            HitcountsMapObserver::new(targets),
+                        )
+                    }
+                    None => unsafe {
+                        (
+                            HitcountsMapObserver::new(std_edges_map_observer("edges")),
+                            InProcessDistanceObserver::new(String::from("distance")),
+                            InProcessSimilarityObserver::new(String::from("similarity")),
+                            HitcountsMapObserver::new(get_targets_map_observer("targets")),
+                        )
+                    },
+                };
+
+            // Create an observation channel to keep track of the execution time
+            let time_observer = TimeObserver::new("time");
+
+            let cmplog_observer = CmpLogObserver::new("cmplog", true);
+
+            let map_feedback = MaxMapFeedback::tracking(&edges_observer, true, false);
+
+            let targets_feedback = MaxMapFeedback::new(&targets_observer);
+
+            // Reports when each target is first hit
+            let targets_telemetry =
+                TargetsTelemetryFeedback::with_observer(&targets_observer, target_locations());
+
+            let calibration = CalibrationStage::new(&map_feedback);
+
+            // Feedback to rate the interestingness of an input
+            // This one is composed by two Feedbacks in OR
+            let mut feedback = feedback_or!(
+                // New maximization map feedback linked to the edges observer and the feedback state
+                map_feedback,
+                // Time feedback, this one does not need a feedback state
+                TimeFeedback::with_observer(&time_observer),
+                // Distance feedback, it adds the distace of a test case as metadata
+                DistanceFeedback::with_observer(
+                    &distance_observer,
+                    Some(cooling_schedule),
+                    time_to_exploit
+                ),
+                // Similarity feedback, it adds the similarity of a test case as metadata
+                SimilarityFeedback::with_observer(&similarity_observer),
+                targets_feedback
+            );
+
+            // A feedback to choose if an input is a solution or not. The fuzzer
+            // only evaluates the feedback above for inputs that are not
+            // solutions, so first hits are recorded here, where crashing hits
+            // are seen too.
+            let mut objective = feedback_or!(CrashFeedback::new(), targets_telemetry);
+
+            // If not restarting, create a State from scratch
+            let mut state = $state.unwrap_or_else(|| {
+                StdState::new(
+                    // RNG
+                    StdRand::with_seed(current_nanos()),
+                    // Corpus that will be evolved, we keep it in memory for performance
+                    InMemoryOnDiskCorpus::new(&corpus_dir).unwrap(),
+                    // Corpus in which we store solutions (crashes in this example),
+                    // on disk so the user can get them after stopping the fuzzer
+                    OnDiskCorpus::new(&objective_dir).unwrap(),
+                    // States of the feedbacks.
+                    // The feedbacks can report the data that should persist in the State.
+                    &mut feedback,
+                    // Same for objective feedbacks
+                    &mut objective,
+                )
+                .unwrap()
+            });
 
-    // The actual target run starts here.
-    // Call LLVMFUzzerInitialize() if present.
-    let args: Vec<String> = env::args().collect();
-    if libfuzzer_initialize(&args) == -1 {
-        println!("Warning: LLVMFuzzerInitialize failed with -1");
-    }
+            println!("Let's fuzz :)");
 
-    // Setup a randomic Input2State stage
-    let i2s = StdMutationalStage::new(StdScheduledMutator::new(tuple_list!(I2SRandReplace::new())));
-
-    // Setup a MOPT mutator
-    let mutator = StdMOptMutator::new(
-        &mut state,
-        havoc_mutations().merge(tokens_mutations()),
-        7,
-        5,
-    )?;
-
-    let power = DistancePowerMutationalStage::new(mutator);
-
-    // A minimization+queue policy to get testcasess from the corpus
-    let scheduler =
-        IndexesLenTimeMinimizerScheduler::new(DistanceWeightedScheduler::with_schedule(
-            &mut state,
-            &edges_observer,
-            Some(PowerSchedule::FAST),
-        ));
-
-    // A fuzzer with feedbacks and a corpus scheduler
-    let mut fuzzer = StdFuzzer::new(scheduler, feedback, objective);
-
-    // The wrapped harness function, calling out to the LLVM-style harness
-    let mut harness = |input: &BytesInput| {
-        let target = input.target_bytes();
-        let buf = target.as_slice();
-        libfuzzer_test_one_input(buf);
-        ExitKind::Ok
-    };
+            // The actual target run starts here.
+            // Call LLVMFUzzerInitialize() if present.
+            let args: Vec<String> = env::args().collect();
+            if libfuzzer_initialize(&args) == -1 {
+                println!("Warning: LLVMFuzzerInitialize failed with -1");
+            }
 
-    let mut tracing_harness = harness;
+            // Setup a randomic Input2State stage
+            let i2s = StdMutationalStage::new(StdScheduledMutator::new(tuple_list!(I2SRandReplace::new())));
+
+            // Setup a MOPT mutator
+            let mutator = StdMOptMutator::new(
+                &mut state,
+                havoc_mutations().merge(tokens_mutations()),
+                7,
+                5,
+            )?;
+
+            let power = DistancePowerMutationalStage::new(mutator);
+
+            // A minimization+queue policy to get testcasess from the corpus
+            let scheduler =
+                IndexesLenTimeMinimizerScheduler::new(DistanceFenwickScheduler::with_schedule(
+                    &mut state,
+                    &edges_observer,
+                    Some(PowerSchedule::FAST),
+                ));
+
+            // A fuzzer with feedbacks and a corpus scheduler
+            let mut fuzzer = StdFuzzer::new(scheduler, feedback, objective);
+
+            // The wrapped harness function, calling out to the LLVM-style harness
+            let mut harness = |input: &BytesInput| {
+                let target = input.target_bytes();
+                let buf = target.as_slice();
+                libfuzzer_test_one_input(buf);
+                ExitKind::Ok
+            };
+
+            let mut tracing_harness = harness;
+
+            // Shares the range of the directed metrics with the other clients
+            let sync_distance = RangeSyncStage::<DistanceMetadata, _, _>::new($sync);
+            let sync_similarity = RangeSyncStage::<SimilarityMetadata, _, _>::new($sync);
+
+            // Read tokens
+            if state.metadata_map().get::<Tokens>().is_none() {
+                let mut toks = Tokens::default();
+                if let Some(tokenfile) = &tokenfile {
+                    toks.add_from_file(tokenfile)?;
+                }
+                #[cfg(any(target_os = "linux", target_vendor = "apple"))]
+                {
+                    toks += autotokens()?;
+                }
+
+                if !toks.is_empty() {
+                    state.add_metadata(toks);
+                }
+            }
 
-    // Create the executor for an in-process function with one observer for edge coverage and one for the execution time
-    let mut executor = TimeoutExecutor::new(
-        InProcessExecutor::new(
-            &mut harness,
-            tuple_list!(
+            // The distance observer reads the raw hit counts, so it must come
+            // before the edges observer, which classifies them in place.
+            let observers = tuple_list!(
+                distance_observer,
                 edges_observer,
                 time_observer,
-                distance_observer,
                 similarity_observer,
                 targets_observer
-            ),
-            &mut fuzzer,
-            &mut state,
-            &mut mgr,
-        )?,
-        timeout,
-    );
-
-    // Setup a tracing stage in which we log comparisons
-    let tracing = TracingStage::new(TimeoutExecutor::new(
-        InProcessExecutor::new(
-            &mut tracing_harness,
-            tuple_list!(cmplog_observer),
-            &mut fuzzer,
-            &mut state,
-            &mut mgr,
-        )?,
-        // Give it more time!
-        timeout * 10,
-    ));
-
-    // The order of the stages matter!
-    let mut stages = tuple_list!(calibration, tracing, i2s, power);
-
-    // Read tokens
-    if state.metadata_map().get::<Tokens>().is_none() {
-        let mut toks = Tokens::default();
-        if let Some(tokenfile) = tokenfile {
-            toks.add_from_file(tokenfile)?;
-        }
-        #[cfg(any(target_os = "linux", target_vendor = "apple"))]
-        {
-            toks += autotokens()?;
-        }
+            );
+
+            if fork {
+                // Create the executor that runs each input in a forked child process
+                let mut executor = TimeoutInProcessForkExecutor::new(
+                    &mut harness,
+                    observers,
+                    &mut fuzzer,
+                    &mut state,
+                    &mut mgr,
+                    timeout,
+                    StdShMemProvider::new()?,
+                )?;
+
+                // Comparisons are only logged in process, so there is no
+                // tracing stage, nor an Input2State one without its values.
+                let mut stages = tuple_list!(calibration, power, sync_distance, sync_similarity);
+                fuzz_with!(fuzzer, stages, executor, state, mgr)
+            } else {
+                // Create the executor for an in-process function with one observer for edge coverage and one for the execution time
+                let mut executor = TimeoutExecutor::new(
+                    InProcessExecutor::new(
+                        &mut harness,
+                        observers,
+                        &mut fuzzer,
+                        &mut state,
+                        &mut mgr,
+                    )?,
+                    timeout,
+                );
 
-        if !toks.is_empty() {
-            state.add_metadata(toks);
-        }
+                // Setup a tracing stage in which we log comparisons
+                let tracing = TracingStage::new(TimeoutExecutor::new(
+                    InProcessExecutor::new(
+                        &mut tracing_harness,
+                        tuple_list!(cmplog_observer),
+                        &mut fuzzer,
+                        &mut state,
+                        &mut mgr,
+                    )?,
+                    // Give it more time!
+                    timeout * 10,
+                ));
+
+                // The order of the stages matter!
+                let mut stages = tuple_list!(calibration, tracing, i2s, power, sync_distance, sync_similarity);
+                fuzz_with!(fuzzer, stages, executor, state, mgr)
+            }
+        }};
     }
 
-    // In case the corpus is empty (on first run), reset
-    if state.must_load_initial_inputs() {
-        state
-            .load_initial_inputs(
-                &mut fuzzer,
-                &mut executor,
-                &mut mgr,
-                &[seed_dir.as_ref().to_path_buf()],
-            )
-            .unwrap_or_else(|error| {
-                println!(
-                    "Failed to load initial corpus in {}: {}",
-                    seed_dir.as_ref().display(),
-                    error,
-                );
-                process::exit(0);
-            });
-        println!("We imported {} inputs from disk.", state.corpus().count());
-    }
+    if let Some(cores) = cores {
+        // The monitor runs in the broker, which is likely never restarted
+        let monitor = MultiMonitor::new(print_fn);
+
+        let mut run_client = |state: Option<_>,
+                              mut mgr: LlmpRestartingEventManager<_, _>,
+                              _core_id: CoreId| {
+            mgr.add_custom_buf_handler(Box::new(merge_synced_range::<DistanceMetadata, _>));
+            mgr.add_custom_buf_handler(Box::new(merge_synced_range::<SimilarityMetadata, _>));
+
+            // Only the finds that improve the directed metric and a share of
+            // the others are sent to other nodes.
+            let mgr =
+                FilteringEventManager::<_, DistanceMetadata>::new(mgr, node_port, coverage_share);
+            run_client!(state, mgr, true)
+        };
+
+        if let Some(node_port) = node_port {
+            spawn_node_gateway(node_port, remote_nodes, broker_port)?;
+        }
 
-    // Remove target ouput (logs still survive)
-    if !show_target_output {
-        #[cfg(unix)]
+        // Each client is bound to its core by the launcher.
+        return match Launcher::builder()
+            .shmem_provider(shmem_provider)
+            .configuration(EventConfig::from_name("default"))
+            .monitor(monitor)
+            .run_client(&mut run_client)
+            .cores(&cores)
+            .broker_port(broker_port)
+            .build()
+            .launch()
         {
-            let null_fd = file_null.as_raw_fd();
-            dup2(null_fd, io::stdout().as_raw_fd())?;
-            dup2(null_fd, io::stderr().as_raw_fd())?;
-        }
+            Err(Error::ShuttingDown) => Ok(()),
+            res => res,
+        };
     }
-    // reopen file to make sure we're at the end
-    log.replace(OpenOptions::new().append(true).create(true).open(logfile)?);
 
-    fuzzer.fuzz_loop(&mut stages, &mut executor, &mut state, &mut mgr)?;
+    // While the monitor are state, they are usually used in the broker - which is likely never restarted
+    let monitor = SimpleMonitor::with_user_monitor(print_fn, true);
 
-    // Never reached
-    Ok(())
+    let (state, mgr) = match SimpleRestartingEventManager::launch(monitor, &mut shmem_provider) {
+        // The restarting state will spawn the same process again as child, then restarted it each time it crashes.
+        Ok(res) => res,
+        Err(err) => match err {
+            Error::ShuttingDown => {
+                return Ok(());
+            }
+            _ => {
+                panic!("Failed to setup the restarter: {err}");
+            }
+        },
+    };
+
+    run_client!(state, mgr, false)
 }
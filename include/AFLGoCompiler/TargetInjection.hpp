@@ -1,5 +1,9 @@
 #pragma once
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/Passes/PassBuilder.h>
 
 namespace llvm {
@@ -14,13 +18,20 @@ class AFLGoTargetInjectionPass
   public:
     Target(std::string File, unsigned int Line) : File(File), Line(Line) {}
 
-    bool matches(const DILocation &Loc);
-
     operator std::string() const { return File + ":" + std::to_string(Line); }
   };
 
+  // Maps the target line numbers of a single file to their index in Targets.
+  using TargetLinesTy = DenseMap<unsigned int, unsigned int>;
+  // Maps each DIFile seen in a module to the targets in that file, if any.
+  using FileTargetsCacheTy = DenseMap<const DIFile *, const TargetLinesTy *>;
+
   SmallVector<Target, 16> Targets;
+  StringMap<TargetLinesTy> TargetsByFile;
+
   void parseTargets(std::unique_ptr<MemoryBuffer> &TargetsBuffer);
+  Optional<unsigned int> findTarget(const DILocation &Loc,
+                                    FileTargetsCacheTy &FileTargetsCache);
 
 public:
   AFLGoTargetInjectionPass();
@@ -30,4 +41,4 @@ public:
   static bool isRequired() { return true; }
 };
 
-} // namespace llvm
\ No newline at end of file
+} // namespace llvm
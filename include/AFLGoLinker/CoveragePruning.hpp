@@ -0,0 +1,20 @@
+#pragma once
+
+#include <llvm/Passes/PassBuilder.h>
+
+namespace llvm {
+
+// Disables SanitizerCoverage, including comparison tracing, in the functions
+// that cannot reach any target, i.e., the ones without a function distance.
+// Edges in those functions never bring a test case closer to the targets, so
+// dropping them shrinks the coverage map and the callbacks of each execution.
+class AFLGoCoveragePruningPass
+    : public PassInfoMixin<AFLGoCoveragePruningPass> {
+
+public:
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+
+  static bool isRequired() { return true; }
+};
+
+} // namespace llvm
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <AFLGoLinker/InlineProbes.hpp>
+
 #include <llvm/Passes/PassBuilder.h>
 
 namespace llvm {
@@ -7,9 +9,13 @@ namespace llvm {
 class DAFLInstrumentationPass : public PassInfoMixin<DAFLInstrumentationPass> {
 
   std::string OutputFile;
+  bool TextOutput;
+  ProbeKind Probes;
 
 public:
-  DAFLInstrumentationPass(std::string OutputFile) : OutputFile(OutputFile) {}
+  DAFLInstrumentationPass(std::string OutputFile, bool TextOutput,
+                          ProbeKind Probes = ProbeKind::Call)
+      : OutputFile(OutputFile), TextOutput(TextOutput), Probes(Probes) {}
 
   PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
 
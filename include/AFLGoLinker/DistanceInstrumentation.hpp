@@ -1,13 +1,30 @@
 #pragma once
 
+#include <AFLGoLinker/InlineProbes.hpp>
+
 #include <llvm/Passes/PassBuilder.h>
 
 namespace llvm {
 
 class AFLGoDistanceInstrumentationPass
     : public PassInfoMixin<AFLGoDistanceInstrumentationPass> {
+  // Threads used to compute distances, 0 means all available threads
+  unsigned int Threads;
+  // If not empty, distances are also written there, see DistanceFile.hpp
+  std::string OutputFile;
+  ProbeKind Probes;
+  // Probe one block for each group of blocks that run the same number of
+  // times, ignored with guard tables
+  bool SparseProbes;
 
 public:
+  explicit AFLGoDistanceInstrumentationPass(unsigned int Threads = 1,
+                                            std::string OutputFile = "",
+                                            ProbeKind Probes = ProbeKind::Call,
+                                            bool SparseProbes = false)
+      : Threads(Threads), OutputFile(OutputFile), Probes(Probes),
+        SparseProbes(SparseProbes) {}
+
   PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
 
   static bool isRequired() { return true; }
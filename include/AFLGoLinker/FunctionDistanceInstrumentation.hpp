@@ -8,8 +8,13 @@ class FunctionDistancePass
     : public PassInfoMixin<FunctionDistancePass> {
 
   uint32_t TargetCounter;
+  // Update the similarity stats in place instead of calling the runtime
+  bool InlineProbes;
 
 public:
+  explicit FunctionDistancePass(bool InlineProbes = false)
+      : InlineProbes(InlineProbes) {}
+
   PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
 
   static bool isRequired() { return true; }
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/Passes/PassBuilder.h>
+
+#include <cstdint>
+
+namespace llvm {
+
+// Records the weight of BB, i.e., its distance or DAFL score, so that
+// AFLGoGuardWeightsPass can emit it once SanitizerCoverage has instrumented
+// the module.
+void setGuardWeight(BasicBlock &BB, uint64_t Weight);
+
+// Emits a read-only table with the weight of each SanitizerCoverage guard of
+// the module and a constructor that registers it with the runtime. After each
+// execution, the runtime reduces the hit counts of the edges map with these
+// weights, so that no basic block needs a probe to compute the distance or
+// relevance of a test case.
+//
+// Weights are recorded with setGuardWeight before SanitizerCoverage runs and
+// are matched with the guard that it adds to the same basic block, so it must
+// not prune any block. Blocks created by splitting critical edges have no
+// weight.
+class AFLGoGuardWeightsPass : public PassInfoMixin<AFLGoGuardWeightsPass> {
+  const char *RegisterName;
+
+public:
+  // XXX: these should be kept in sync with libaflgo_targets/src/guards.rs
+  constexpr static const char *const RegisterDistancesName =
+      "__aflgo_register_guard_distances";
+  constexpr static const char *const RegisterDAFLName =
+      "__aflgo_register_guard_dafl";
+  // Weight of guards without one
+  constexpr static uint64_t NoWeight = UINT64_MAX;
+
+  explicit AFLGoGuardWeightsPass(const char *RegisterName)
+      : RegisterName(RegisterName) {}
+
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+
+  static bool isRequired() { return true; }
+};
+
+} // namespace llvm
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+
+namespace llvm {
+
+// How instrumented basic blocks report their distance or weight to the runtime
+enum class ProbeKind {
+  // Call to a tracing callback of libaflgo_targets
+  Call,
+  // Inline update of the stats of the callback, see InlineStatsProbe
+  Inline,
+  // Nothing in the block, the runtime reads the weight of the block from a
+  // per-guard table after each execution, see GuardWeights.hpp
+  GuardTable,
+};
+
+// Inline replacement for the tracing callbacks of libaflgo_targets. Each
+// callback accumulates values into the 64-bit counters of a #[repr(C)] stats
+// struct, which is exported with a well-known name; the probe updates the
+// counters in place, with a relaxed load and store each instead of a call and
+// atomic read-modify-writes. Targets are single-threaded while fuzzing, so no
+// update is lost.
+class InlineStatsProbe {
+  GlobalVariable *Stats;
+
+public:
+  // XXX: these should be kept in sync with libaflgo_targets
+  constexpr static const char *const DistanceStatsName =
+      "__aflgo_distance_stats";
+  constexpr static const char *const DAFLStatsName = "__aflgo_dafl_stats";
+  constexpr static const char *const SimilarityStatsName =
+      "__aflgo_similarity_stats";
+  constexpr static const char *const RegisterName =
+      "__aflgo_register_inline_probes";
+
+  InlineStatsProbe(Module &M, StringRef StatsName, unsigned int NumCounters);
+
+  // Adds Increments[I] to counter I.
+  void emit(IRBuilder<> &IRB, ArrayRef<uint64_t> Increments) const;
+};
+
+} // namespace llvm
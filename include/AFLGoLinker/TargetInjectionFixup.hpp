@@ -4,15 +4,31 @@
 
 namespace llvm {
 
+// Assigns a unique ID to each target call and emits the number of IDs along
+// with the file:line location of each target, which a constructor registers
+// with the runtime.
 class AFLGoTargetInjectionFixupPass
     : public PassInfoMixin<AFLGoTargetInjectionFixupPass> {
 
-  uint32_t TargetCounter;
+  uint32_t TargetCounter = 0;
 
 public:
+  // XXX: these should be kept in sync with libaflgo_targets/src/target.rs
+  constexpr static const char *const RegisterName = "__aflgo_register_targets";
+  // Location of targets without debug information
+  constexpr static const char *const UnknownLocation = "<unknown>";
+  // Priority of the constructor that registers the targets, the first one
+  // outside the range reserved for the implementation (0-100): it runs once
+  // libc is initialized, but before the other constructors of the
+  // instrumentation, which may hit targets.
+  constexpr static int CtorPriority = 101;
+  // Priority of the constructors that register other instrumentation with
+  // the runtime, e.g., guard weight tables.
+  constexpr static int RegisterCtorPriority = CtorPriority + 1;
+
   PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
 
   static bool isRequired() { return true; }
 };
 
-} // namespace llvm
\ No newline at end of file
+} // namespace llvm
@@ -1,42 +1,92 @@
 #pragma once
 
+#include <Analysis/DistanceCache.hpp>
 #include <Analysis/FunctionDistance.hpp>
 
-#include <llvm/Analysis/CallGraph.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/IR/PassManager.h>
 
 namespace llvm {
 
+// Computes the distances of the basic blocks of a function from its origin
+// blocks, i.e., targets and calls to functions with a distance. Traversal
+// buffers are kept across computations, so an engine should be reused for
+// many functions (one engine per thread).
+class BBDistanceEngine {
+public:
+  using BBToDistanceTy = SmallDenseMap<BasicBlock *, double, 16>;
+
+private:
+  // Blocks of the current function and their predecessors in CSR layout,
+  // indexed by block number.
+  DenseMap<const BasicBlock *, unsigned int> Numbers;
+  SmallVector<BasicBlock *, 0> Blocks;
+  SmallVector<unsigned int, 0> PredOffsets;
+  SmallVector<unsigned int, 0> Preds;
+
+  // Breadth-first search state; a block was visited by the current search if
+  // its stamp equals Epoch.
+  SmallVector<unsigned int, 0> Visited;
+  unsigned int Epoch = 0;
+  SmallVector<std::pair<unsigned int, unsigned int>, 0> Queue;
+
+  SmallVector<bool, 0> IsOrigin;
+  SmallVector<double, 0> ReciprocalSums;
+  SmallVector<unsigned int, 0> Counts;
+
+  void numberBlocks(Function &F);
+  void nextEpoch();
+
+public:
+  BBToDistanceTy compute(Function &F, const BBToDistanceTy &OriginBBs);
+};
+
 class AFLGoBasicBlockDistanceAnalysis
     : public AnalysisInfoMixin<AFLGoBasicBlockDistanceAnalysis> {
-  bool UseExtendedCG;
-
 public:
   static AnalysisKey Key;
 
   class Result {
   public:
     using FunctionToDistanceTy = AFLGoFunctionDistanceAnalysis::Result;
-    using BBToDistanceTy = SmallDenseMap<BasicBlock *, double, 16>;
+    using BBToDistanceTy = BBDistanceEngine::BBToDistanceTy;
     using FunctionToOriginBBsMapTy = DenseMap<Function *, BBToDistanceTy>;
 
   private:
     const FunctionToDistanceTy FunctionToDistance;
     FunctionToOriginBBsMapTy FunctionToOriginBBs;
+    BBDistanceEngine Engine;
+    // null if caching is disabled
+    DistanceCache *Cache;
+    // If set, FunctionToOriginBBs holds the final distances of all basic
+    // blocks, read from a distance file.
+    bool Imported = false;
 
   public:
-    explicit Result(FunctionToOriginBBsMapTy &FunctionToOriginBBs,
-                    const FunctionToDistanceTy &FunctionToDistance)
-        : FunctionToOriginBBs(FunctionToOriginBBs),
-          FunctionToDistance(FunctionToDistance) {}
+    explicit Result(FunctionToOriginBBsMapTy FunctionToOriginBBs,
+                    const FunctionToDistanceTy &FunctionToDistance,
+                    DistanceCache *Cache = nullptr)
+        : FunctionToDistance(FunctionToDistance),
+          FunctionToOriginBBs(std::move(FunctionToOriginBBs)), Cache(Cache) {}
 
-    BBToDistanceTy computeBBDistances(Function &F);
-  };
+    static Result imported(FunctionToOriginBBsMapTy FunctionToBBDistances,
+                           const FunctionToDistanceTy &FunctionToDistance) {
+      Result Res(std::move(FunctionToBBDistances), FunctionToDistance);
+      Res.Imported = true;
+      return Res;
+    }
+
+    // Thread safe, as long as each thread uses its own engine.
+    BBToDistanceTy computeBBDistances(Function &F,
+                                      BBDistanceEngine &Engine) const;
 
-  AFLGoBasicBlockDistanceAnalysis(bool UseExtendedCG)
-      : UseExtendedCG(UseExtendedCG) {}
+    BBToDistanceTy computeBBDistances(Function &F) {
+      return computeBBDistances(F, Engine);
+    }
+  };
 
   Result run(Module &F, ModuleAnalysisManager &FAM);
 };
 
-} // namespace llvm
\ No newline at end of file
+} // namespace llvm
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Analysis/CallGraph.h>
+#include <llvm/IR/PassManager.h>
+
+#include <cassert>
+
+namespace llvm {
+
+// Call graph with dense node IDs, in module order, and edges stored in CSR
+// layout in both directions. It is built once per link from either the LLVM or
+// the extended call graph and traversed by all the distance analyses.
+//
+// Only nodes of functions are kept: the external nodes of CallGraph never get
+// a distance and are sinks when walking from callees to callers.
+//
+// Strongly connected components are numbered in reverse topological order,
+// i.e., callees come before their callers, and condensed into a DAG so that
+// recursive clusters can be traversed as a single node.
+class CompactCallGraph {
+public:
+  struct Edge {
+    // Null for edges without a call site, e.g., to callback functions
+    CallBase *Call;
+    // Callee for forward edges, caller for reverse ones
+    unsigned int Node;
+  };
+
+private:
+  SmallVector<Function *, 0> Functions; // Indexed by node ID
+  DenseMap<const Function *, unsigned int> Ids;
+
+  SmallVector<unsigned int, 0> CalleeOffsets;
+  SmallVector<Edge, 0> Callees;
+  SmallVector<unsigned int, 0> CallerOffsets;
+  SmallVector<Edge, 0> Callers;
+
+  SmallVector<unsigned int, 0> SCCs; // Indexed by node ID
+  SmallVector<unsigned int, 0> SCCOffsets;
+  SmallVector<unsigned int, 0> SCCMembers;
+  SmallVector<unsigned int, 0> SCCCalleeOffsets;
+  SmallVector<unsigned int, 0> SCCCallees;
+  SmallVector<unsigned int, 0> SCCCallerOffsets;
+  SmallVector<unsigned int, 0> SCCCallers;
+
+  void computeSCCs();
+  void condenseSCCs();
+
+public:
+  explicit CompactCallGraph(const CallGraph &CG);
+
+  unsigned int size() const { return Functions.size(); }
+
+  Function *getFunction(unsigned int Id) const { return Functions[Id]; }
+
+  unsigned int getId(const Function &F) const {
+    auto It = Ids.find(&F);
+    assert(It != Ids.end() && "function not in call graph");
+    return It->second;
+  }
+
+  ArrayRef<Edge> callees(unsigned int Id) const {
+    return makeArrayRef(Callees).slice(
+        CalleeOffsets[Id], CalleeOffsets[Id + 1] - CalleeOffsets[Id]);
+  }
+
+  ArrayRef<Edge> callers(unsigned int Id) const {
+    return makeArrayRef(Callers).slice(
+        CallerOffsets[Id], CallerOffsets[Id + 1] - CallerOffsets[Id]);
+  }
+
+  unsigned int getNumSCCs() const { return SCCOffsets.size() - 1; }
+
+  unsigned int getSCC(unsigned int Id) const { return SCCs[Id]; }
+
+  ArrayRef<unsigned int> sccMembers(unsigned int SCC) const {
+    return makeArrayRef(SCCMembers)
+        .slice(SCCOffsets[SCC], SCCOffsets[SCC + 1] - SCCOffsets[SCC]);
+  }
+
+  // Distinct SCCs called by SCC, excluding itself
+  ArrayRef<unsigned int> sccCallees(unsigned int SCC) const {
+    return makeArrayRef(SCCCallees)
+        .slice(SCCCalleeOffsets[SCC],
+               SCCCalleeOffsets[SCC + 1] - SCCCalleeOffsets[SCC]);
+  }
+
+  // Distinct SCCs calling SCC, excluding itself
+  ArrayRef<unsigned int> sccCallers(unsigned int SCC) const {
+    return makeArrayRef(SCCCallers)
+        .slice(SCCCallerOffsets[SCC],
+               SCCCallerOffsets[SCC + 1] - SCCCallerOffsets[SCC]);
+  }
+};
+
+class CompactCallGraphAnalysis
+    : public AnalysisInfoMixin<CompactCallGraphAnalysis> {
+  bool UseExtendedCG;
+
+public:
+  static AnalysisKey Key;
+
+  using Result = CompactCallGraph;
+
+  explicit CompactCallGraphAnalysis(bool UseExtendedCG)
+      : UseExtendedCG(UseExtendedCG) {}
+
+  Result run(Module &M, ModuleAnalysisManager &MAM);
+};
+
+} // namespace llvm
@@ -13,6 +13,8 @@ public:
   static AnalysisKey Key;
 
   using WeightTy = uint64_t;
+  // Magic of the binary input/output file, see LocationScores.hpp
+  constexpr static const char *const BinaryMagic = "DAFLSCR1";
   // optional because we might not have target instructions
   using Result = Optional<DenseMap<const BasicBlock *, WeightTy>>;
 
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/StringSaver.h>
+
+namespace llvm {
+
+// Returns the absolute path of the source file described by File. If RealPath
+// is set, symbolic links are resolved as well; in that case, an empty path is
+// returned when the file does not exist.
+SmallString<128> resolveSourcePath(const DIFile &File, bool RealPath);
+
+// Caches the resolved path of each DIFile, so that every file is resolved at
+// most once per module, no matter how many debug locations refer to it.
+class DIFilePathCache {
+  bool RealPath;
+
+  BumpPtrAllocator Allocator;
+  StringSaver Saver{Allocator};
+  DenseMap<const DIFile *, StringRef> Paths;
+
+public:
+  explicit DIFilePathCache(bool RealPath) : RealPath(RealPath) {}
+
+  StringRef getPath(const DIFile &File);
+};
+
+} // namespace llvm
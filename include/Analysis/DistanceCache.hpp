@@ -0,0 +1,76 @@
+#pragma once
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/PassManager.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace llvm {
+
+// Distances computed by previous links, so that a rebuild after a small edit
+// only recomputes what changed. Entries are keyed by a hash of everything the
+// distances depend on:
+//   - the distance of a function by its calls, whether it is a target and the
+//     same for every function in its call graph cone;
+//   - basic block distances of a function by its CFG and the distances of its
+//     origin blocks, which change whenever a target in the call graph cone of
+//     the function does.
+//
+// The cache is a single file in the cache directory, read when the analysis
+// runs and written back, with only the entries used by this link, when the
+// result is destroyed. It is replaced atomically, so concurrent links never
+// read partial files.
+class DistanceCache {
+public:
+  // Basic block number in function order and its distance
+  using BBDistancesTy = SmallVector<std::pair<uint32_t, double>, 0>;
+
+private:
+  std::string Path;
+
+  DenseMap<uint64_t, double> StoredFunctionDistances;
+  DenseMap<uint64_t, double> UsedFunctionDistances;
+  DenseMap<uint64_t, BBDistancesTy> StoredBBDistances;
+  DenseMap<uint64_t, BBDistancesTy> UsedBBDistances;
+  bool Dirty = false;
+  unsigned int Hits = 0;
+  unsigned int Misses = 0;
+
+  std::mutex Mutex;
+
+  void read();
+  void write();
+
+public:
+  explicit DistanceCache(std::string Path);
+  ~DistanceCache();
+
+  bool lookupFunctionDistance(uint64_t Key, double &Distance);
+  void storeFunctionDistance(uint64_t Key, double Distance);
+
+  // Thread safe
+  bool lookupBBDistances(uint64_t Key, BBDistancesTy &Distances);
+  void storeBBDistances(uint64_t Key, BBDistancesTy Distances);
+};
+
+class DistanceCacheAnalysis : public AnalysisInfoMixin<DistanceCacheAnalysis> {
+  std::string CacheDir;
+
+public:
+  static AnalysisKey Key;
+
+  // null if caching is disabled
+  using Result = std::unique_ptr<DistanceCache>;
+
+  explicit DistanceCacheAnalysis(std::string CacheDir = "")
+      : CacheDir(CacheDir) {}
+
+  Result run(Module &M, ModuleAnalysisManager &);
+};
+
+} // namespace llvm
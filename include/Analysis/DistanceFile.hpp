@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Analysis/BasicBlockDistance.hpp>
+#include <Analysis/DIFilePathCache.hpp>
+#include <Analysis/LocationScores.hpp>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <string>
+
+namespace llvm {
+
+// Distances of basic blocks and functions keyed by debug location, so that the
+// distances computed by the link of one build of a program can be reused by
+// other builds of the same program, e.g., with different sanitizers. The file
+// uses the LocationScores format with one table per kind of distance; values
+// are the bits of the distances.
+//
+// Basic blocks are keyed by their first instruction with a line, functions by
+// their DISubprogram. When reading, each basic block takes the distance of
+// the first of its lines that has one, and lines with multiple distances keep
+// the minimum.
+class DistanceFileAnalysis : public AnalysisInfoMixin<DistanceFileAnalysis> {
+  std::string InputFile;
+
+public:
+  static AnalysisKey Key;
+
+  constexpr static const char *const BinaryMagic = "AFLGODST";
+  enum TableTy : unsigned int {
+    BasicBlockTable = 0,
+    FunctionTable,
+    NumTables,
+  };
+
+  struct Distances {
+    AFLGoFunctionDistanceAnalysis::Result Functions;
+    AFLGoBasicBlockDistanceAnalysis::Result::FunctionToOriginBBsMapTy
+        BasicBlocks;
+  };
+
+  // None if there is no input file
+  using Result = Optional<Distances>;
+
+  explicit DistanceFileAnalysis(std::string InputFile = "")
+      : InputFile(InputFile) {}
+
+  Result run(Module &M, ModuleAnalysisManager &);
+};
+
+class DistanceFileWriter {
+  DIFilePathCache Paths{/*RealPath=*/true};
+  LocationScoresWriter Writer{DistanceFileAnalysis::NumTables};
+
+public:
+  void addBasicBlock(const BasicBlock &BB, double Distance);
+  void addFunction(const Function &F, double Distance);
+
+  void write(raw_ostream &OS) const;
+};
+
+} // namespace llvm
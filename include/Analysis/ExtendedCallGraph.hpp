@@ -1,16 +1,36 @@
+#pragma once
+
 #include <llvm/Analysis/CallGraph.h>
 #include <llvm/IR/PassManager.h>
 
 namespace llvm {
 
+// How the targets of indirect calls are found when extending the call graph.
+enum class IndirectCallResolver {
+  // Whole-program Andersen pointer analysis; precise, but expensive.
+  Andersen,
+  // Address-taken functions with a compatible signature; virtual calls are
+  // restricted to the functions in the called vtable slot of the classes
+  // derived from the class of the object, from the type identifiers of
+  // -fwhole-program-vtables or else from the RTTI. Without either, or with
+  // opaque pointers and no type identifiers, the slot of every vtable is used.
+  Type,
+};
+
 class ExtendedCallGraphAnalysis
     : public AnalysisInfoMixin<ExtendedCallGraphAnalysis> {
+  IndirectCallResolver Resolver;
+
 public:
   static AnalysisKey Key;
 
   using Result = llvm::CallGraph;
 
+  explicit ExtendedCallGraphAnalysis(
+      IndirectCallResolver Resolver = IndirectCallResolver::Andersen)
+      : Resolver(Resolver) {}
+
   Result run(Module &M, ModuleAnalysisManager &);
 };
 
-} // namespace llvm
\ No newline at end of file
+} // namespace llvm
@@ -6,16 +6,19 @@ namespace llvm {
 
 class AFLGoFunctionDistanceAnalysis
     : public AnalysisInfoMixin<AFLGoFunctionDistanceAnalysis> {
-  bool UseExtendedCG;
   bool UseHawkeyeDistance;
+  // 0 means all available threads
+  unsigned int Threads;
 
 public:
   static AnalysisKey Key;
 
   using Result = DenseMap<Function *, double>;
 
-  AFLGoFunctionDistanceAnalysis(bool UseExtendedCG, bool UseHawkeyeDistance)
-      : UseExtendedCG(UseExtendedCG), UseHawkeyeDistance(UseHawkeyeDistance) {}
+  // The call graph is the one of CompactCallGraphAnalysis.
+  explicit AFLGoFunctionDistanceAnalysis(bool UseHawkeyeDistance,
+                                         unsigned int Threads = 1)
+      : UseHawkeyeDistance(UseHawkeyeDistance), Threads(Threads) {}
 
   Result run(Module &M, ModuleAnalysisManager &MAM);
 };
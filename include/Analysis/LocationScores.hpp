@@ -0,0 +1,62 @@
+#pragma once
+
+#include <llvm/ADT/STLFunctionalExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBufferRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace llvm {
+
+// Compact binary file that maps source locations (file:line) to 64-bit values.
+// It is meant to be memory mapped: paths are stored once and records are
+// fixed-size, so that reading it does not require any parsing. All integers
+// are little-endian.
+//
+//   magic   char[8]
+//   files   u32 count, count x (u32 length, char[length])
+//   tables  u32 count, count x (u32 records, records x (u32 file, u32 line,
+//                                                       u64 value))
+//
+// Each kind of value that a producer wants to store is kept in its own table.
+struct LocationScore {
+  StringRef File;
+  uint32_t Line;
+  uint64_t Value;
+};
+
+class LocationScoresWriter {
+  struct Record {
+    uint32_t File;
+    uint32_t Line;
+    uint64_t Value;
+  };
+
+  StringMap<uint32_t> FileIndices;
+  std::vector<StringRef> Files; // Keys owned by FileIndices
+  std::vector<std::vector<Record>> Tables;
+
+public:
+  explicit LocationScoresWriter(unsigned int NumTables) : Tables(NumTables) {}
+
+  void add(unsigned int Table, StringRef File, uint32_t Line, uint64_t Value);
+
+  void write(raw_ostream &OS, StringRef Magic) const;
+};
+
+// Returns true if Buffer starts with Magic, i.e., it should be read with
+// readLocationScores.
+bool hasLocationScoresMagic(MemoryBufferRef Buffer, StringRef Magic);
+
+// Calls Callback for each record in the file, in order. The file paths passed
+// to the callback point into Buffer.
+Error readLocationScores(
+    MemoryBufferRef Buffer, StringRef Magic,
+    function_ref<void(unsigned int Table, const LocationScore &Score)>
+        Callback);
+
+} // namespace llvm
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <llvm/IR/PassManager.h>
+
+#include <memory>
+#include <string>
+
+namespace SVF {
+class AndersenWaveDiff;
+class LLVMModuleSet;
+class SVFG;
+class SVFGBuilder;
+class SVFIR;
+} // namespace SVF
+
+namespace llvm {
+
+// Whole-program Andersen pointer analysis computed with SVF, shared by the
+// analyses that need it. SVF keeps its state in singletons, so there can be
+// only one result at a time; the state is released together with the result,
+// i.e., as soon as a pass does not preserve this analysis.
+//
+// If a cache directory is given, points-to sets and the SVFG are stored there,
+// keyed by a hash of the module bitcode, and read back by later runs on the
+// same module instead of being computed again.
+class SVFPointerAnalysis : public AnalysisInfoMixin<SVFPointerAnalysis> {
+public:
+  static AnalysisKey Key;
+
+  class Result {
+    SVF::LLVMModuleSet *ModuleSet;
+    SVF::SVFIR *PAG;
+    SVF::AndersenWaveDiff *Andersen;
+    std::unique_ptr<SVF::SVFGBuilder> SVFGBuilder;
+    SVF::SVFG *SVFG = nullptr;
+    // empty if caching is disabled
+    std::string SVFGCachePath;
+
+  public:
+    Result(SVF::LLVMModuleSet *ModuleSet, SVF::SVFIR *PAG,
+           SVF::AndersenWaveDiff *Andersen, std::string SVFGCachePath);
+    Result(Result &&Other);
+    ~Result();
+
+    SVF::LLVMModuleSet &getModuleSet() const { return *ModuleSet; }
+    SVF::SVFIR &getPAG() const { return *PAG; }
+    SVF::AndersenWaveDiff &getAndersen() const { return *Andersen; }
+
+    // Full sparse value-flow graph, built on first use.
+    SVF::SVFG &getSVFG();
+  };
+
+  SVFPointerAnalysis(bool Verbose, std::string CacheDir = "")
+      : Verbose(Verbose), CacheDir(CacheDir) {}
+
+  Result run(Module &M, ModuleAnalysisManager &);
+
+private:
+  bool Verbose;
+  std::string CacheDir;
+};
+
+} // namespace llvm
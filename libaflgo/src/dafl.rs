@@ -14,6 +14,8 @@ use libafl::{
 
 use serde::{Deserialize, Serialize};
 
+use crate::{FenwickWeightedScheduler, NormalizedTestcaseScore};
+
 pub trait DAFLObserver<S>: Observer<S>
 where
     S: UsesInput,
@@ -178,15 +180,15 @@ impl DAFLMetadata {
         }
     }
 
-    fn min_relevance(&self) -> Option<u64> {
+    pub fn min_relevance(&self) -> Option<u64> {
         self.min_relevance
     }
 
-    fn max_relevance(&self) -> Option<u64> {
+    pub fn max_relevance(&self) -> Option<u64> {
         self.max_relevance
     }
 
-    fn avg_relevance(&self) -> Option<f64> {
+    pub fn avg_relevance(&self) -> Option<f64> {
         self.avg_relevance
     }
 
@@ -195,6 +197,10 @@ impl DAFLMetadata {
             .avg_relevance
             .map(|avg| avg + ((cur as f64 - avg) / qlen as f64))
             .or(Some(cur as f64));
+        self.update_range(cur);
+    }
+
+    pub fn update_range(&mut self, cur: u64) {
         self.min_relevance = Some(self.min_relevance.unwrap_or(cur).min(cur));
         self.max_relevance = Some(self.max_relevance.unwrap_or(cur).max(cur));
     }
@@ -233,8 +239,20 @@ where
     }
 }
 
+impl<S> NormalizedTestcaseScore<S> for DAFLWeightTestcaseScore
+where
+    S: HasCorpus + HasMetadata,
+{
+    // The relevance is used as is.
+    fn normalization_key(_state: &S) -> u64 {
+        0
+    }
+}
+
 pub type DAFLWeightedScheduler<O, S> = WeightedScheduler<DAFLWeightTestcaseScore, O, S>;
 
+pub type DAFLFenwickScheduler<O, S> = FenwickWeightedScheduler<DAFLWeightTestcaseScore, O, S>;
+
 pub struct DAFLPowerTestcaseScore;
 
 impl<S> TestcaseScore<S> for DAFLPowerTestcaseScore
@@ -1,4 +1,10 @@
-use std::{fmt, marker::PhantomData, time::Duration};
+use std::{
+    collections::hash_map::DefaultHasher,
+    fmt,
+    hash::{Hash, Hasher},
+    marker::PhantomData,
+    time::Duration,
+};
 
 use libafl::{
     impl_serdeany,
@@ -17,7 +23,24 @@ use libafl::{
 use serde::{Deserialize, Serialize};
 
 pub mod dafl;
-pub use dafl::{DAFLFeedback, DAFLObserver, DAFLPowerMutationalStage, DAFLWeightedScheduler};
+pub use dafl::{
+    DAFLFeedback, DAFLFenwickScheduler, DAFLMetadata, DAFLObserver, DAFLPowerMutationalStage,
+    DAFLWeightedScheduler,
+};
+
+pub mod sync;
+pub use sync::{
+    merge_synced_range, spawn_node_gateway, BestTestcase, FilteringEventManager, RangeSyncStage,
+    SyncedRange,
+};
+
+pub mod targets;
+pub use targets::{TargetsTelemetryFeedback, TargetsTelemetryMetadata};
+
+pub mod weighted;
+pub use weighted::{
+    FenwickScheduleMetadata, FenwickTree, FenwickWeightedScheduler, NormalizedTestcaseScore,
+};
 
 pub trait DistanceObserver<S>: Observer<S>
 where
@@ -578,4 +601,37 @@ where
     }
 }
 
+impl<S> NormalizedTestcaseScore<S> for DistanceWeightTestcaseScore
+where
+    S: HasCorpus + HasMetadata,
+{
+    fn normalization_key(state: &S) -> u64 {
+        let mut hasher = DefaultHasher::new();
+        if let Ok(distance_metadata) = state.metadata::<DistanceMetadata>() {
+            distance_metadata
+                .min_distance()
+                .map(f64::to_bits)
+                .hash(&mut hasher);
+            distance_metadata
+                .max_distance()
+                .map(f64::to_bits)
+                .hash(&mut hasher);
+        }
+        if let Ok(similarity_metadata) = state.metadata::<SimilarityMetadata>() {
+            similarity_metadata
+                .min_similarity()
+                .map(f64::to_bits)
+                .hash(&mut hasher);
+            similarity_metadata
+                .max_similarity()
+                .map(f64::to_bits)
+                .hash(&mut hasher);
+        }
+        hasher.finish()
+    }
+}
+
 pub type DistanceWeightedScheduler<O, S> = WeightedScheduler<DistanceWeightTestcaseScore, O, S>;
+
+pub type DistanceFenwickScheduler<O, S> =
+    FenwickWeightedScheduler<DistanceWeightTestcaseScore, O, S>;
@@ -0,0 +1,679 @@
+use std::{
+    collections::HashMap, marker::PhantomData, net::SocketAddr, sync::mpsc, thread, time::Duration,
+};
+
+use libafl::{
+    bolts::{
+        current_nanos,
+        llmp::{
+            LlmpBroker, LlmpClient, LlmpClientDescription, LlmpMsgHookResult, Tag,
+            LLMP_FLAG_FROM_B2B,
+        },
+        rands::{Rand, StdRand},
+        serdeany::SerdeAny,
+        shmem::{ShMemProvider, StdShMemProvider},
+    },
+    corpus::{Corpus, CorpusId, Testcase},
+    impl_serdeany,
+    inputs::{Input, UsesInput},
+    prelude::{
+        CustomBufEventResult, Event, EventConfig, EventFirer, EventManager, EventManagerId,
+        EventProcessor, EventRestarter, HasCustomBufHandlers, HasEventManagerId, ProgressReporter,
+        UsesState,
+    },
+    stages::Stage,
+    state::{HasClientPerfMonitor, HasCorpus, HasExecutions, HasMetadata},
+    Error,
+};
+use serde::{Deserialize, Serialize};
+
+use crate::{
+    dafl::{DAFLMetadata, DAFLTestcaseMetadata},
+    DistanceMetadata, DistanceTestcaseMetadata, SimilarityMetadata,
+};
+
+/// Range of a metric that the clients of a campaign exchange, so that all of
+/// them normalize it in the same way
+pub trait SyncedRange: SerdeAny {
+    /// Tag of the events carrying the range
+    const TAG: &'static str;
+
+    /// The range in the format of the events, if there is one
+    #[must_use]
+    fn encode_range(&self) -> Option<Vec<u8>>;
+
+    /// Extends the range with one received from another client, returns false
+    /// if the event is malformed.
+    fn merge_encoded_range(&mut self, buf: &[u8]) -> bool;
+}
+
+fn encode_pair(first: [u8; 8], second: [u8; 8]) -> Vec<u8> {
+    [first, second].concat()
+}
+
+fn decode_pair(buf: &[u8]) -> Option<([u8; 8], [u8; 8])> {
+    if buf.len() != 16 {
+        return None;
+    }
+    Some((buf[..8].try_into().ok()?, buf[8..].try_into().ok()?))
+}
+
+impl SyncedRange for DistanceMetadata {
+    const TAG: &'static str = "libaflgo_distance_range";
+
+    fn encode_range(&self) -> Option<Vec<u8>> {
+        let min = self.min_distance()?;
+        let max = self.max_distance()?;
+        Some(encode_pair(min.to_le_bytes(), max.to_le_bytes()))
+    }
+
+    fn merge_encoded_range(&mut self, buf: &[u8]) -> bool {
+        let Some((min, max)) = decode_pair(buf) else { return false; };
+        self.update_range(f64::from_le_bytes(min));
+        self.update_range(f64::from_le_bytes(max));
+        true
+    }
+}
+
+impl SyncedRange for SimilarityMetadata {
+    const TAG: &'static str = "libaflgo_similarity_range";
+
+    fn encode_range(&self) -> Option<Vec<u8>> {
+        let min = self.min_similarity()?;
+        let max = self.max_similarity()?;
+        Some(encode_pair(min.to_le_bytes(), max.to_le_bytes()))
+    }
+
+    fn merge_encoded_range(&mut self, buf: &[u8]) -> bool {
+        let Some((min, max)) = decode_pair(buf) else { return false; };
+        self.update_range(f64::from_le_bytes(min));
+        self.update_range(f64::from_le_bytes(max));
+        true
+    }
+}
+
+impl SyncedRange for DAFLMetadata {
+    const TAG: &'static str = "libaflgo_dafl_range";
+
+    fn encode_range(&self) -> Option<Vec<u8>> {
+        let min = self.min_relevance()?;
+        let max = self.max_relevance()?;
+        Some(encode_pair(min.to_le_bytes(), max.to_le_bytes()))
+    }
+
+    fn merge_encoded_range(&mut self, buf: &[u8]) -> bool {
+        let Some((min, max)) = decode_pair(buf) else { return false; };
+        self.update_range(u64::from_le_bytes(min));
+        self.update_range(u64::from_le_bytes(max));
+        true
+    }
+}
+
+/// Metric by which test cases that improve on the best one of the campaign are
+/// told apart
+pub trait BestTestcase: SerdeAny {
+    /// Whether `testcase` is as good as the best test case of the campaign, as
+    /// far as the range of the metric is known
+    #[must_use]
+    fn is_best<I: Input>(&self, testcase: &Testcase<I>) -> bool;
+}
+
+impl BestTestcase for DistanceMetadata {
+    fn is_best<I: Input>(&self, testcase: &Testcase<I>) -> bool {
+        let (Ok(metadata), Some(min_distance)) = (
+            testcase.metadata::<DistanceTestcaseMetadata>(),
+            self.min_distance(),
+        ) else { return false; };
+        metadata.distance() <= min_distance
+    }
+}
+
+impl BestTestcase for DAFLMetadata {
+    fn is_best<I: Input>(&self, testcase: &Testcase<I>) -> bool {
+        let (Ok(metadata), Some(max_relevance)) = (
+            testcase.metadata::<DAFLTestcaseMetadata>(),
+            self.max_relevance(),
+        ) else { return false; };
+        metadata.relevance() >= max_relevance
+    }
+}
+
+/// Last range of each tag that the other clients know of, shared by the handler
+/// that merges the ranges received and the stage that sends the local ones
+#[derive(Serialize, Deserialize, Clone, Debug, Default)]
+pub struct RangeSyncMetadata {
+    last_synced: HashMap<String, Vec<u8>>,
+}
+
+impl RangeSyncMetadata {
+    #[must_use]
+    pub fn last_synced(&self, tag: &str) -> Option<&[u8]> {
+        self.last_synced.get(tag).map(Vec::as_slice)
+    }
+
+    pub fn set_last_synced(&mut self, tag: &str, range: Vec<u8>) {
+        self.last_synced.insert(tag.to_string(), range);
+    }
+}
+
+impl_serdeany!(RangeSyncMetadata);
+
+fn sync_metadata_mut<S: HasMetadata>(state: &mut S) -> &mut RangeSyncMetadata {
+    if !state.has_metadata::<RangeSyncMetadata>() {
+        state.add_metadata(RangeSyncMetadata::default());
+    }
+    state.metadata_mut::<RangeSyncMetadata>().unwrap()
+}
+
+/// Handler of the events of the event manager that merges the ranges of type
+/// `M` received from other clients. Malformed ranges, e.g., from a client of
+/// another version, are reported and dropped rather than stopping the fuzzer.
+#[allow(clippy::ptr_arg)] // The signature of the handlers of the event manager
+pub fn merge_synced_range<M, S>(
+    state: &mut S,
+    tag: &String,
+    buf: &[u8],
+) -> Result<CustomBufEventResult, Error>
+where
+    M: SyncedRange,
+    S: HasMetadata,
+{
+    if tag != M::TAG {
+        return Ok(CustomBufEventResult::Next);
+    }
+
+    let (local, merged) = match state.metadata_mut::<M>() {
+        Ok(metadata) => {
+            let local = metadata.encode_range();
+            if !metadata.merge_encoded_range(buf) {
+                eprintln!("[AFLGo] ignoring malformed {tag} event");
+                return Ok(CustomBufEventResult::Handled);
+            }
+            (local, metadata.encode_range())
+        }
+        Err(_) => return Ok(CustomBufEventResult::Handled),
+    };
+
+    // The other clients already know of the merged range, unless the local
+    // one changed since it was last sent. Otherwise, every client would send
+    // back every range it receives.
+    let sync = sync_metadata_mut(state);
+    if let Some(merged) = merged {
+        if sync.last_synced(M::TAG) == local.as_deref() {
+            sync.set_last_synced(M::TAG, merged);
+        }
+    }
+
+    Ok(CustomBufEventResult::Handled)
+}
+
+/// Sends the range of type `M` to the other clients whenever it changes
+/// locally. Only clients that register `merge_synced_range` as a handler should
+/// enable it.
+#[derive(Debug)]
+pub struct RangeSyncStage<M, EM, Z> {
+    enabled: bool,
+
+    phantom: PhantomData<(M, EM, Z)>,
+}
+
+impl<M, EM, Z> RangeSyncStage<M, EM, Z> {
+    #[must_use]
+    pub fn new(enabled: bool) -> Self {
+        Self {
+            enabled,
+            phantom: PhantomData,
+        }
+    }
+}
+
+impl<M, EM, Z> UsesState for RangeSyncStage<M, EM, Z>
+where
+    EM: UsesState,
+{
+    type State = EM::State;
+}
+
+impl<E, EM, M, Z> Stage<E, EM, Z> for RangeSyncStage<M, EM, Z>
+where
+    E: UsesState<State = EM::State>,
+    EM: EventFirer,
+    EM::State: HasMetadata,
+    M: SyncedRange,
+    Z: UsesState<State = EM::State>,
+{
+    fn perform(
+        &mut self,
+        _fuzzer: &mut Z,
+        _executor: &mut E,
+        state: &mut EM::State,
+        manager: &mut EM,
+        _corpus_idx: CorpusId,
+    ) -> Result<(), Error> {
+        if !self.enabled {
+            return Ok(());
+        }
+
+        let Ok(metadata) = state.metadata::<M>() else { return Ok(()); };
+        let Some(range) = metadata.encode_range() else { return Ok(()); };
+        let sync = sync_metadata_mut(state);
+        if sync.last_synced(M::TAG) == Some(range.as_slice()) {
+            return Ok(());
+        }
+        sync.set_last_synced(M::TAG, range.clone());
+
+        manager.fire(
+            state,
+            Event::CustomBuf {
+                buf: range,
+                tag: M::TAG.to_string(),
+            },
+        )?;
+        Ok(())
+    }
+}
+
+/// Tag of the events that clients send to other nodes through the gateway of
+/// their node
+const NODE_EVENT_TAG: Tag = 0x4146_474F;
+
+fn start_node_gateway(
+    port: u16,
+    remotes: &[SocketAddr],
+) -> Result<LlmpBroker<StdShMemProvider>, Error> {
+    let mut gateway = LlmpBroker::create_attach_to_tcp(StdShMemProvider::new()?, port)?;
+    for &remote in remotes {
+        gateway.connect_b2b(remote)?;
+    }
+    Ok(gateway)
+}
+
+fn relay_to_broker(port: u16, broker_port: u16) -> Result<(), Error> {
+    let mut gateway = LlmpClient::create_attach_to_tcp(StdShMemProvider::new()?, port)?;
+    let mut broker = LlmpClient::create_attach_to_tcp(StdShMemProvider::new()?, broker_port)?;
+    loop {
+        match gateway.recv_buf_with_flags()? {
+            Some((_, tag, flags, buf)) if flags & LLMP_FLAG_FROM_B2B != 0 => {
+                broker.send_buf_with_flags(tag, flags & !LLMP_FLAG_FROM_B2B, buf)?;
+            }
+            // Events of the clients of this node, which the broker already
+            // received from them
+            Some(_) => {}
+            None => thread::sleep(Duration::from_millis(1)),
+        }
+    }
+}
+
+/// Starts, in background threads of the calling process, the gateway between
+/// the clients of this node and other nodes. The gateway listens on `port` for
+/// the clients of this node, which send it the events that
+/// `FilteringEventManager` lets through, and for the gateways of other nodes,
+/// and connects to the ones at `remotes`. The events of other nodes are
+/// forwarded to the broker of the clients on `broker_port`, so that all the
+/// clients of this node receive them.
+///
+/// Gateways only pass on the events of their own clients, not those received
+/// from other nodes, so the nodes must form a full mesh: every pair of nodes
+/// must be connected, by either one, e.g., each node connects to the nodes
+/// started before it.
+pub fn spawn_node_gateway(
+    port: u16,
+    remotes: Vec<SocketAddr>,
+    broker_port: u16,
+) -> Result<(), Error> {
+    // LLMP maps cannot be moved between threads, so the gateway is set up in
+    // its own thread.
+    let (ready_sender, ready_receiver) = mpsc::channel();
+    thread::spawn(move || match start_node_gateway(port, &remotes) {
+        Ok(mut gateway) => {
+            ready_sender.send(Ok(())).unwrap();
+            gateway.loop_forever(
+                &mut |_, _, _, _| Ok(LlmpMsgHookResult::ForwardToClients),
+                Some(Duration::from_millis(5)),
+            );
+        }
+        Err(err) => ready_sender.send(Err(err.to_string())).unwrap(),
+    });
+    ready_receiver
+        .recv()
+        .map_err(|_| Error::unknown("node gateway exited"))?
+        .map_err(Error::unknown)?;
+
+    thread::spawn(move || {
+        if let Err(err) = relay_to_broker(port, broker_port) {
+            panic!("Failed to relay the events of other nodes: {err}");
+        }
+    });
+    Ok(())
+}
+
+// The connection of a client to the gateway of its node, kept across restarts
+#[derive(Serialize, Deserialize, Debug)]
+struct NodeGatewayMetadata {
+    client: LlmpClientDescription,
+}
+
+impl_serdeany!(NodeGatewayMetadata);
+
+/// Event manager that sends all events to the clients of its node, and to
+/// other nodes, through the gateway of the node, only the new test cases that
+/// improve on the best one of the campaign, according to the metric `M`, and a
+/// random share of the others, e.g., those that only increase coverage. Since
+/// the range of `M` is synced, the best test case of the sender is also the
+/// best one that the receivers know of.
+#[derive(Debug)]
+pub struct FilteringEventManager<EM, M> {
+    inner: EM,
+    node_port: Option<u16>,
+    gateway: Option<LlmpClient<StdShMemProvider>>,
+    coverage_share: f64,
+    rand: StdRand,
+    phantom: PhantomData<M>,
+}
+
+impl<EM, M> FilteringEventManager<EM, M> {
+    /// `node_port` is the port of the gateway of the node, see
+    /// `spawn_node_gateway`, if the campaign spans several nodes.
+    /// `coverage_share` is the probability of sending to other nodes a test
+    /// case that does not improve on the best one.
+    #[must_use]
+    pub fn new(inner: EM, node_port: Option<u16>, coverage_share: f64) -> Self {
+        Self {
+            inner,
+            node_port,
+            gateway: None,
+            coverage_share,
+            rand: StdRand::with_seed(current_nanos()),
+            phantom: PhantomData,
+        }
+    }
+}
+
+// Resolution of the coverage share
+const SHARE_SCALE: u64 = 1_000_000;
+
+impl<EM, M> FilteringEventManager<EM, M>
+where
+    EM: UsesState,
+    EM::State: HasCorpus + HasMetadata,
+    M: BestTestcase,
+{
+    // The test case of a NewTestcase event is the last one added to the corpus.
+    fn should_send_last_testcase(&mut self, state: &EM::State) -> Result<bool, Error> {
+        if self.coverage_share >= 1.0 {
+            return Ok(true);
+        }
+
+        let Some(idx) = state.corpus().last() else { return Ok(true); };
+        let testcase = state.corpus().get(idx)?.borrow();
+        if let Ok(metadata) = state.metadata::<M>() {
+            if metadata.is_best(&testcase) {
+                return Ok(true);
+            }
+        }
+
+        let threshold = (self.coverage_share * SHARE_SCALE as f64) as u64;
+        Ok(self.rand.below(SHARE_SCALE) < threshold)
+    }
+
+    fn crosses_nodes(
+        &mut self,
+        state: &EM::State,
+        event: &Event<<EM::State as UsesInput>::Input>,
+    ) -> Result<bool, Error> {
+        match event {
+            Event::NewTestcase { .. } => self.should_send_last_testcase(state),
+            // Ranges of the directed metrics
+            Event::CustomBuf { .. } => Ok(true),
+            _ => Ok(false),
+        }
+    }
+
+    fn gateway(
+        &mut self,
+        port: u16,
+        state: &EM::State,
+    ) -> Result<&mut LlmpClient<StdShMemProvider>, Error> {
+        if self.gateway.is_none() {
+            let gateway = match state.metadata::<NodeGatewayMetadata>() {
+                Ok(metadata) => LlmpClient::existing_client_from_description(
+                    StdShMemProvider::new()?,
+                    &metadata.client,
+                )?,
+                Err(_) => LlmpClient::create_attach_to_tcp(StdShMemProvider::new()?, port)?,
+            };
+            self.gateway = Some(gateway);
+        }
+        Ok(self.gateway.as_mut().unwrap())
+    }
+}
+
+impl<EM, M> UsesState for FilteringEventManager<EM, M>
+where
+    EM: UsesState,
+{
+    type State = EM::State;
+}
+
+impl<EM, M> EventFirer for FilteringEventManager<EM, M>
+where
+    EM: EventFirer,
+    EM::State: HasCorpus + HasMetadata,
+    M: BestTestcase,
+{
+    fn fire(
+        &mut self,
+        state: &mut Self::State,
+        event: Event<<Self::State as UsesInput>::Input>,
+    ) -> Result<(), Error> {
+        if let Some(port) = self.node_port {
+            if self.crosses_nodes(state, &event)? {
+                let buf = postcard::to_allocvec(&event)?;
+                self.gateway(port, state)?.send_buf(NODE_EVENT_TAG, &buf)?;
+            }
+        }
+        self.inner.fire(state, event)
+    }
+
+    fn configuration(&self) -> EventConfig {
+        self.inner.configuration()
+    }
+}
+
+impl<EM, M> EventRestarter for FilteringEventManager<EM, M>
+where
+    EM: EventRestarter,
+    EM::State: HasMetadata,
+{
+    fn on_restart(&mut self, state: &mut Self::State) -> Result<(), Error> {
+        if let Some(gateway) = &self.gateway {
+            gateway.await_safe_to_unmap_blocking();
+            state.add_metadata(NodeGatewayMetadata {
+                client: gateway.describe()?,
+            });
+        }
+        self.inner.on_restart(state)
+    }
+
+    fn send_exiting(&mut self) -> Result<(), Error> {
+        self.inner.send_exiting()
+    }
+
+    fn await_restart_safe(&mut self) {
+        if let Some(gateway) = &self.gateway {
+            gateway.await_safe_to_unmap_blocking();
+        }
+        self.inner.await_restart_safe();
+    }
+}
+
+impl<E, EM, M, Z> EventProcessor<E, Z> for FilteringEventManager<EM, M>
+where
+    EM: EventProcessor<E, Z>,
+{
+    fn process(
+        &mut self,
+        fuzzer: &mut Z,
+        state: &mut Self::State,
+        executor: &mut E,
+    ) -> Result<usize, Error> {
+        self.inner.process(fuzzer, state, executor)
+    }
+}
+
+impl<EM, M> ProgressReporter for FilteringEventManager<EM, M>
+where
+    EM: ProgressReporter,
+    EM::State: HasCorpus + HasMetadata + HasExecutions + HasClientPerfMonitor,
+    M: BestTestcase,
+{
+}
+
+impl<EM, M> HasEventManagerId for FilteringEventManager<EM, M>
+where
+    EM: HasEventManagerId,
+{
+    fn mgr_id(&self) -> EventManagerId {
+        self.inner.mgr_id()
+    }
+}
+
+impl<EM, M> HasCustomBufHandlers for FilteringEventManager<EM, M>
+where
+    EM: HasCustomBufHandlers,
+{
+    fn add_custom_buf_handler(
+        &mut self,
+        handler: Box<
+            dyn FnMut(&mut Self::State, &String, &[u8]) -> Result<CustomBufEventResult, Error>,
+        >,
+    ) {
+        self.inner.add_custom_buf_handler(handler);
+    }
+}
+
+impl<E, EM, M, Z> EventManager<E, Z> for FilteringEventManager<EM, M>
+where
+    EM: EventManager<E, Z>,
+    EM::State: HasCorpus + HasMetadata + HasExecutions + HasClientPerfMonitor,
+    M: BestTestcase,
+{
+}
+
+#[cfg(test)]
+mod tests {
+    use libafl::{bolts::serdeany::SerdeAnyMap, inputs::BytesInput};
+
+    use super::*;
+
+    #[derive(Default)]
+    struct MetadataState(SerdeAnyMap);
+
+    impl HasMetadata for MetadataState {
+        fn metadata_map(&self) -> &SerdeAnyMap {
+            &self.0
+        }
+
+        fn metadata_map_mut(&mut self) -> &mut SerdeAnyMap {
+            &mut self.0
+        }
+    }
+
+    fn range(min: f64, max: f64) -> Vec<u8> {
+        let mut metadata = DistanceMetadata::default();
+        metadata.update_range(min);
+        metadata.update_range(max);
+        metadata.encode_range().unwrap()
+    }
+
+    #[test]
+    fn test_merge_ranges() {
+        let mut local = DistanceMetadata::default();
+        local.update_range(2.0);
+        local.update_range(3.0);
+
+        let mut remote = DistanceMetadata::default();
+        assert!(remote.encode_range().is_none());
+        remote.update_range(1.0);
+        remote.update_range(2.5);
+
+        assert!(local.merge_encoded_range(&remote.encode_range().unwrap()));
+        assert_eq!(local.min_distance(), Some(1.0));
+        assert_eq!(local.max_distance(), Some(3.0));
+        assert!(!local.merge_encoded_range(&[0; 8]));
+
+        let mut local = DAFLMetadata::default();
+        let mut remote = DAFLMetadata::default();
+        remote.update_range(u64::MAX);
+        remote.update_range(5);
+        assert!(local.merge_encoded_range(&remote.encode_range().unwrap()));
+        assert_eq!(local.min_relevance(), Some(5));
+        assert_eq!(local.max_relevance(), Some(u64::MAX));
+        // The average depends on the local corpus only.
+        assert_eq!(local.avg_relevance(), None);
+    }
+
+    #[test]
+    fn test_best_testcase() {
+        let mut metadata = DistanceMetadata::default();
+        let mut testcase = Testcase::new(BytesInput::new(vec![]));
+        testcase.add_metadata(DistanceTestcaseMetadata::new(2.0));
+        // Without a range, nothing is known about the campaign.
+        assert!(!metadata.is_best(&testcase));
+
+        metadata.update_range(2.0);
+        metadata.update_range(5.0);
+        assert!(metadata.is_best(&testcase));
+        metadata.update_range(1.0);
+        assert!(!metadata.is_best(&testcase));
+
+        let mut metadata = DAFLMetadata::default();
+        let mut testcase = Testcase::new(BytesInput::new(vec![]));
+        testcase.add_metadata(DAFLTestcaseMetadata::new(7));
+        metadata.update_range(7);
+        assert!(metadata.is_best(&testcase));
+        metadata.update_range(8);
+        assert!(!metadata.is_best(&testcase));
+        // Test cases without the metric are never the best.
+        assert!(!metadata.is_best(&Testcase::new(BytesInput::new(vec![]))));
+    }
+
+    #[test]
+    fn test_merged_ranges_not_resent() {
+        let tag = DistanceMetadata::TAG.to_string();
+        let mut state = MetadataState::default();
+        let mut local = DistanceMetadata::default();
+        local.update_range(2.0);
+        local.update_range(3.0);
+        state.add_metadata(local);
+        sync_metadata_mut(&mut state).set_last_synced(&tag, range(2.0, 3.0));
+
+        // The local range was sent, so the merged one is known to all clients.
+        merge_synced_range::<DistanceMetadata, _>(&mut state, &tag, &range(1.0, 2.5)).unwrap();
+        let sync = state.metadata::<RangeSyncMetadata>().unwrap();
+        assert_eq!(sync.last_synced(&tag), Some(range(1.0, 3.0).as_slice()));
+
+        // The local range changed since, so the merged one is still sent.
+        state
+            .metadata_mut::<DistanceMetadata>()
+            .unwrap()
+            .update_range(4.0);
+        merge_synced_range::<DistanceMetadata, _>(&mut state, &tag, &range(0.5, 1.0)).unwrap();
+        let sync = state.metadata::<RangeSyncMetadata>().unwrap();
+        assert_eq!(sync.last_synced(&tag), Some(range(1.0, 3.0).as_slice()));
+
+        // Ranges received before any local one need not be sent back either.
+        let mut state = MetadataState::default();
+        state.add_metadata(DistanceMetadata::default());
+        merge_synced_range::<DistanceMetadata, _>(&mut state, &tag, &range(1.0, 2.0)).unwrap();
+        let sync = state.metadata::<RangeSyncMetadata>().unwrap();
+        assert_eq!(sync.last_synced(&tag), Some(range(1.0, 2.0).as_slice()));
+
+        // Malformed ranges are dropped without failing.
+        let res = merge_synced_range::<DistanceMetadata, _>(&mut state, &tag, &[0; 3]);
+        assert!(matches!(res, Ok(CustomBufEventResult::Handled)));
+        let local = state.metadata::<DistanceMetadata>().unwrap();
+        assert_eq!(local.min_distance(), Some(1.0));
+        assert_eq!(local.max_distance(), Some(2.0));
+    }
+}
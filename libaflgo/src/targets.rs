@@ -0,0 +1,214 @@
+use std::{fmt, marker::PhantomData, time::Duration};
+
+use libafl::{
+    impl_serdeany,
+    prelude::{
+        current_time, Event, EventFirer, ExitKind, Feedback, LogSeverity, MapObserver, Named,
+        ObserversTuple, UserStats, UsesInput,
+    },
+    state::{HasClientPerfMonitor, HasExecutions, HasMetadata},
+    Error,
+};
+use serde::{Deserialize, Serialize};
+
+/// Records when each target is first hit, so that the time to reach it does not
+/// need to be recovered from the corpus. It never considers a test case
+/// interesting by itself, so it belongs in the objective: the fuzzer evaluates
+/// the objective for every execution, but the feedback only for those that
+/// are not solutions, and a first hit often crashes.
+#[derive(Debug)]
+pub struct TargetsTelemetryFeedback<O, S> {
+    name: String,
+    // `file:line` location of each target, indexed by target ID
+    locations: Vec<String>,
+
+    phantom: PhantomData<(O, S)>,
+}
+
+impl<S: UsesInput, O: MapObserver<Entry = u8>> TargetsTelemetryFeedback<O, S> {
+    #[must_use]
+    pub fn with_observer(observer: &O, locations: Vec<String>) -> Self {
+        Self {
+            name: observer.name().to_string(),
+            locations,
+            phantom: PhantomData,
+        }
+    }
+
+    fn location(&self, target_id: usize) -> &str {
+        self.locations
+            .get(target_id)
+            .map_or("<unknown>", String::as_str)
+    }
+}
+
+impl<S, O> Feedback<S> for TargetsTelemetryFeedback<O, S>
+where
+    S: UsesInput + HasClientPerfMonitor + HasMetadata + HasExecutions + fmt::Debug,
+    O: MapObserver<Entry = u8>,
+{
+    fn init_state(&mut self, state: &mut S) -> Result<(), Error> {
+        state.add_metadata(TargetsTelemetryMetadata::new(self.locations.len()));
+        Ok(())
+    }
+
+    fn is_interesting<EM, OT>(
+        &mut self,
+        state: &mut S,
+        manager: &mut EM,
+        _input: &S::Input,
+        observers: &OT,
+        _exit_kind: &ExitKind,
+    ) -> Result<bool, Error>
+    where
+        EM: EventFirer<State = S>,
+        OT: ObserversTuple<S>,
+    {
+        let observer = observers
+            .match_name::<O>(self.name())
+            .ok_or_else(|| Error::key_not_found("targets observer not found".to_string()))?;
+
+        let executions = *state.executions();
+        let now = current_time();
+        let initial = observer.initial();
+
+        let mut new_hits = Vec::new();
+        let telemetry = state.metadata_mut::<TargetsTelemetryMetadata>().unwrap();
+        for target_id in 0..observer.usable_count() {
+            if *observer.get(target_id) == initial {
+                continue;
+            }
+
+            if let Some(hit) = telemetry.record(target_id, executions, now) {
+                new_hits.push((target_id, hit));
+            }
+        }
+
+        if new_hits.is_empty() {
+            return Ok(false);
+        }
+
+        let num_hit = telemetry.num_hit() as u64;
+        let num_targets = telemetry.num_targets().max(self.locations.len()) as u64;
+
+        for (target_id, hit) in new_hits {
+            manager.fire(
+                state,
+                Event::Log {
+                    severity_level: LogSeverity::Info,
+                    message: format!(
+                        "target {target_id} ({}) first hit after {} executions, {:.3}s",
+                        self.location(target_id),
+                        hit.executions(),
+                        hit.time_to_target().as_secs_f64(),
+                    ),
+                    phantom: PhantomData,
+                },
+            )?;
+        }
+
+        manager.fire(
+            state,
+            Event::UpdateUserStats {
+                name: self.name.clone() + "_hit",
+                value: UserStats::Ratio(num_hit, num_targets),
+                phantom: PhantomData,
+            },
+        )?;
+
+        Ok(false)
+    }
+}
+
+impl<O, S> Named for TargetsTelemetryFeedback<O, S> {
+    fn name(&self) -> &str {
+        &self.name
+    }
+}
+
+#[derive(Serialize, Deserialize, Clone, Copy, Debug)]
+pub struct TargetHit {
+    executions: usize,
+    timestamp: Duration,
+    time_to_target: Duration,
+}
+
+impl TargetHit {
+    /// Number of executions of the campaign when the target was first hit
+    #[must_use]
+    pub fn executions(&self) -> usize {
+        self.executions
+    }
+
+    /// Time since the epoch when the target was first hit
+    #[must_use]
+    pub fn timestamp(&self) -> Duration {
+        self.timestamp
+    }
+
+    /// Time since the start of the campaign when the target was first hit
+    #[must_use]
+    pub fn time_to_target(&self) -> Duration {
+        self.time_to_target
+    }
+}
+
+#[derive(Serialize, Deserialize, Clone, Debug, Default)]
+pub struct TargetsTelemetryMetadata {
+    campaign_start: Duration,
+    // First hit of each target, indexed by target ID
+    first_hits: Vec<Option<TargetHit>>,
+}
+
+impl TargetsTelemetryMetadata {
+    #[must_use]
+    pub fn new(num_targets: usize) -> Self {
+        Self {
+            campaign_start: current_time(),
+            first_hits: vec![None; num_targets],
+        }
+    }
+
+    /// Records the first hit of a target, returns it if the target was not hit
+    /// before.
+    pub fn record(
+        &mut self,
+        target_id: usize,
+        executions: usize,
+        timestamp: Duration,
+    ) -> Option<TargetHit> {
+        if target_id >= self.first_hits.len() {
+            self.first_hits.resize(target_id + 1, None);
+        }
+
+        let first_hit = &mut self.first_hits[target_id];
+        if first_hit.is_some() {
+            return None;
+        }
+
+        let hit = TargetHit {
+            executions,
+            timestamp,
+            time_to_target: timestamp.saturating_sub(self.campaign_start),
+        };
+        *first_hit = Some(hit);
+        Some(hit)
+    }
+
+    #[must_use]
+    pub fn first_hit(&self, target_id: usize) -> Option<&TargetHit> {
+        self.first_hits.get(target_id)?.as_ref()
+    }
+
+    #[must_use]
+    pub fn num_hit(&self) -> usize {
+        self.first_hits.iter().flatten().count()
+    }
+
+    #[must_use]
+    pub fn num_targets(&self) -> usize {
+        self.first_hits.len()
+    }
+}
+
+impl_serdeany!(TargetsTelemetryMetadata);
@@ -0,0 +1,512 @@
+use std::{collections::HashMap, marker::PhantomData};
+
+use libafl::{
+    bolts::rands::Rand,
+    corpus::{Corpus, CorpusId, Testcase},
+    impl_serdeany,
+    inputs::UsesInput,
+    observers::{MapObserver, ObserversTuple},
+    prelude::UsesState,
+    schedulers::{
+        powersched::{PowerQueueScheduler, PowerSchedule, SchedulerMetadata},
+        RemovableScheduler, Scheduler, TestcaseScore,
+    },
+    state::{HasCorpus, HasMetadata, HasRand},
+    Error,
+};
+use serde::{Deserialize, Serialize};
+
+// Entries re-weighted on each selection after the normalization range changed
+const REWEIGHT_BATCH: usize = 64;
+// Draws before falling back to a uniform selection, e.g., when all the weights
+// are zero
+const MAX_DRAWS: usize = 8;
+
+/// Score whose value depends on a normalization range shared by the whole
+/// corpus, e.g., the minimum and maximum distance
+pub trait NormalizedTestcaseScore<S>: TestcaseScore<S> {
+    /// Identifies the current normalization range, scores computed with a
+    /// different one are stale.
+    #[must_use]
+    fn normalization_key(state: &S) -> u64;
+}
+
+/// Binary indexed tree over non-negative weights, which supports updates and
+/// weighted selection in O(log n)
+#[derive(Serialize, Deserialize, Clone, Debug, Default)]
+pub struct FenwickTree {
+    // Node i (1-based) holds the sum of the weights in (i - lowbit(i), i].
+    nodes: Vec<f64>,
+    weights: Vec<f64>,
+}
+
+fn lowbit(i: usize) -> usize {
+    i & i.wrapping_neg()
+}
+
+impl FenwickTree {
+    #[must_use]
+    pub fn new() -> Self {
+        Default::default()
+    }
+
+    #[must_use]
+    pub fn len(&self) -> usize {
+        self.weights.len()
+    }
+
+    #[must_use]
+    pub fn is_empty(&self) -> bool {
+        self.weights.is_empty()
+    }
+
+    #[must_use]
+    pub fn weight(&self, index: usize) -> f64 {
+        self.weights[index]
+    }
+
+    /// Appends an entry, returns its index.
+    pub fn push(&mut self, weight: f64) -> usize {
+        let index = self.len();
+        let node = index + 1;
+        let children = self.prefix_sum(index) - self.prefix_sum(node - lowbit(node));
+        self.nodes.push(weight + children);
+        self.weights.push(weight);
+        index
+    }
+
+    pub fn set(&mut self, index: usize, weight: f64) {
+        let delta = weight - self.weights[index];
+        self.weights[index] = weight;
+
+        let mut node = index + 1;
+        while node <= self.nodes.len() {
+            self.nodes[node - 1] += delta;
+            node += lowbit(node);
+        }
+    }
+
+    /// Sum of the weights of the first `len` entries
+    #[must_use]
+    pub fn prefix_sum(&self, len: usize) -> f64 {
+        let mut sum = 0.0;
+        let mut node = len;
+        while node > 0 {
+            sum += self.nodes[node - 1];
+            node -= lowbit(node);
+        }
+        sum
+    }
+
+    #[must_use]
+    pub fn total(&self) -> f64 {
+        self.prefix_sum(self.len())
+    }
+
+    /// Index of the entry whose cumulative weight range contains `target`, in
+    /// [0, total). Targets past the total, e.g., because of rounding, select
+    /// the last entry.
+    #[must_use]
+    pub fn find(&self, mut target: f64) -> Option<usize> {
+        if self.is_empty() {
+            return None;
+        }
+
+        let mut position = 0;
+        let mut step = 1 << (usize::BITS - 1 - self.len().leading_zeros());
+        while step > 0 {
+            let node = position + step;
+            if node <= self.len() && self.nodes[node - 1] <= target {
+                position = node;
+                target -= self.nodes[node - 1];
+            }
+            step >>= 1;
+        }
+        Some(position.min(self.len() - 1))
+    }
+}
+
+/// Weights of the corpus entries, along with the normalization epoch in which
+/// each of them was computed
+#[derive(Serialize, Deserialize, Clone, Debug, Default)]
+pub struct FenwickScheduleMetadata {
+    tree: FenwickTree,
+    // Corpus ID of each entry of the tree, None once removed
+    ids: Vec<Option<CorpusId>>,
+    positions: HashMap<CorpusId, usize>,
+    epochs: Vec<u64>,
+
+    epoch: u64,
+    normalization_key: Option<u64>,
+    // Entries before the cursor were re-weighted in the current epoch.
+    reweight_cursor: usize,
+
+    runs_in_current_cycle: usize,
+}
+
+impl FenwickScheduleMetadata {
+    #[must_use]
+    pub fn new() -> Self {
+        Default::default()
+    }
+
+    #[must_use]
+    pub fn tree(&self) -> &FenwickTree {
+        &self.tree
+    }
+
+    #[must_use]
+    pub fn epoch(&self) -> u64 {
+        self.epoch
+    }
+
+    #[must_use]
+    pub fn position(&self, idx: CorpusId) -> Option<usize> {
+        self.positions.get(&idx).copied()
+    }
+
+    #[must_use]
+    pub fn id(&self, position: usize) -> Option<CorpusId> {
+        self.ids.get(position).copied().flatten()
+    }
+
+    /// Adds an entry weighted in the current epoch, returns its position.
+    pub fn push(&mut self, idx: CorpusId, weight: f64) -> usize {
+        if let Some(position) = self.position(idx) {
+            self.set_weight(position, weight);
+            return position;
+        }
+
+        let position = self.tree.push(weight);
+        self.ids.push(Some(idx));
+        self.positions.insert(idx, position);
+        self.epochs.push(self.epoch);
+        position
+    }
+
+    pub fn remove(&mut self, idx: CorpusId) {
+        if let Some(position) = self.positions.remove(&idx) {
+            self.tree.set(position, 0.0);
+            self.ids[position] = None;
+        }
+    }
+
+    /// Updates the weight of an entry, which is now current.
+    pub fn set_weight(&mut self, position: usize, weight: f64) {
+        self.tree.set(position, weight);
+        self.epochs[position] = self.epoch;
+    }
+
+    #[must_use]
+    pub fn is_stale(&self, position: usize) -> bool {
+        self.ids[position].is_some() && self.epochs[position] != self.epoch
+    }
+
+    /// Starts a new epoch if the normalization range changed, which makes all
+    /// the weights stale.
+    pub fn update_normalization_key(&mut self, key: u64) -> bool {
+        if self.normalization_key == Some(key) {
+            return false;
+        }
+
+        if self.normalization_key.is_some() {
+            self.epoch += 1;
+            self.reweight_cursor = 0;
+        }
+        self.normalization_key = Some(key);
+        true
+    }
+
+    /// Position of the next stale entry to re-weight, if any. Each entry is
+    /// visited once per epoch.
+    pub fn next_stale(&mut self) -> Option<usize> {
+        while self.reweight_cursor < self.ids.len() {
+            let position = self.reweight_cursor;
+            self.reweight_cursor += 1;
+            if self.is_stale(position) {
+                return Some(position);
+            }
+        }
+        None
+    }
+}
+
+impl_serdeany!(FenwickScheduleMetadata);
+
+/// Weighted scheduler that keeps the weights in a Fenwick tree, so that adding
+/// an entry or changing its weight costs O(log n) instead of rebuilding an
+/// alias table over the whole corpus. When the normalization range changes, the
+/// weights are refreshed lazily: a batch on each selection, and a selected
+/// entry before it is returned. Other corpus-wide factors of the weights, e.g.,
+/// the average execution time, are refreshed as entries are selected. The
+/// power schedule bookkeeping is left to a [`PowerQueueScheduler`].
+#[derive(Debug, Clone)]
+pub struct FenwickWeightedScheduler<F, O, S> {
+    inner: PowerQueueScheduler<O, S>,
+    phantom: PhantomData<F>,
+}
+
+impl<F, O, S> FenwickWeightedScheduler<F, O, S>
+where
+    F: NormalizedTestcaseScore<S>,
+    O: MapObserver,
+    S: HasCorpus + HasMetadata + HasRand,
+{
+    #[must_use]
+    pub fn new(state: &mut S, map_observer: &O) -> Self {
+        Self::with_schedule(state, map_observer, None)
+    }
+
+    #[must_use]
+    pub fn with_schedule(state: &mut S, map_observer: &O, strat: Option<PowerSchedule>) -> Self {
+        if !state.has_metadata::<SchedulerMetadata>() {
+            state.add_metadata(SchedulerMetadata::new(strat));
+        }
+        if !state.has_metadata::<FenwickScheduleMetadata>() {
+            state.add_metadata(FenwickScheduleMetadata::new());
+        }
+
+        // The schedule is taken from the metadata added above.
+        let inner_strat = strat.unwrap_or(PowerSchedule::EXPLORE);
+        Self {
+            inner: PowerQueueScheduler::new(state, map_observer, inner_strat),
+            phantom: PhantomData,
+        }
+    }
+
+    fn compute_weight(state: &S, idx: CorpusId) -> Result<f64, Error> {
+        let mut testcase = state.corpus().get(idx)?.borrow_mut();
+        let weight = F::compute(state, &mut testcase)?;
+        if weight.is_finite() && weight > 0.0 {
+            Ok(weight)
+        } else {
+            Ok(0.0)
+        }
+    }
+
+    fn reweight(state: &mut S, position: usize) -> Result<(), Error> {
+        let metadata = state.metadata::<FenwickScheduleMetadata>()?;
+        let Some(idx) = metadata.id(position) else { return Ok(()); };
+        let weight = Self::compute_weight(state, idx)?;
+        state
+            .metadata_mut::<FenwickScheduleMetadata>()?
+            .set_weight(position, weight);
+        Ok(())
+    }
+
+    fn draw(state: &mut S) -> Result<Option<CorpusId>, Error> {
+        for _ in 0..MAX_DRAWS {
+            let total = state.metadata::<FenwickScheduleMetadata>()?.tree().total();
+            if total <= 0.0 {
+                return Ok(None);
+            }
+
+            // 53 random bits for a uniform float in [0, 1)
+            let unit = (state.rand_mut().next() >> 11) as f64 / (1_u64 << 53) as f64;
+            let metadata = state.metadata::<FenwickScheduleMetadata>()?;
+            let Some(position) = metadata.tree().find(unit * total) else { return Ok(None); };
+
+            // A stale weight may be too high, draw again with the current one.
+            if metadata.is_stale(position) {
+                Self::reweight(state, position)?;
+                continue;
+            }
+
+            let metadata = state.metadata::<FenwickScheduleMetadata>()?;
+            if metadata.tree().weight(position) > 0.0 {
+                if let Some(idx) = metadata.id(position) {
+                    return Ok(Some(idx));
+                }
+            }
+        }
+        Ok(None)
+    }
+
+    fn draw_uniform(state: &mut S) -> Result<CorpusId, Error> {
+        let len = state.metadata::<FenwickScheduleMetadata>()?.tree().len();
+        let start = state.rand_mut().below(len as u64) as usize;
+
+        let metadata = state.metadata::<FenwickScheduleMetadata>()?;
+        (0..len)
+            .find_map(|offset| metadata.id((start + offset) % len))
+            .ok_or_else(|| Error::empty("No entries in the schedule".to_string()))
+    }
+}
+
+impl<F, O, S> UsesState for FenwickWeightedScheduler<F, O, S>
+where
+    S: UsesInput,
+{
+    type State = S;
+}
+
+impl<F, O, S> Scheduler for FenwickWeightedScheduler<F, O, S>
+where
+    F: NormalizedTestcaseScore<S>,
+    O: MapObserver,
+    S: HasCorpus + HasMetadata + HasRand,
+{
+    fn on_add(&mut self, state: &mut S, idx: CorpusId) -> Result<(), Error> {
+        self.inner.on_add(state, idx)?;
+
+        let key = F::normalization_key(state);
+        state
+            .metadata_mut::<FenwickScheduleMetadata>()?
+            .update_normalization_key(key);
+
+        let weight = Self::compute_weight(state, idx)?;
+        state
+            .metadata_mut::<FenwickScheduleMetadata>()?
+            .push(idx, weight);
+        Ok(())
+    }
+
+    fn on_evaluation<OT>(
+        &mut self,
+        state: &mut S,
+        input: &S::Input,
+        observers: &OT,
+    ) -> Result<(), Error>
+    where
+        OT: ObserversTuple<S>,
+    {
+        self.inner.on_evaluation(state, input, observers)
+    }
+
+    fn next(&mut self, state: &mut S) -> Result<CorpusId, Error> {
+        let corpus_count = state.corpus().count();
+        if corpus_count == 0 {
+            return Err(Error::empty("No entries in corpus".to_string()));
+        }
+
+        let key = F::normalization_key(state);
+        state
+            .metadata_mut::<FenwickScheduleMetadata>()?
+            .update_normalization_key(key);
+
+        // The weight of the last entry changed as it was fuzzed.
+        if let Some(idx) = *state.corpus().current() {
+            if let Some(position) = state.metadata::<FenwickScheduleMetadata>()?.position(idx) {
+                Self::reweight(state, position)?;
+            }
+        }
+
+        for _ in 0..REWEIGHT_BATCH {
+            let metadata = state.metadata_mut::<FenwickScheduleMetadata>()?;
+            let Some(position) = metadata.next_stale() else { break; };
+            Self::reweight(state, position)?;
+        }
+
+        let idx = match Self::draw(state)? {
+            Some(idx) => idx,
+            None => Self::draw_uniform(state)?,
+        };
+
+        let metadata = state.metadata_mut::<FenwickScheduleMetadata>()?;
+        metadata.runs_in_current_cycle += 1;
+        if metadata.runs_in_current_cycle >= corpus_count {
+            metadata.runs_in_current_cycle = 0;
+            let psmeta = state.metadata_mut::<SchedulerMetadata>()?;
+            psmeta.set_queue_cycles(psmeta.queue_cycles() + 1);
+        }
+
+        *state.corpus_mut().current_mut() = Some(idx);
+        Ok(idx)
+    }
+}
+
+impl<F, O, S> RemovableScheduler for FenwickWeightedScheduler<F, O, S>
+where
+    F: NormalizedTestcaseScore<S>,
+    O: MapObserver,
+    S: HasCorpus + HasMetadata + HasRand,
+{
+    fn on_remove(
+        &mut self,
+        state: &mut S,
+        idx: CorpusId,
+        _testcase: &Option<Testcase<S::Input>>,
+    ) -> Result<(), Error> {
+        state.metadata_mut::<FenwickScheduleMetadata>()?.remove(idx);
+        Ok(())
+    }
+
+    fn on_replace(
+        &mut self,
+        state: &mut S,
+        idx: CorpusId,
+        _prev: &Testcase<S::Input>,
+    ) -> Result<(), Error> {
+        let weight = Self::compute_weight(state, idx)?;
+        state
+            .metadata_mut::<FenwickScheduleMetadata>()?
+            .push(idx, weight);
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_fenwick_tree() {
+        let weights = [3.0, 0.0, 1.0, 4.0, 1.0, 5.0, 9.0];
+        let mut tree = FenwickTree::new();
+        assert_eq!(tree.find(0.0), None);
+        for (index, &weight) in weights.iter().enumerate() {
+            assert_eq!(tree.push(weight), index);
+        }
+
+        for len in 0..=weights.len() {
+            assert_eq!(tree.prefix_sum(len), weights[..len].iter().sum::<f64>());
+        }
+        assert_eq!(tree.total(), 23.0);
+
+        assert_eq!(tree.find(0.0), Some(0));
+        assert_eq!(tree.find(2.5), Some(0));
+        // Entries without weight are never selected.
+        assert_eq!(tree.find(3.0), Some(2));
+        assert_eq!(tree.find(4.0), Some(3));
+        assert_eq!(tree.find(22.5), Some(6));
+        assert_eq!(tree.find(100.0), Some(6));
+
+        tree.set(6, 0.0);
+        tree.set(1, 2.0);
+        assert_eq!(tree.total(), 16.0);
+        assert_eq!(tree.find(3.0), Some(1));
+        assert_eq!(tree.find(15.5), Some(5));
+    }
+
+    #[test]
+    fn test_lazy_reweighting() {
+        let mut metadata = FenwickScheduleMetadata::new();
+        assert!(metadata.update_normalization_key(1));
+        for id in 0..3 {
+            metadata.push(CorpusId::from(id), 1.0);
+        }
+        assert!(!metadata.update_normalization_key(1));
+        assert_eq!(metadata.next_stale(), None);
+
+        metadata.remove(CorpusId::from(1_usize));
+        assert_eq!(metadata.tree().total(), 2.0);
+        assert_eq!(metadata.id(1), None);
+
+        assert!(metadata.update_normalization_key(2));
+        assert_eq!(metadata.epoch(), 1);
+        assert!(metadata.is_stale(0));
+        // Removed entries are not re-weighted.
+        assert!(!metadata.is_stale(1));
+
+        metadata.set_weight(2, 3.0);
+        assert_eq!(metadata.next_stale(), Some(0));
+        metadata.set_weight(0, 2.0);
+        assert_eq!(metadata.next_stale(), None);
+        assert_eq!(metadata.tree().total(), 5.0);
+
+        // Entries added in the new epoch are current.
+        metadata.push(CorpusId::from(3_usize), 1.0);
+        assert!(!metadata.is_stale(3));
+        assert_eq!(metadata.next_stale(), None);
+    }
+}
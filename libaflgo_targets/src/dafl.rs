@@ -1,10 +1,15 @@
-use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::atomic::{AtomicPtr, AtomicU64, Ordering};
 
 use libafl::prelude::{ExitKind, Named, Observer, OwnedRef, UsesInput};
 use serde::{Deserialize, Serialize};
 
 use libaflgo::DAFLObserver;
 
+use crate::{guards, shared::SharedStats};
+
+// The layout is relied upon by inline DAFL probes, see
+// passes/AFLGoLinker/InlineProbes.cpp
+#[repr(C)]
 #[derive(Debug, Serialize, Deserialize)]
 pub struct DAFLStats(AtomicU64);
 
@@ -26,13 +31,29 @@ impl DAFLStats {
     }
 }
 
+#[export_name = "__aflgo_dafl_stats"]
 static STATS: DAFLStats = DAFLStats::new();
 
+// Stats updated by the probes, either STATS or shared ones, see shared.rs.
+// Inline probes always update STATS.
+static STATS_PTR: AtomicPtr<DAFLStats> =
+    AtomicPtr::new(&STATS as *const DAFLStats as *mut DAFLStats);
+
+fn stats() -> &'static DAFLStats {
+    unsafe { &*STATS_PTR.load(Ordering::Relaxed) }
+}
+
+pub(crate) fn set_stats(stats: &'static DAFLStats) {
+    STATS_PTR.store(stats as *const DAFLStats as *mut DAFLStats, Ordering::Relaxed);
+}
+
 #[no_mangle]
 pub extern "C" fn __aflgo_trace_bb_dafl(bb_relevance: u64) {
-    STATS.add_bb_relevance(bb_relevance);
+    stats().add_bb_relevance(bb_relevance);
 }
 
+// With guard DAFL tables, the relevance is computed from the hit counts of the
+// edges map, so the observer must run its post_exec before the edges observer.
 #[derive(Debug, Serialize, Deserialize)]
 pub struct InProcessDAFLObserver<'a> {
     name: String,
@@ -42,7 +63,7 @@ pub struct InProcessDAFLObserver<'a> {
 
 impl<'a> InProcessDAFLObserver<'a> {
     pub fn new(name: String) -> Self {
-        Self::with_stats_ref(name, &STATS)
+        Self::with_stats_ref(name, stats())
     }
 
     #[must_use]
@@ -53,6 +74,12 @@ impl<'a> InProcessDAFLObserver<'a> {
             stats: OwnedRef::Ref(stats),
         }
     }
+
+    /// Observer of the stats of a shared region, see `shared::share_stats`
+    #[must_use]
+    pub fn with_shared_stats(name: String, stats: &'a SharedStats) -> Self {
+        Self::with_stats_ref(name, stats.dafl())
+    }
 }
 
 impl<S: UsesInput> DAFLObserver<S> for InProcessDAFLObserver<'_> {
@@ -80,7 +107,12 @@ impl<'a, S: UsesInput> Observer<S> for InProcessDAFLObserver<'a> {
         _input: &S::Input,
         _exit_kind: &ExitKind,
     ) -> Result<(), libafl::Error> {
-        self.relevance = Some(self.stats.as_ref().compute_test_case_relevance());
+        let weights = guards::dafl_weights();
+        self.relevance = Some(if weights.is_empty() {
+            self.stats.as_ref().compute_test_case_relevance()
+        } else {
+            weights.reduce(guards::edges_hitcounts()).0
+        });
         Ok(())
     }
 }
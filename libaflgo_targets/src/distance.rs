@@ -1,13 +1,18 @@
-use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::atomic::{AtomicPtr, AtomicU64, Ordering};
 
 use libafl::prelude::{ExitKind, Named, Observer, OwnedRef, UsesInput};
 use serde::{Deserialize, Serialize};
 
 use libaflgo::DistanceObserver;
 
+use crate::{guards, shared::SharedStats};
+
 // XXX: this should be kept in sync with passes/AFLGoLinker/DistanceInstrumentation.cpp
 const DISTANCE_RESOLUTION: f64 = 1e3;
 
+// The layout is relied upon by inline distance probes, see
+// passes/AFLGoLinker/InlineProbes.cpp
+#[repr(C)]
 #[derive(Debug, Serialize, Deserialize)]
 pub struct DistanceStats {
     bb_distance_sum: AtomicU64,
@@ -28,10 +33,18 @@ impl DistanceStats {
         self.bb_distance_count.fetch_add(1, Ordering::Relaxed);
     }
 
+    pub fn add_bb_distances(&self, bb_distance_sum: u64, bb_distance_count: u64) {
+        self.bb_distance_sum
+            .fetch_add(bb_distance_sum, Ordering::Relaxed);
+        self.bb_distance_count
+            .fetch_add(bb_distance_count, Ordering::Relaxed);
+    }
+
     pub fn compute_test_case_distance(&self) -> f64 {
-        let distance_restored =
-            self.bb_distance_sum.load(Ordering::Relaxed) as f64 / DISTANCE_RESOLUTION;
-        distance_restored / self.bb_distance_count.load(Ordering::Relaxed) as f64
+        test_case_distance(
+            self.bb_distance_sum.load(Ordering::Relaxed),
+            self.bb_distance_count.load(Ordering::Relaxed),
+        )
     }
 
     pub fn reset(&self) {
@@ -40,14 +53,42 @@ impl DistanceStats {
     }
 }
 
+fn test_case_distance(bb_distance_sum: u64, bb_distance_count: u64) -> f64 {
+    let distance_restored = bb_distance_sum as f64 / DISTANCE_RESOLUTION;
+    distance_restored / bb_distance_count as f64
+}
+
+#[export_name = "__aflgo_distance_stats"]
 static STATS: DistanceStats = DistanceStats::new();
 
+// Stats updated by the probes, either STATS or shared ones, see shared.rs.
+// Inline probes always update STATS.
+static STATS_PTR: AtomicPtr<DistanceStats> =
+    AtomicPtr::new(&STATS as *const DistanceStats as *mut DistanceStats);
+
+fn stats() -> &'static DistanceStats {
+    unsafe { &*STATS_PTR.load(Ordering::Relaxed) }
+}
+
+pub(crate) fn set_stats(stats: &'static DistanceStats) {
+    STATS_PTR.store(stats as *const DistanceStats as *mut DistanceStats, Ordering::Relaxed);
+}
+
 // Called by the distance instrumentation
 #[no_mangle]
 pub extern "C" fn __aflgo_trace_bb_distance(bb_distance: u64) {
-    STATS.add_bb_distance(bb_distance);
+    stats().add_bb_distance(bb_distance);
+}
+
+// Called by sparse distance probes, once for a group of basic blocks
+#[no_mangle]
+pub extern "C" fn __aflgo_trace_bb_distances(bb_distance_sum: u64, bb_distance_count: u64) {
+    stats().add_bb_distances(bb_distance_sum, bb_distance_count);
 }
 
+// With guard distance tables, the distance is computed from the hit counts of
+// the edges map, so the observer must run its post_exec before the edges
+// observer.
 #[derive(Debug, Serialize, Deserialize)]
 pub struct InProcessDistanceObserver<'a> {
     name: String,
@@ -57,7 +98,7 @@ pub struct InProcessDistanceObserver<'a> {
 
 impl<'a> InProcessDistanceObserver<'a> {
     pub fn new(name: String) -> Self {
-        Self::with_stats_ref(name, &STATS)
+        Self::with_stats_ref(name, stats())
     }
 
     #[must_use]
@@ -68,6 +109,12 @@ impl<'a> InProcessDistanceObserver<'a> {
             stats: OwnedRef::Ref(stats),
         }
     }
+
+    /// Observer of the stats of a shared region, see `shared::share_stats`
+    #[must_use]
+    pub fn with_shared_stats(name: String, stats: &'a SharedStats) -> Self {
+        Self::with_stats_ref(name, stats.distance())
+    }
 }
 impl<S: UsesInput> DistanceObserver<S> for InProcessDistanceObserver<'_> {
     fn distance(&self) -> f64 {
@@ -94,7 +141,14 @@ impl<'a, S: UsesInput> Observer<S> for InProcessDistanceObserver<'a> {
         _input: &S::Input,
         _exit_kind: &ExitKind,
     ) -> Result<(), libafl::Error> {
-        self.distance = Some(self.stats.as_ref().compute_test_case_distance());
+        let weights = guards::distance_weights();
+        self.distance = Some(if weights.is_empty() {
+            self.stats.as_ref().compute_test_case_distance()
+        } else {
+            let (bb_distance_sum, bb_distance_count) =
+                weights.reduce(guards::edges_hitcounts());
+            test_case_distance(bb_distance_sum, bb_distance_count)
+        });
         Ok(())
     }
 }
@@ -119,4 +173,31 @@ mod tests {
         let test_case_distance = stats.compute_test_case_distance();
         assert!(test_case_distance.is_nan());
     }
+
+    #[test]
+    fn test_sparse_distance_calculation() {
+        let stats = DistanceStats::new();
+
+        // A group of two blocks and a single one
+        stats.add_bb_distances(3 * DISTANCE_RESOLUTION as u64, 2);
+        stats.add_bb_distance(3 * DISTANCE_RESOLUTION as u64);
+
+        let test_case_distance = stats.compute_test_case_distance();
+        assert_eq!(test_case_distance, 2.0);
+    }
+
+    #[test]
+    fn test_inline_probe_layout() {
+        let stats = DistanceStats::new();
+
+        // Inline probes see the stats as an array of counters.
+        let counters = &stats as *const DistanceStats as *const AtomicU64;
+        unsafe {
+            (*counters).store(3 * DISTANCE_RESOLUTION as u64, Ordering::Relaxed);
+            (*counters.add(1)).store(2, Ordering::Relaxed);
+        }
+
+        let test_case_distance = stats.compute_test_case_distance();
+        assert_eq!(test_case_distance, 1.5);
+    }
 }
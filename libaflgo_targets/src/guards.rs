@@ -0,0 +1,242 @@
+use std::{
+    slice,
+    sync::{Mutex, OnceLock},
+};
+
+use libafl_targets::{EDGES_MAP, MAX_EDGES_NUM};
+
+use crate::shared;
+
+// XXX: this should be kept in sync with include/AFLGoLinker/GuardWeights.hpp
+const NO_WEIGHT: u64 = u64::MAX;
+
+// Edges reduced at once, so that the reduction is vectorized
+const LANES: usize = 16;
+
+// Guards of a function and their number, see
+// passes/AFLGoLinker/GuardWeights.cpp
+#[repr(C)]
+pub struct GuardTable {
+    guards: *const u32,
+    len: u64,
+}
+
+// Tables of a module, the weights of all their guards follow the order of the
+// tables.
+struct ModuleTables {
+    tables: *const GuardTable,
+    num_tables: usize,
+    weights: *const u64,
+}
+
+// The tables are read-only and live as long as the program.
+unsafe impl Send for ModuleTables {}
+
+struct Registry {
+    modules: Mutex<Vec<ModuleTables>>,
+    weights: OnceLock<GuardWeights>,
+}
+
+impl Registry {
+    const fn new() -> Self {
+        Self {
+            modules: Mutex::new(Vec::new()),
+            weights: OnceLock::new(),
+        }
+    }
+
+    fn register(&self, module: ModuleTables) {
+        self.modules.lock().unwrap().push(module);
+    }
+
+    // Guard IDs are assigned by the constructors of SanitizerCoverage, so the
+    // weights are resolved when they are first needed, once all have run.
+    fn weights(&self) -> &GuardWeights {
+        self.weights.get_or_init(|| {
+            let modules = self.modules.lock().unwrap();
+            unsafe { GuardWeights::from_modules(&modules) }
+        })
+    }
+}
+
+static DISTANCES: Registry = Registry::new();
+static DAFL: Registry = Registry::new();
+
+// Called by the constructor emitted with guard distance tables
+#[no_mangle]
+pub unsafe extern "C" fn __aflgo_register_guard_distances(
+    tables: *const GuardTable,
+    num_tables: u64,
+    weights: *const u64,
+) {
+    shared::register_unshareable("guard weight tables");
+    DISTANCES.register(ModuleTables {
+        tables,
+        num_tables: num_tables as usize,
+        weights,
+    });
+}
+
+// Called by the constructor emitted with guard DAFL tables
+#[no_mangle]
+pub unsafe extern "C" fn __aflgo_register_guard_dafl(
+    tables: *const GuardTable,
+    num_tables: u64,
+    weights: *const u64,
+) {
+    shared::register_unshareable("guard weight tables");
+    DAFL.register(ModuleTables {
+        tables,
+        num_tables: num_tables as usize,
+        weights,
+    });
+}
+
+/// Basic block distances of the edges, empty if the target has no tables
+pub fn distance_weights() -> &'static GuardWeights {
+    DISTANCES.weights()
+}
+
+/// DAFL scores of the edges, empty if the target has no tables
+pub fn dafl_weights() -> &'static GuardWeights {
+    DAFL.weights()
+}
+
+/// Hit counts of the edges in the last execution, until they are classified by
+/// the edges observer
+pub fn edges_hitcounts() -> &'static [u8] {
+    unsafe { &EDGES_MAP[..MAX_EDGES_NUM] }
+}
+
+/// Weights of the edges, indexed by the ID assigned to their guard
+#[derive(Debug, Default)]
+pub struct GuardWeights {
+    weights: Vec<u64>,
+    // 1 if the edge has a weight, 0 otherwise
+    weighted: Vec<u64>,
+}
+
+impl GuardWeights {
+    unsafe fn from_modules(modules: &[ModuleTables]) -> Self {
+        let mut res = Self::default();
+        for module in modules {
+            let tables = slice::from_raw_parts(module.tables, module.num_tables);
+            let mut weights = module.weights;
+            for table in tables {
+                let guards = slice::from_raw_parts(table.guards, table.len as usize);
+                let guard_weights = slice::from_raw_parts(weights, guards.len());
+                weights = weights.add(guards.len());
+
+                for (&id, &weight) in guards.iter().zip(guard_weights) {
+                    if weight != NO_WEIGHT {
+                        res.set(id as usize, weight);
+                    }
+                }
+            }
+        }
+        res
+    }
+
+    fn set(&mut self, id: usize, weight: u64) {
+        if id >= self.weights.len() {
+            self.weights.resize(id + 1, 0);
+            self.weighted.resize(id + 1, 0);
+        }
+        self.weights[id] = weight;
+        self.weighted[id] = 1;
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.weights.is_empty()
+    }
+
+    /// Sum of the weights of the edges and number of weighted edges, both
+    /// counting each edge as many times as it was hit. Hit counts wrap around
+    /// like the ones of the edges map.
+    pub fn reduce(&self, hitcounts: &[u8]) -> (u64, u64) {
+        let len = hitcounts.len().min(self.weights.len());
+        let hitcounts = &hitcounts[..len];
+        let weights = &self.weights[..len];
+        let weighted = &self.weighted[..len];
+
+        let mut sums = [0_u64; LANES];
+        let mut counts = [0_u64; LANES];
+        let chunks = hitcounts
+            .chunks_exact(LANES)
+            .zip(weights.chunks_exact(LANES))
+            .zip(weighted.chunks_exact(LANES));
+        for ((hits, weights), weighted) in chunks {
+            let hits: &[u8; LANES] = hits.try_into().unwrap();
+            // Most edges are not hit by a test case.
+            if u128::from_ne_bytes(*hits) == 0 {
+                continue;
+            }
+
+            let weights: &[u64; LANES] = weights.try_into().unwrap();
+            let weighted: &[u64; LANES] = weighted.try_into().unwrap();
+            for lane in 0..LANES {
+                let hit = u64::from(hits[lane]);
+                sums[lane] = sums[lane].wrapping_add(hit.wrapping_mul(weights[lane]));
+                counts[lane] = counts[lane].wrapping_add(hit * weighted[lane]);
+            }
+        }
+
+        let mut sum = sums.iter().fold(0_u64, |acc, &x| acc.wrapping_add(x));
+        let mut count = counts.iter().fold(0_u64, |acc, &x| acc.wrapping_add(x));
+        for idx in len - len % LANES..len {
+            let hit = u64::from(hitcounts[idx]);
+            sum = sum.wrapping_add(hit.wrapping_mul(weights[idx]));
+            count = count.wrapping_add(hit * weighted[idx]);
+        }
+
+        (sum, count)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_guard_weights() {
+        // IDs as assigned by SanitizerCoverage, one function per table
+        let first_guards: [u32; 3] = [2, 0, 1];
+        let second_guards: [u32; 2] = [40, 3];
+        let tables = [
+            GuardTable {
+                guards: first_guards.as_ptr(),
+                len: 3,
+            },
+            GuardTable {
+                guards: second_guards.as_ptr(),
+                len: 2,
+            },
+        ];
+        let weights = [10, NO_WEIGHT, 30, 400, 0];
+        let modules = [ModuleTables {
+            tables: tables.as_ptr(),
+            num_tables: tables.len(),
+            weights: weights.as_ptr(),
+        }];
+
+        let guard_weights = unsafe { GuardWeights::from_modules(&modules) };
+        assert!(!guard_weights.is_empty());
+
+        // Both in the vectorized part and in the tail
+        let mut hitcounts = [0_u8; 64];
+        hitcounts[0] = 5;
+        hitcounts[1] = 2;
+        hitcounts[2] = 1;
+        hitcounts[3] = 3;
+        hitcounts[40] = 2;
+        let (sum, count) = guard_weights.reduce(&hitcounts);
+        assert_eq!(sum, 2 * 30 + 10 + 2 * 400);
+        assert_eq!(count, 2 + 1 + 3 + 2);
+
+        let (sum, count) = guard_weights.reduce(&[0_u8; 64]);
+        assert_eq!((sum, count), (0, 0));
+
+        assert!(GuardWeights::default().is_empty());
+        assert_eq!(GuardWeights::default().reduce(&hitcounts), (0, 0));
+    }
+}
@@ -1,4 +1,7 @@
 pub mod dafl;
 pub mod distance;
+pub mod guards;
+pub mod shared;
 pub mod target;
+pub mod triage;
 pub mod similarity;
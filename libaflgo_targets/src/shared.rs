@@ -0,0 +1,314 @@
+use std::{
+    env, mem, process, ptr, slice,
+    sync::{
+        atomic::{AtomicPtr, AtomicU64, Ordering},
+        Mutex,
+    },
+};
+
+use libafl::{
+    bolts::{
+        shmem::{ShMem, ShMemProvider, StdShMemProvider},
+        AsMutSlice,
+    },
+    Error,
+};
+
+use crate::{
+    dafl::{self, DAFLStats},
+    distance::{self, DistanceStats},
+    similarity::{self, SimilarityStats},
+    target,
+};
+
+/// Environment variable with the shared region of the directed stats, see
+/// `ShMem::write_to_env`
+pub const SHARED_STATS_ENV: &str = "__AFLGO_SHARED_STATS";
+
+/// Directed stats and targets map in a region shared between the fuzzer and
+/// the processes that run the target, e.g., with `InProcessForkExecutor` or a
+/// forkserver. Once a process uses the region, its probes update it instead of
+/// the process-local stats. Inline probes and guard weight tables only work
+/// with the latter, so a process that has them refuses to use the region.
+#[repr(C)]
+#[derive(Debug)]
+pub struct SharedStats {
+    distance: DistanceStats,
+    dafl: DAFLStats,
+    similarity: SimilarityStats,
+    targets_map_len: u64,
+    // Largest number of targets registered by a process that uses the region,
+    // which the targets map may be too small for.
+    required_targets_map_len: AtomicU64,
+    // The targets map follows.
+}
+
+impl SharedStats {
+    /// Size of a region with a targets map of `targets_map_len` entries
+    #[must_use]
+    pub fn region_size(targets_map_len: usize) -> usize {
+        mem::size_of::<Self>() + targets_map_len
+    }
+
+    fn check_region(region: &[u8], targets_map_len: usize) -> Result<(), Error> {
+        if region.as_ptr() as usize % mem::align_of::<Self>() != 0 {
+            return Err(Error::illegal_argument("misaligned shared stats"));
+        }
+        if region.len() < Self::region_size(targets_map_len) {
+            return Err(Error::illegal_argument(format!(
+                "shared stats need {} bytes, the region has {}",
+                Self::region_size(targets_map_len),
+                region.len()
+            )));
+        }
+        Ok(())
+    }
+
+    /// Initializes the stats at the start of `region`.
+    pub fn init(region: &mut [u8], targets_map_len: usize) -> Result<&mut Self, Error> {
+        Self::check_region(region, targets_map_len)?;
+        region[..Self::region_size(targets_map_len)].fill(0);
+
+        let stats = region.as_mut_ptr() as *mut Self;
+        unsafe {
+            stats.write(Self {
+                distance: DistanceStats::new(),
+                dafl: DAFLStats::new(),
+                similarity: SimilarityStats::new(),
+                targets_map_len: targets_map_len as u64,
+                required_targets_map_len: AtomicU64::new(targets_map_len as u64),
+            });
+            Ok(&mut *stats)
+        }
+    }
+
+    /// Stats initialized at the start of `region`, e.g., by another process
+    pub fn from_region(region: &mut [u8]) -> Result<&mut Self, Error> {
+        Self::check_region(region, 0)?;
+        let stats = unsafe { &mut *(region.as_mut_ptr() as *mut Self) };
+        Self::check_region(region, stats.targets_map_len as usize)?;
+        Ok(stats)
+    }
+
+    #[must_use]
+    pub fn distance(&self) -> &DistanceStats {
+        &self.distance
+    }
+
+    #[must_use]
+    pub fn dafl(&self) -> &DAFLStats {
+        &self.dafl
+    }
+
+    #[must_use]
+    pub fn similarity(&self) -> &SimilarityStats {
+        &self.similarity
+    }
+
+    #[must_use]
+    pub fn targets_map_len(&self) -> usize {
+        self.targets_map_len as usize
+    }
+
+    /// Number of entries the targets map needs for the targets of the
+    /// processes that used the region so far
+    #[must_use]
+    pub fn required_targets_map_len(&self) -> usize {
+        self.required_targets_map_len.load(Ordering::Relaxed) as usize
+    }
+
+    /// Fails if the targets map is too small for the targets of a process that
+    /// used the region, whose hits past its end are ignored.
+    pub fn check_targets_map(&self) -> Result<(), Error> {
+        let required = self.required_targets_map_len();
+        if required > self.targets_map_len() {
+            return Err(Error::illegal_state(format!(
+                "the targets need a shared targets map of {required} entries, \
+                 the region has {}",
+                self.targets_map_len()
+            )));
+        }
+        Ok(())
+    }
+
+    pub(crate) fn targets_map_ptr(&self) -> *mut u8 {
+        unsafe { (self as *const Self).add(1) as *mut u8 }
+    }
+
+    pub fn targets_map(&mut self) -> &mut [u8] {
+        unsafe { slice::from_raw_parts_mut(self.targets_map_ptr(), self.targets_map_len()) }
+    }
+}
+
+// Shared stats that the probes of this process update, if any
+static ATTACHED: AtomicPtr<SharedStats> = AtomicPtr::new(ptr::null_mut());
+// Instrumentation of this process that cannot update shared stats, if any
+static UNSHAREABLE: Mutex<Option<&'static str>> = Mutex::new(None);
+
+fn unshareable_error(kind: &str) -> Error {
+    Error::illegal_state(format!(
+        "{kind} only update the stats of the process that runs them, so the \
+         stats cannot be shared"
+    ))
+}
+
+fn check_shareable() -> Result<(), Error> {
+    match *UNSHAREABLE.lock().unwrap() {
+        Some(kind) => Err(unshareable_error(kind)),
+        None => Ok(()),
+    }
+}
+
+// Called when a module is registered with instrumentation that updates the
+// process-local stats or maps in place.
+pub(crate) fn register_unshareable(kind: &'static str) {
+    *UNSHAREABLE.lock().unwrap() = Some(kind);
+    if !ATTACHED.load(Ordering::Relaxed).is_null() {
+        eprintln!("[AFLGo] {}", unshareable_error(kind));
+        process::abort();
+    }
+}
+
+// Called by the constructor emitted with inline probes
+#[no_mangle]
+pub extern "C" fn __aflgo_register_inline_probes() {
+    register_unshareable("inline probes");
+}
+
+// Called when a module registers `len` targets. Returns whether this process
+// uses shared stats, whose targets map must then be kept; if it is too small,
+// the required length is published for the fuzzer, see
+// `SharedStats::check_targets_map`.
+pub(crate) fn require_targets_map_len(len: usize) -> bool {
+    let Some(stats) = (unsafe { ATTACHED.load(Ordering::Relaxed).as_ref() }) else {
+        return false;
+    };
+
+    let previous = stats
+        .required_targets_map_len
+        .fetch_max(len as u64, Ordering::Relaxed) as usize;
+    if len > previous {
+        if let Err(error) = stats.check_targets_map() {
+            eprintln!("[AFLGo] {error}");
+        }
+    }
+    true
+}
+
+// Makes the probes of this process update the shared stats.
+unsafe fn use_stats(stats: *mut SharedStats) {
+    ATTACHED.store(stats, Ordering::Relaxed);
+    // Targets may have been registered before, e.g., by constructors that run
+    // before the one attaching from the environment.
+    require_targets_map_len(target::num_targets());
+    target::set_targets_map((*stats).targets_map());
+    let stats: &'static SharedStats = &*stats;
+    distance::set_stats(stats.distance());
+    dafl::set_stats(stats.dafl());
+    similarity::set_stats(stats.similarity());
+}
+
+/// Creates a region for the directed stats and `targets_map_len` targets and
+/// advertises it through the environment, so that targets started by a
+/// forkserver use it.
+pub fn new_shared_stats<SP: ShMemProvider>(
+    provider: &mut SP,
+    targets_map_len: usize,
+) -> Result<SP::ShMem, Error> {
+    let mut shmem = provider.new_shmem(SharedStats::region_size(targets_map_len))?;
+    SharedStats::init(shmem.as_mut_slice(), targets_map_len)?;
+    shmem.write_to_env(SHARED_STATS_ENV)?;
+    Ok(shmem)
+}
+
+/// Creates a region for the directed stats and the targets of this process,
+/// which its probes update from now on, e.g., in the children of
+/// `InProcessForkExecutor`. The observers must be created from the region, see
+/// `SharedStats::from_region`, which must not be dropped while fuzzing. Fails
+/// if the target has inline probes or guard weight tables.
+pub fn share_stats<SP: ShMemProvider>(provider: &mut SP) -> Result<SP::ShMem, Error> {
+    check_shareable()?;
+    let mut shmem = new_shared_stats(provider, target::targets_map_len())?;
+    let stats = SharedStats::from_region(shmem.as_mut_slice())?;
+    unsafe { use_stats(stats) };
+    Ok(shmem)
+}
+
+// Called by the constructor below, in targets started with a shared region in
+// the environment. Probes hit by earlier constructors update the local stats.
+fn attach_from_env() {
+    if env::var_os(SHARED_STATS_ENV).is_none() {
+        return;
+    }
+
+    // The fuzzer would not see the stats of this process.
+    if let Err(error) = check_shareable() {
+        eprintln!("[AFLGo] {error}");
+        process::abort();
+    }
+
+    let shmem = StdShMemProvider::new()
+        .and_then(|mut provider| provider.existing_from_env(SHARED_STATS_ENV));
+    // The region is used until the process exits.
+    let res = shmem.and_then(|shmem| {
+        let shmem = Box::leak(Box::new(shmem));
+        let stats = SharedStats::from_region(shmem.as_mut_slice())?;
+        unsafe { use_stats(stats) };
+        Ok(())
+    });
+    if let Err(error) = res {
+        eprintln!("[AFLGo] could not use the shared stats: {error}");
+    }
+}
+
+// Runs in every process that links the runtime, even if the instrumentation
+// emitted no constructor, e.g., in modules without targets. It has the default
+// priority, so libc and the Rust runtime are initialized, and it runs after
+// the constructors that register guard tables or inline probes.
+#[used]
+#[cfg_attr(target_os = "linux", link_section = ".init_array")]
+#[cfg_attr(target_vendor = "apple", link_section = "__DATA,__mod_init_func")]
+static ATTACH_FROM_ENV: extern "C" fn() = {
+    extern "C" fn attach() {
+        attach_from_env();
+    }
+    attach
+};
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_shared_stats_layout() {
+        // u64 for the alignment of the stats
+        let mut buffer = vec![0_u64; SharedStats::region_size(3) / 8 + 1];
+        let region =
+            unsafe { slice::from_raw_parts_mut(buffer.as_mut_ptr() as *mut u8, buffer.len() * 8) };
+
+        let stats = SharedStats::init(region, 3).unwrap();
+        stats.distance().add_bb_distance(2000);
+        stats.dafl().add_bb_relevance(7);
+        stats.targets_map()[2] = 1;
+
+        // As seen by another process
+        let stats = SharedStats::from_region(region).unwrap();
+        assert_eq!(stats.distance().compute_test_case_distance(), 2.0);
+        assert_eq!(stats.dafl().compute_test_case_relevance(), 7);
+        assert_eq!(stats.targets_map(), &[0, 0, 1]);
+        assert!(stats.check_targets_map().is_ok());
+
+        // Published by a process with more targets
+        stats
+            .required_targets_map_len
+            .fetch_max(4, Ordering::Relaxed);
+        let stats = SharedStats::from_region(region).unwrap();
+        assert_eq!(stats.required_targets_map_len(), 4);
+        assert_eq!(stats.targets_map().len(), 3);
+        assert!(stats.check_targets_map().is_err());
+
+        assert!(SharedStats::init(&mut region[..SharedStats::region_size(3) - 1], 3).is_err());
+        assert!(SharedStats::from_region(&mut region[..SharedStats::region_size(0)]).is_err());
+        assert!(SharedStats::from_region(&mut region[1..]).is_err());
+    }
+}
@@ -1,12 +1,19 @@
-use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::atomic::{AtomicPtr, AtomicU64, Ordering};
 
 use libafl::prelude::{ExitKind, Named, Observer, OwnedRef, UsesInput};
 use serde::{Deserialize, Serialize};
 
 use libaflgo::SimilarityObserver;
 
+use crate::shared::SharedStats;
+
+// XXX: this should be kept in sync with
+// passes/AFLGoLinker/FunctionDistanceInstrumentation.cpp
 const SIMILARITY_RESOLUTION: f64 = 1e3;
 
+// The layout is relied upon by inline similarity probes, see
+// passes/AFLGoLinker/InlineProbes.cpp
+#[repr(C)]
 #[derive(Debug, Serialize, Deserialize)]
 pub struct SimilarityStats {
     similarity_inc_sum: AtomicU64,
@@ -22,9 +29,10 @@ impl SimilarityStats {
     }
 
     pub fn add_fun_distance(&self, fun_distance: f64) {
-        let similarity_inc = 1_f64 / fun_distance;
-        let similarity_inc_approx = (similarity_inc * SIMILARITY_RESOLUTION).trunc() as u64;
+        self.add_similarity_inc(similarity_inc(fun_distance));
+    }
 
+    pub fn add_similarity_inc(&self, similarity_inc_approx: u64) {
         self.similarity_inc_sum
             .fetch_add(similarity_inc_approx, Ordering::Relaxed);
         self.similarity_inc_count.fetch_add(1, Ordering::Relaxed);
@@ -42,12 +50,43 @@ impl SimilarityStats {
     }
 }
 
+// Fixed-point similarity increment of a function distance, the instrumentation
+// computes the same at link time.
+fn similarity_inc(fun_distance: f64) -> u64 {
+    let similarity_inc = 1_f64 / fun_distance;
+    (similarity_inc * SIMILARITY_RESOLUTION).trunc() as u64
+}
+
+#[export_name = "__aflgo_similarity_stats"]
 static STATS: SimilarityStats = SimilarityStats::new();
 
-// Called by the function distance instrumentation
+// Stats updated by the probes, either STATS or shared ones, see shared.rs.
+// Inline probes always update STATS.
+static STATS_PTR: AtomicPtr<SimilarityStats> =
+    AtomicPtr::new(&STATS as *const SimilarityStats as *mut SimilarityStats);
+
+fn stats() -> &'static SimilarityStats {
+    unsafe { &*STATS_PTR.load(Ordering::Relaxed) }
+}
+
+pub(crate) fn set_stats(stats: &'static SimilarityStats) {
+    STATS_PTR.store(
+        stats as *const SimilarityStats as *mut SimilarityStats,
+        Ordering::Relaxed,
+    );
+}
+
+// Called by the function distance instrumentation of older builds
 #[no_mangle]
 pub extern "C" fn __aflgo_trace_fun_distance(fun_distance: f64) {
-    STATS.add_fun_distance(fun_distance)
+    stats().add_fun_distance(fun_distance)
+}
+
+// Called by the function distance instrumentation with the similarity increment
+// of the function
+#[no_mangle]
+pub extern "C" fn __aflgo_trace_fun_similarity(similarity_inc: u64) {
+    stats().add_similarity_inc(similarity_inc)
 }
 
 #[derive(Debug, Serialize, Deserialize)]
@@ -59,7 +98,7 @@ pub struct InProcessSimilarityObserver<'a> {
 
 impl<'a> InProcessSimilarityObserver<'a> {
     pub fn new(name: String) -> Self {
-        Self::with_stats_ref(name, &STATS)
+        Self::with_stats_ref(name, stats())
     }
 
     #[must_use]
@@ -70,6 +109,12 @@ impl<'a> InProcessSimilarityObserver<'a> {
             stats: OwnedRef::Ref(stats),
         }
     }
+
+    /// Observer of the stats of a shared region, see `shared::share_stats`
+    #[must_use]
+    pub fn with_shared_stats(name: String, stats: &'a SharedStats) -> Self {
+        Self::with_stats_ref(name, stats.similarity())
+    }
 }
 impl<S: UsesInput> SimilarityObserver<S> for InProcessSimilarityObserver<'_> {
     fn similarity(&self) -> f64 {
@@ -121,4 +166,25 @@ mod tests {
         let test_case_similarity = stats.compute_similarity();
         assert!(test_case_similarity.is_nan());
     }
+
+    #[test]
+    fn test_similarity_increments() {
+        // As computed by passes/AFLGoLinker/FunctionDistanceInstrumentation.cpp
+        assert_eq!(similarity_inc(0.0), u64::MAX);
+        assert_eq!(similarity_inc(1.0), 1000);
+        assert_eq!(similarity_inc(4.0 / 3.0), 750);
+        assert_eq!(similarity_inc(2.25), 444);
+        assert_eq!(similarity_inc(3.0), 333);
+
+        let float_stats = SimilarityStats::new();
+        let int_stats = SimilarityStats::new();
+        for fun_distance in [1.0, 2.25, 3.0] {
+            float_stats.add_fun_distance(fun_distance);
+            int_stats.add_similarity_inc(similarity_inc(fun_distance));
+        }
+        assert_eq!(
+            float_stats.compute_similarity(),
+            int_stats.compute_similarity()
+        );
+    }
 }
@@ -1,17 +1,151 @@
+use std::{ffi::CStr, os::raw::c_char, ptr, slice, sync::Mutex};
+
 use libafl::prelude::StdMapObserver;
 
-const TARGETS_MAP_SIZE: usize = 256;
-static mut TARGETS_MAP: [u8; TARGETS_MAP_SIZE] = [0; TARGETS_MAP_SIZE];
+use crate::shared::{self, SharedStats};
+
+// Size of the map when no target was registered, the map observers expect it
+// not to be empty.
+const MIN_TARGETS_MAP_SIZE: usize = 1;
+
+// The map is allocated by the constructor emitted by the target injection
+// fixup pass, before any target can be hit, and lives as long as the program.
+// It may be replaced by a shared one, see shared.rs, which is then kept even if
+// a module registers more targets than it has.
+static mut TARGETS_MAP_PTR: *mut u8 = ptr::null_mut();
+static mut TARGETS_MAP_LEN: usize = 0;
+
+static TARGET_LOCATIONS: Mutex<Vec<String>> = Mutex::new(Vec::new());
+
+unsafe fn resize_targets_map(len: usize) {
+    if len <= TARGETS_MAP_LEN {
+        return;
+    }
+
+    let mut map = vec![0_u8; len];
+    if !TARGETS_MAP_PTR.is_null() {
+        map[..TARGETS_MAP_LEN].copy_from_slice(targets_map());
+    }
+
+    // The previous map is leaked, as the runtime may still refer to it.
+    TARGETS_MAP_PTR = Box::leak(map.into_boxed_slice()).as_mut_ptr();
+    TARGETS_MAP_LEN = len;
+}
+
+unsafe fn targets_map() -> &'static mut [u8] {
+    if TARGETS_MAP_PTR.is_null() {
+        resize_targets_map(MIN_TARGETS_MAP_SIZE);
+    }
+    slice::from_raw_parts_mut(TARGETS_MAP_PTR, TARGETS_MAP_LEN)
+}
+
+// Hits recorded in the previous map are not carried over.
+pub(crate) unsafe fn set_targets_map(map: &'static mut [u8]) {
+    TARGETS_MAP_PTR = map.as_mut_ptr();
+    TARGETS_MAP_LEN = map.len();
+}
+
+// Called by the constructor emitted by the target injection fixup pass. Each
+// module numbers its targets from 0, so the map fits the largest one.
+#[no_mangle]
+pub unsafe extern "C" fn __aflgo_register_targets(
+    num_targets: u32,
+    locations: *const *const c_char,
+) {
+    let num_targets = num_targets as usize;
+    // A shared map is not replaced, the fuzzer would not see the new one.
+    if !shared::require_targets_map_len(num_targets) {
+        resize_targets_map(num_targets.max(MIN_TARGETS_MAP_SIZE));
+    }
+
+    let mut target_locations = TARGET_LOCATIONS.lock().unwrap();
+    let locations = slice::from_raw_parts(locations, num_targets);
+    for &location in &locations[target_locations.len().min(num_targets)..] {
+        let location = CStr::from_ptr(location).to_string_lossy().into_owned();
+        target_locations.push(location);
+    }
+}
 
 // Called by the target instrumentation
 #[no_mangle]
 pub unsafe extern "C" fn __aflgo_trace_bb_target(target_id: u32) {
-    TARGETS_MAP[target_id as usize] += 1;
+    let target_id = target_id as usize;
+    // Targets of modules that were not registered are ignored.
+    if target_id < TARGETS_MAP_LEN {
+        let hits = TARGETS_MAP_PTR.add(target_id);
+        *hits = (*hits).wrapping_add(1);
+    }
+}
+
+/// Number of entries of the targets map
+pub fn targets_map_len() -> usize {
+    unsafe { targets_map().len() }
+}
+
+// Number of targets of the largest module registered so far
+pub(crate) fn num_targets() -> usize {
+    TARGET_LOCATIONS.lock().unwrap().len()
+}
+
+/// `file:line` location of each target, indexed by target ID
+pub fn target_locations() -> Vec<String> {
+    TARGET_LOCATIONS.lock().unwrap().clone()
 }
 
 pub unsafe fn get_targets_map_observer<'a, S>(name: S) -> StdMapObserver<'a, u8, false>
 where
     S: Into<String>,
 {
-    StdMapObserver::new(name, &mut TARGETS_MAP)
+    StdMapObserver::new(name, targets_map())
+}
+
+/// Observer of the targets map of a shared region, see `shared::share_stats`
+pub unsafe fn get_shared_targets_map_observer<'a, S>(
+    name: S,
+    stats: &'a SharedStats,
+) -> StdMapObserver<'a, u8, false>
+where
+    S: Into<String>,
+{
+    StdMapObserver::from_mut_ptr(name, stats.targets_map_ptr(), stats.targets_map_len())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_register_targets() {
+        let first = b"a.c:1\0";
+        let second = b"b.c:2\0";
+        let third = b"c.c:3\0";
+        let locations = [
+            first.as_ptr() as *const c_char,
+            second.as_ptr() as *const c_char,
+            third.as_ptr() as *const c_char,
+        ];
+
+        unsafe {
+            __aflgo_register_targets(2, locations.as_ptr());
+            assert_eq!(targets_map().len(), 2);
+
+            __aflgo_trace_bb_target(1);
+            __aflgo_trace_bb_target(1);
+            // Out of bounds
+            __aflgo_trace_bb_target(2);
+            assert_eq!(targets_map(), &[0, 2]);
+
+            // A larger module keeps the hits and the locations of the others.
+            __aflgo_register_targets(3, locations.as_ptr());
+            assert_eq!(targets_map(), &[0, 2, 0]);
+            __aflgo_trace_bb_target(2);
+            assert_eq!(targets_map(), &[0, 2, 1]);
+
+            // A smaller one does not shrink the map.
+            __aflgo_register_targets(1, locations.as_ptr());
+            assert_eq!(targets_map().len(), 3);
+        }
+
+        assert_eq!(target_locations(), vec!["a.c:1", "b.c:2", "c.c:3"]);
+    }
 }
@@ -0,0 +1,486 @@
+use std::{
+    cmp::Ordering,
+    collections::{HashMap, HashSet},
+    fmt::Write as _,
+    fs::{self, File, OpenOptions},
+    io::{BufWriter, Write},
+    ops::Range,
+    path::{Path, PathBuf},
+    process,
+    time::Duration,
+};
+
+use libafl::{
+    inputs::{BytesInput, UsesInput},
+    prelude::{ExitKind, MapObserver, Observer},
+    Error,
+};
+use libafl_targets::{EDGES_MAP, MAX_EDGES_NUM};
+use libaflgo::{DAFLObserver, DistanceObserver, SimilarityObserver};
+use nix::{
+    sys::{signal::Signal, wait::WaitStatus},
+    unistd::{self, alarm, ForkResult, Pid},
+};
+
+use crate::{
+    dafl::InProcessDAFLObserver, distance::InProcessDistanceObserver,
+    similarity::InProcessSimilarityObserver, target::get_targets_map_observer,
+};
+
+/// How a seed run ended
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SeedExit {
+    Ok,
+    Crash,
+    Timeout,
+}
+
+impl SeedExit {
+    fn as_str(self) -> &'static str {
+        match self {
+            SeedExit::Ok => "ok",
+            SeedExit::Crash => "crash",
+            SeedExit::Timeout => "timeout",
+        }
+    }
+
+    fn parse(exit: &str) -> Option<Self> {
+        match exit {
+            "ok" => Some(SeedExit::Ok),
+            "crash" => Some(SeedExit::Crash),
+            "timeout" => Some(SeedExit::Timeout),
+            _ => None,
+        }
+    }
+}
+
+/// Directed metrics of a seed, as seen by the observers of the fuzzers.
+/// Metrics without instrumentation in the target are NaN or 0.
+#[derive(Debug, Clone)]
+pub struct SeedReport {
+    pub path: PathBuf,
+    pub exit: SeedExit,
+    pub distance: f64,
+    pub similarity: f64,
+    pub relevance: u64,
+    pub targets_hit: Vec<usize>,
+    pub edges: Vec<usize>,
+}
+
+impl SeedReport {
+    fn failed(path: PathBuf, exit: SeedExit) -> Self {
+        Self {
+            path,
+            exit,
+            distance: f64::NAN,
+            similarity: f64::NAN,
+            relevance: 0,
+            targets_hit: Vec::new(),
+            edges: Vec::new(),
+        }
+    }
+
+    // One line of the results of a worker, which refers to the seed by index
+    fn encode(&self, index: usize) -> String {
+        let join = |ids: &[usize]| {
+            let ids: Vec<String> = ids.iter().map(usize::to_string).collect();
+            ids.join(" ")
+        };
+        format!(
+            "{index}\t{}\t{}\t{}\t{}\t{}\t{}\n",
+            self.exit.as_str(),
+            self.distance,
+            self.similarity,
+            self.relevance,
+            join(&self.targets_hit),
+            join(&self.edges)
+        )
+    }
+
+    fn decode(line: &str, seeds: &[PathBuf]) -> Option<(usize, Self)> {
+        let ids = |field: &str| {
+            field
+                .split_whitespace()
+                .map(str::parse)
+                .collect::<Result<Vec<usize>, _>>()
+                .ok()
+        };
+
+        let fields: Vec<&str> = line.split('\t').collect();
+        let [index, exit, distance, similarity, relevance, targets_hit, edges] = fields[..] else { return None; };
+        let index: usize = index.parse().ok()?;
+        let report = Self {
+            path: seeds.get(index)?.clone(),
+            exit: SeedExit::parse(exit)?,
+            distance: distance.parse().ok()?,
+            similarity: similarity.parse().ok()?,
+            relevance: relevance.parse().ok()?,
+            targets_hit: ids(targets_hit)?,
+            edges: ids(edges)?,
+        };
+        Some((index, report))
+    }
+}
+
+/// Order of the seeds, from the most to the least promising
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TriageOrder {
+    /// Increasing distance, for AFLGo-like fuzzers
+    Distance,
+    /// Decreasing relevance, for DAFL
+    Relevance,
+}
+
+// Observers only need the type of the inputs.
+#[derive(Debug)]
+struct TriageState;
+
+impl UsesInput for TriageState {
+    type Input = BytesInput;
+}
+
+// Runs the harness on a seed with the observers of the fuzzers.
+fn measure(harness: &mut dyn FnMut(&[u8]), path: &Path) -> Result<SeedReport, Error> {
+    let buffer = fs::read(path)?;
+    let input = BytesInput::new(buffer.clone());
+    let state = &mut TriageState;
+
+    let mut distance_observer = InProcessDistanceObserver::new(String::from("distance"));
+    let mut similarity_observer = InProcessSimilarityObserver::new(String::from("similarity"));
+    let mut dafl_observer = InProcessDAFLObserver::new(String::from("dafl"));
+    let mut targets_observer = unsafe { get_targets_map_observer("targets") };
+
+    distance_observer.pre_exec(state, &input)?;
+    similarity_observer.pre_exec(state, &input)?;
+    dafl_observer.pre_exec(state, &input)?;
+    Observer::<TriageState>::pre_exec(&mut targets_observer, state, &input)?;
+    unsafe { EDGES_MAP[..MAX_EDGES_NUM].fill(0) };
+
+    harness(&buffer);
+
+    // The observers read the raw hit counts of the edges.
+    let exit_kind = ExitKind::Ok;
+    distance_observer.post_exec(state, &input, &exit_kind)?;
+    similarity_observer.post_exec(state, &input, &exit_kind)?;
+    dafl_observer.post_exec(state, &input, &exit_kind)?;
+    Observer::<TriageState>::post_exec(&mut targets_observer, state, &input, &exit_kind)?;
+
+    let initial = targets_observer.initial();
+    let targets_hit = (0..targets_observer.usable_count())
+        .filter(|&target_id| *targets_observer.get(target_id) != initial)
+        .collect();
+    let edges = unsafe { &EDGES_MAP[..MAX_EDGES_NUM] };
+    let edges = (0..edges.len()).filter(|&edge| edges[edge] != 0).collect();
+
+    Ok(SeedReport {
+        path: path.to_path_buf(),
+        exit: SeedExit::Ok,
+        distance: DistanceObserver::<TriageState>::distance(&distance_observer),
+        similarity: SimilarityObserver::<TriageState>::similarity(&similarity_observer),
+        relevance: DAFLObserver::<TriageState>::relevance(&dafl_observer),
+        targets_hit,
+        edges,
+    })
+}
+
+// Measures the seeds in `range`, appending a line to `results` for each.
+// Crashes and timeouts kill the worker, the parent resumes after the seed.
+fn run_worker(
+    harness: &mut dyn FnMut(&[u8]),
+    seeds: &[PathBuf],
+    range: Range<usize>,
+    results: &Path,
+    timeout: Duration,
+) -> Result<(), Error> {
+    let mut results = OpenOptions::new().append(true).create(true).open(results)?;
+    // Rounded up to the resolution of alarm()
+    let timeout = ((timeout.as_millis() + 999) / 1000).max(1) as u32;
+
+    for index in range {
+        alarm::set(timeout);
+        let report = measure(harness, &seeds[index])?;
+        alarm::cancel();
+        results.write_all(report.encode(index).as_bytes())?;
+    }
+    Ok(())
+}
+
+fn spawn_worker(
+    harness: &mut dyn FnMut(&[u8]),
+    seeds: &[PathBuf],
+    range: Range<usize>,
+    results: &Path,
+    timeout: Duration,
+) -> Result<Pid, Error> {
+    match unsafe { unistd::fork() } {
+        Ok(ForkResult::Parent { child }) => Ok(child),
+        Ok(ForkResult::Child) => {
+            if let Err(error) = run_worker(harness, seeds, range, results, timeout) {
+                eprintln!("Triage worker failed: {error}");
+                process::exit(1);
+            }
+            process::exit(0);
+        }
+        Err(error) => Err(Error::unknown(format!("could not fork a worker: {error}"))),
+    }
+}
+
+/// Measures the seeds on `jobs` forked workers, each running the harness on a
+/// contiguous share of them. A seed that crashes or times out is reported as
+/// such and its worker is restarted with the following seeds. The reports
+/// are in the order of `seeds`.
+pub fn triage_seeds(
+    harness: &mut dyn FnMut(&[u8]),
+    seeds: &[PathBuf],
+    jobs: usize,
+    timeout: Duration,
+    work_dir: &Path,
+) -> Result<Vec<SeedReport>, Error> {
+    let jobs = jobs.clamp(1, seeds.len().max(1));
+    let share = (seeds.len() + jobs - 1) / jobs;
+
+    let mut reports: Vec<Option<SeedReport>> = vec![None; seeds.len()];
+    let mut workers = HashMap::new();
+    for job in 0..jobs {
+        let range = job * share..((job + 1) * share).min(seeds.len());
+        if range.is_empty() {
+            continue;
+        }
+
+        let results = work_dir.join(format!(".triage-{job}"));
+        File::create(&results)?;
+        let pid = spawn_worker(harness, seeds, range.clone(), &results, timeout)?;
+        workers.insert(pid, (range, results));
+    }
+
+    while !workers.is_empty() {
+        let status = nix::sys::wait::wait()
+            .map_err(|error| Error::unknown(format!("could not wait for a worker: {error}")))?;
+        let Some(pid) = status.pid() else { continue; };
+        let Some((range, results)) = workers.remove(&pid) else { continue; };
+
+        for line in fs::read_to_string(&results)?.lines() {
+            if let Some((index, report)) = SeedReport::decode(line, seeds) {
+                reports[index] = Some(report);
+            }
+        }
+
+        let Some(next) = range.clone().find(|&index| reports[index].is_none()) else {
+            fs::remove_file(&results)?;
+            continue;
+        };
+
+        // The worker stopped on this seed.
+        let exit = match status {
+            WaitStatus::Signaled(_, Signal::SIGALRM, _) => SeedExit::Timeout,
+            _ => SeedExit::Crash,
+        };
+        reports[next] = Some(SeedReport::failed(seeds[next].clone(), exit));
+
+        let range = next + 1..range.end;
+        if range.is_empty() {
+            fs::remove_file(&results)?;
+        } else {
+            let pid = spawn_worker(harness, seeds, range.clone(), &results, timeout)?;
+            workers.insert(pid, (range, results));
+        }
+    }
+
+    Ok(reports.into_iter().flatten().collect())
+}
+
+/// Regular files in `dir`, sorted by name
+pub fn seed_files(dir: &Path) -> Result<Vec<PathBuf>, Error> {
+    let mut seeds = Vec::new();
+    for entry in fs::read_dir(dir)? {
+        let entry = entry?;
+        if entry.file_type()?.is_file() {
+            seeds.push(entry.path());
+        }
+    }
+    seeds.sort();
+    Ok(seeds)
+}
+
+fn compare_reports(order: TriageOrder, a: &SeedReport, b: &SeedReport) -> Ordering {
+    // Seeds that do not run to completion come last.
+    let failed = |report: &SeedReport| report.exit != SeedExit::Ok;
+    failed(a).cmp(&failed(b)).then_with(|| match order {
+        // Unknown distances come last.
+        TriageOrder::Distance => match (a.distance.is_nan(), b.distance.is_nan()) {
+            (false, false) => a.distance.total_cmp(&b.distance),
+            (nan_a, nan_b) => nan_a.cmp(&nan_b),
+        },
+        TriageOrder::Relevance => b.relevance.cmp(&a.relevance),
+    })
+}
+
+/// Sorts the reports from the most to the least promising seed, the order is
+/// stable.
+pub fn sort_reports(reports: &mut [SeedReport], order: TriageOrder) {
+    reports.sort_by(|a, b| compare_reports(order, a, b));
+}
+
+/// Greedy minimization of sorted reports: a seed is kept if it hits an edge or
+/// a target that no better seed hits. Crashes and timeouts are left out.
+#[must_use]
+pub fn minimize(reports: &[SeedReport]) -> Vec<&SeedReport> {
+    let mut edges = HashSet::new();
+    let mut targets = HashSet::new();
+
+    let mut kept = Vec::new();
+    for report in reports.iter().filter(|report| report.exit == SeedExit::Ok) {
+        let mut new_coverage = false;
+        for &edge in &report.edges {
+            new_coverage |= edges.insert(edge);
+        }
+        for &target_id in &report.targets_hit {
+            new_coverage |= targets.insert(target_id);
+        }
+
+        if new_coverage {
+            kept.push(report);
+        }
+    }
+    kept
+}
+
+/// Copies the seeds of the reports to `dir`.
+pub fn copy_seeds(reports: &[&SeedReport], dir: &Path) -> Result<(), Error> {
+    fs::create_dir_all(dir)?;
+    for report in reports {
+        if let Some(name) = report.path.file_name() {
+            fs::copy(&report.path, dir.join(name))?;
+        }
+    }
+    Ok(())
+}
+
+fn csv_field(field: &str) -> String {
+    if field.contains([',', '"', '\n']) {
+        format!("\"{}\"", field.replace('"', "\"\""))
+    } else {
+        field.to_string()
+    }
+}
+
+// Unknown metrics are left empty.
+fn csv_metric(metric: f64) -> String {
+    if metric.is_nan() {
+        String::new()
+    } else {
+        metric.to_string()
+    }
+}
+
+/// Writes one CSV row per report, in order.
+pub fn write_csv(path: &Path, reports: &[SeedReport]) -> Result<(), Error> {
+    let mut csv = BufWriter::new(File::create(path)?);
+    writeln!(
+        csv,
+        "seed,exit,distance,similarity,relevance,targets_hit,edges"
+    )?;
+    for report in reports {
+        let mut targets_hit = String::new();
+        for target_id in &report.targets_hit {
+            if !targets_hit.is_empty() {
+                targets_hit.push(' ');
+            }
+            write!(targets_hit, "{target_id}").unwrap();
+        }
+
+        writeln!(
+            csv,
+            "{},{},{},{},{},{},{}",
+            csv_field(&report.path.to_string_lossy()),
+            report.exit.as_str(),
+            csv_metric(report.distance),
+            csv_metric(report.similarity),
+            report.relevance,
+            targets_hit,
+            report.edges.len()
+        )?;
+    }
+    csv.flush()?;
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn report(name: &str, distance: f64, relevance: u64, edges: &[usize]) -> SeedReport {
+        SeedReport {
+            path: PathBuf::from(name),
+            exit: SeedExit::Ok,
+            distance,
+            similarity: f64::NAN,
+            relevance,
+            targets_hit: Vec::new(),
+            edges: edges.to_vec(),
+        }
+    }
+
+    #[test]
+    fn test_encode_report() {
+        let seeds = vec![PathBuf::from("a"), PathBuf::from("b")];
+        let mut expected = report("b", 1.5, 3, &[2, 7]);
+        expected.targets_hit = vec![0];
+
+        let line = expected.encode(1);
+        let (index, decoded) = SeedReport::decode(line.trim_end(), &seeds).unwrap();
+        assert_eq!(index, 1);
+        assert_eq!(decoded.path, expected.path);
+        assert_eq!(decoded.distance, 1.5);
+        assert!(decoded.similarity.is_nan());
+        assert_eq!(decoded.targets_hit, vec![0]);
+        assert_eq!(decoded.edges, vec![2, 7]);
+
+        // Lines cut short by a crash are skipped.
+        assert!(SeedReport::decode(&line[..line.len() / 2], &seeds).is_none());
+        assert!(SeedReport::decode(line.replace("1\t", "2\t").trim_end(), &seeds).is_none());
+    }
+
+    #[test]
+    fn test_sort_and_minimize() {
+        let mut reports = vec![
+            report("far", 3.0, 1, &[1, 2]),
+            report("unknown", f64::NAN, 0, &[4]),
+            SeedReport::failed(PathBuf::from("crash"), SeedExit::Crash),
+            report("close", 1.0, 2, &[1]),
+            report("middle", 2.0, 5, &[1, 2]),
+        ];
+
+        let names = |reports: &[&SeedReport]| -> Vec<String> {
+            reports
+                .iter()
+                .map(|report| report.path.to_string_lossy().into_owned())
+                .collect()
+        };
+
+        sort_reports(&mut reports, TriageOrder::Distance);
+        let sorted: Vec<&SeedReport> = reports.iter().collect();
+        assert_eq!(
+            names(&sorted),
+            ["close", "middle", "far", "unknown", "crash"]
+        );
+        // "far" adds nothing to the closer seeds.
+        assert_eq!(names(&minimize(&reports)), ["close", "middle", "unknown"]);
+
+        sort_reports(&mut reports, TriageOrder::Relevance);
+        let sorted: Vec<&SeedReport> = reports.iter().collect();
+        assert_eq!(
+            names(&sorted),
+            ["middle", "close", "far", "unknown", "crash"]
+        );
+        assert_eq!(names(&minimize(&reports)), ["middle", "unknown"]);
+    }
+
+    #[test]
+    fn test_csv_fields() {
+        assert_eq!(csv_field("seeds/a"), "seeds/a");
+        assert_eq!(csv_field("a,\"b\""), "\"a,\"\"b\"\"\"");
+        assert_eq!(csv_metric(f64::NAN), "");
+        assert_eq!(csv_metric(2.5), "2.5");
+    }
+}
@@ -1,7 +1,8 @@
 #include <AFLGoCompiler/TargetInjection.hpp>
+#include <Analysis/DIFilePathCache.hpp>
 #include <Analysis/TargetDetection.hpp>
 
-#include <llvm/ADT/SmallSet.h>
+#include <llvm/ADT/BitVector.h>
 #include <llvm/ADT/SmallString.h>
 #include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/IRBuilder.h>
@@ -30,31 +31,44 @@ cl::opt<bool>
                      cl::desc("Don't error out if targets are not found."),
                      cl::init(false));
 
-bool AFLGoTargetInjectionPass::Target::matches(const DILocation &Loc) {
-  auto Line = Loc.getLine();
-  auto File = Loc.getFilename();
-  auto Directory = Loc.getDirectory();
-
-  if (File.empty()) {
+Optional<unsigned int>
+AFLGoTargetInjectionPass::findTarget(const DILocation &Loc,
+                                     FileTargetsCacheTy &FileTargetsCache) {
+  const auto *EffectiveLoc = &Loc;
+  if (Loc.getFilename().empty()) {
     if (auto *OriginalLoc = Loc.getInlinedAt()) {
-      Line = OriginalLoc->getLine();
-      File = OriginalLoc->getFilename();
-      Directory = OriginalLoc->getDirectory();
+      EffectiveLoc = OriginalLoc;
+    }
+  }
+
+  auto *File = EffectiveLoc->getFile();
+  if (!File) {
+    return None;
+  }
+
+  // Resolving a path requires syscalls, so do it only once per DIFile.
+  auto CacheIt = FileTargetsCache.find(File);
+  if (CacheIt == FileTargetsCache.end()) {
+    const TargetLinesTy *FileTargets = nullptr;
+    auto Path = resolveSourcePath(*File, !SkipRealPath);
+    auto TargetsIt = TargetsByFile.find(Path);
+    if (TargetsIt != TargetsByFile.end()) {
+      FileTargets = &TargetsIt->second;
     }
+    CacheIt = FileTargetsCache.insert({File, FileTargets}).first;
   }
 
-  auto AbsolutePath = SmallString<128>(File);
-  sys::fs::make_absolute(Directory, AbsolutePath);
-  StringRef FinalPath;
-  if (SkipRealPath) {
-    FinalPath = AbsolutePath;
-  } else {
-    auto RealPath = SmallString<128>();
-    sys::fs::real_path(AbsolutePath, RealPath);
-    FinalPath = RealPath;
+  const auto *FileTargets = CacheIt->second;
+  if (!FileTargets) {
+    return None;
   }
 
-  return !FinalPath.compare(this->File) && Line == this->Line;
+  auto LineIt = FileTargets->find(EffectiveLoc->getLine());
+  if (LineIt == FileTargets->end()) {
+    return None;
+  }
+
+  return LineIt->second;
 }
 
 void AFLGoTargetInjectionPass::parseTargets(
@@ -70,6 +84,12 @@ void AFLGoTargetInjectionPass::parseTargets(
     auto File = LineSplit.first;
     auto LineNumStr = LineSplit.second;
     auto LineNum = std::stoul(LineNumStr.str());
+
+    auto &FileTargets = TargetsByFile[File];
+    if (!FileTargets.insert({LineNum, Targets.size()}).second) {
+      // Duplicate target line
+      continue;
+    }
     Targets.push_back(Target(File.str(), LineNum));
   }
 }
@@ -94,7 +114,8 @@ PreservedAnalyses AFLGoTargetInjectionPass::run(Module &M,
   auto AFLGoTraceBBTarget = M.getOrInsertFunction(
       AFLGoTargetDetectionAnalysis::TargetFunctionName, VoidTy, Int32Ty);
 
-  SmallSetVector<Target *, 16> Seen;
+  FileTargetsCacheTy FileTargetsCache;
+  BitVector Seen(Targets.size());
 
   for (auto &F : M) {
     if (F.isDeclaration()) {
@@ -117,14 +138,11 @@ PreservedAnalyses AFLGoTargetInjectionPass::run(Module &M,
           continue;
         }
 
-        for (auto &Target : Targets) {
-          if (Target.matches(*Loc)) {
-            Seen.insert(&Target);
-            BBIsTarget = true;
-            I.addAnnotationMetadata(
-                AFLGoTargetDetectionAnalysis::TargetInstructionAnnotation);
-            break;
-          }
+        if (auto TargetIdx = findTarget(*Loc, FileTargetsCache)) {
+          Seen.set(*TargetIdx);
+          BBIsTarget = true;
+          I.addAnnotationMetadata(
+              AFLGoTargetDetectionAnalysis::TargetInstructionAnnotation);
         }
       }
 
@@ -136,12 +154,12 @@ PreservedAnalyses AFLGoTargetInjectionPass::run(Module &M,
     }
   }
 
-  for (auto &Target : Targets) {
-    if (!Seen.count(&Target)) {
-      errs() << "Target not found: " << Target << '\n';
+  for (unsigned int TargetIdx = 0; TargetIdx < Targets.size(); ++TargetIdx) {
+    if (!Seen.test(TargetIdx)) {
+      errs() << "Target not found: " << Targets[TargetIdx] << '\n';
     }
   }
-  if (!NoTargetsNoError && Targets.size() != Seen.size()) {
+  if (!NoTargetsNoError && !Seen.all()) {
     report_fatal_error("Not all targets were found.");
   }
 
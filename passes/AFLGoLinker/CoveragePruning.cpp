@@ -0,0 +1,80 @@
+#include <AFLGoLinker/CoveragePruning.hpp>
+#include <Analysis/BasicBlockDistance.hpp>
+#include <Analysis/CompactCallGraph.hpp>
+#include <Analysis/DistanceCache.hpp>
+#include <Analysis/DistanceFile.hpp>
+#include <Analysis/FunctionDistance.hpp>
+#include <Analysis/TargetDetection.hpp>
+
+#include <llvm/Analysis/CFG.h>
+#include <llvm/IR/Attributes.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+// Number of edges of F that SanitizerCoverage instruments before pruning the
+// ones implied by others: it splits critical edges and puts a guard in each
+// block, except in those that only reach an unreachable.
+static unsigned int countCoverageEdges(Function &F) {
+  unsigned int NumEdges = 0;
+  for (auto &BB : F) {
+    if (&BB != &F.getEntryBlock() &&
+        isa<UnreachableInst>(BB.getFirstNonPHIOrDbgOrLifetime())) {
+      continue;
+    }
+    ++NumEdges;
+
+    // Edges out of indirectbr and into EH pads cannot be split.
+    auto *TI = BB.getTerminator();
+    if (isa<IndirectBrInst>(TI)) {
+      continue;
+    }
+    for (unsigned int Succ = 0; Succ < TI->getNumSuccessors(); ++Succ) {
+      if (isCriticalEdge(TI, Succ) && !TI->getSuccessor(Succ)->isEHPad()) {
+        ++NumEdges;
+      }
+    }
+  }
+  return NumEdges;
+}
+
+PreservedAnalyses AFLGoCoveragePruningPass::run(Module &M,
+                                                ModuleAnalysisManager &AM) {
+  auto &FunctionDistances = AM.getResult<AFLGoFunctionDistanceAnalysis>(M);
+
+  unsigned int NumFunctions = 0;
+  unsigned int NumPrunedFunctions = 0;
+  unsigned int NumPrunedEdges = 0;
+  for (auto &F : M) {
+    if (F.isDeclaration()) {
+      continue;
+    }
+
+    ++NumFunctions;
+    if (FunctionDistances.count(&F) ||
+        F.hasFnAttribute(Attribute::NoSanitizeCoverage)) {
+      continue;
+    }
+
+    F.addFnAttr(Attribute::NoSanitizeCoverage);
+    ++NumPrunedFunctions;
+    NumPrunedEdges += countCoverageEdges(F);
+  }
+
+  errs() << formatv("[AFLGo] coverage pruned from {0} of {1} functions, {2} "
+                    "edges\n",
+                    NumPrunedFunctions, NumFunctions, NumPrunedEdges);
+
+  // Only an attribute changed, which none of the analyses look at.
+  PreservedAnalyses PA;
+  PA.preserve<AFLGoTargetDetectionAnalysis>();
+  PA.preserve<AFLGoFunctionDistanceAnalysis>();
+  PA.preserve<AFLGoBasicBlockDistanceAnalysis>();
+  PA.preserve<CompactCallGraphAnalysis>();
+  PA.preserve<DistanceCacheAnalysis>();
+  PA.preserve<DistanceFileAnalysis>();
+  return PA;
+}
@@ -1,6 +1,10 @@
 
 #include <AFLGoLinker/DAFL.hpp>
+#include <AFLGoLinker/GuardWeights.hpp>
+#include <AFLGoLinker/InlineProbes.hpp>
 #include <Analysis/DAFL.hpp>
+#include <Analysis/DIFilePathCache.hpp>
+#include <Analysis/LocationScores.hpp>
 #include <Analysis/TargetDetection.hpp>
 
 #include <llvm/IR/Attributes.h>
@@ -27,6 +31,9 @@ PreservedAnalyses DAFLInstrumentationPass::run(Module &M,
   }
 
   std::unique_ptr<raw_fd_ostream> Out = nullptr;
+  // Results written to stderr are meant to be read, so never write them in
+  // the binary format.
+  auto IsText = TextOutput || OutputFile == "-";
 
   if (OutputFile == "-") {
     Out = std::make_unique<raw_fd_ostream>(sys::fs::getStderrHandle(), false);
@@ -34,7 +41,8 @@ PreservedAnalyses DAFLInstrumentationPass::run(Module &M,
   } else if (!OutputFile.empty()) {
     int FD;
     auto EC = sys::fs::openFileForWrite(
-        OutputFile, FD, sys::fs::CD_CreateAlways, sys::fs::OF_Text);
+        OutputFile, FD, sys::fs::CD_CreateAlways,
+        IsText ? sys::fs::OF_Text : sys::fs::OF_None);
 
     errs() << "[DAFL] output file: " << OutputFile << "\n";
 
@@ -52,7 +60,17 @@ PreservedAnalyses DAFLInstrumentationPass::run(Module &M,
   auto &C = M.getContext();
   auto *VoidTy = Type::getVoidTy(C);
   auto *Int64Ty = Type::getInt64Ty(C);
-  auto Fn = M.getOrInsertFunction(AFLGoTraceBBDAFL, VoidTy, Int64Ty);
+  FunctionCallee Fn;
+  Optional<InlineStatsProbe> Probe;
+  if (Probes == ProbeKind::Inline) {
+    // Relevance sum
+    Probe.emplace(M, InlineStatsProbe::DAFLStatsName, 1);
+  } else if (Probes == ProbeKind::Call) {
+    Fn = M.getOrInsertFunction(AFLGoTraceBBDAFL, VoidTy, Int64Ty);
+  }
+
+  DIFilePathCache Paths(/*RealPath=*/true);
+  LocationScoresWriter Writer(1);
 
   for (auto &F : M) {
     auto IsFnReachable = false;
@@ -64,9 +82,15 @@ PreservedAnalyses DAFLInstrumentationPass::run(Module &M,
 
       IsFnReachable = true;
 
-      auto *ScoreValue = ConstantInt::get(Int64Ty, Score->second);
       IRBuilder<> IRB(&*BB.getFirstInsertionPt());
-      IRB.CreateCall(Fn, {ScoreValue});
+      if (Probes == ProbeKind::GuardTable) {
+        setGuardWeight(BB, Score->second);
+      } else if (Probe) {
+        Probe->emit(IRB, {Score->second});
+      } else {
+        auto *ScoreValue = ConstantInt::get(Int64Ty, Score->second);
+        IRB.CreateCall(Fn, {ScoreValue});
+      }
 
       if (Out) {
         DILocation *Loc = nullptr;
@@ -84,13 +108,13 @@ PreservedAnalyses DAFLInstrumentationPass::run(Module &M,
           continue;
         }
 
-        auto AbsolutePath = SmallString<128>(Loc->getFilename());
-        sys::fs::make_absolute(Loc->getDirectory(), AbsolutePath);
-        auto RealPath = SmallString<128>();
-        sys::fs::real_path(AbsolutePath, RealPath);
-
-        *Out << formatv("{0},{1},{2}:{3}\n", Score->second, F.getName(),
-                        RealPath, Loc->getLine());
+        auto Path = Paths.getPath(*Loc->getFile());
+        if (IsText) {
+          *Out << formatv("{0},{1},{2}:{3}\n", Score->second, F.getName(),
+                          Path, Loc->getLine());
+        } else {
+          Writer.add(0, Path, Loc->getLine(), Score->second);
+        }
       }
     }
 
@@ -99,6 +123,10 @@ PreservedAnalyses DAFLInstrumentationPass::run(Module &M,
     }
   }
 
+  if (Out && !IsText) {
+    Writer.write(*Out, DAFLAnalysis::BinaryMagic);
+  }
+
   PreservedAnalyses PA;
   PA.preserve<DAFLAnalysis>();
   PA.preserve<AFLGoTargetDetectionAnalysis>();
@@ -1,42 +1,258 @@
 #include <AFLGoLinker/DistanceInstrumentation.hpp>
+#include <AFLGoLinker/GuardWeights.hpp>
+#include <AFLGoLinker/InlineProbes.hpp>
 #include <Analysis/BasicBlockDistance.hpp>
+#include <Analysis/DistanceFile.hpp>
+#include <Analysis/FunctionDistance.hpp>
 
+#include <llvm/ADT/MapVector.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/PostOrderIterator.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Analysis/CFG.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/PostDominators.h>
+#include <llvm/IR/Dominators.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <vector>
 
 using namespace llvm;
 
 // XXX: this should be kept in sync with libaflgo_targets/src/distance.rs
 const auto DistanceResolution = 1e3;
 const char *AFLGoTraceBBDistanceName = "__aflgo_trace_bb_distance";
+const char *AFLGoTraceBBDistancesName = "__aflgo_trace_bb_distances";
+
+// Whether BB runs exactly once in every iteration of its innermost loop L,
+// i.e., whether every iteration goes through it before reaching a latch or
+// leaving the loop.
+static bool runsOncePerIteration(BasicBlock &BB, const Loop &L,
+                                 const DominatorTree &DT) {
+  SmallVector<BasicBlock *, 4> Ends;
+  L.getLoopLatches(Ends);
+  L.getExitingBlocks(Ends);
+  return all_of(Ends, [&](BasicBlock *End) { return DT.dominates(&BB, End); });
+}
+
+// Groups the blocks with a distance that run the same number of times, so that
+// a single probe can account for all of them:
+//   - blocks outside loops that are control equivalent, i.e., one dominates
+//     the other and is post-dominated by it;
+//   - blocks that run once in every iteration of the same innermost loop.
+// The members of a group form a chain in the dominator tree and the first one
+// dominates the others. Executions that stop in the middle of a group, e.g.,
+// because of a crash, account for all its blocks. Irreducible cycles are not
+// loops for LoopInfo, so F must not have any.
+static SmallVector<SmallVector<BasicBlock *, 4>, 0>
+groupEquivalentBlocks(Function &F,
+                      const DenseMap<BasicBlock *, uint64_t> &Distances,
+                      const DominatorTree &DT, const PostDominatorTree &PDT,
+                      const LoopInfo &LI) {
+  MapVector<BasicBlock *, SmallVector<BasicBlock *, 4>> Groups;
+  for (auto &BB : F) {
+    if (Distances.find(&BB) == Distances.end()) {
+      continue;
+    }
+
+    // Topmost block of the group, or header of the loop
+    auto *Key = &BB;
+    auto *L = LI.getLoopFor(&BB);
+    if (L && runsOncePerIteration(BB, *L, DT)) {
+      Key = L->getHeader();
+    } else if (!L && DT.isReachableFromEntry(&BB)) {
+      for (auto *Node = DT.getNode(&BB)->getIDom();
+           Node && PDT.dominates(&BB, Node->getBlock());
+           Node = Node->getIDom()) {
+        if (!LI.getLoopFor(Node->getBlock())) {
+          Key = Node->getBlock();
+        }
+      }
+    }
+
+    Groups[Key].push_back(&BB);
+  }
+
+  SmallVector<SmallVector<BasicBlock *, 4>, 0> Res;
+  for (auto &Entry : Groups) {
+    auto &Members = Entry.second;
+    auto *Leader = std::min_element(Members.begin(), Members.end(),
+                                    [&](BasicBlock *A, BasicBlock *B) {
+                                      return DT.properlyDominates(A, B);
+                                    });
+    std::iter_swap(Members.begin(), Leader);
+    Res.push_back(std::move(Members));
+  }
+
+  return Res;
+}
 
 PreservedAnalyses
 AFLGoDistanceInstrumentationPass::run(Module &M, ModuleAnalysisManager &AM) {
   auto &C = M.getContext();
   auto *VoidTy = Type::getVoidTy(C);
   auto *Int64Ty = Type::getInt64Ty(C);
-  auto AFLGoTraceBBDistance =
-      M.getOrInsertFunction(AFLGoTraceBBDistanceName, VoidTy, Int64Ty);
+  FunctionCallee AFLGoTraceBBDistance;
+  FunctionCallee AFLGoTraceBBDistances;
+  Optional<InlineStatsProbe> Probe;
+  if (Probes == ProbeKind::Inline) {
+    // Distance sum and count
+    Probe.emplace(M, InlineStatsProbe::DistanceStatsName, 2);
+  } else if (Probes == ProbeKind::Call) {
+    AFLGoTraceBBDistance =
+        M.getOrInsertFunction(AFLGoTraceBBDistanceName, VoidTy, Int64Ty);
+    if (SparseProbes) {
+      AFLGoTraceBBDistances = M.getOrInsertFunction(
+          AFLGoTraceBBDistancesName, VoidTy, Int64Ty, Int64Ty);
+    }
+  }
 
   auto &BBDistanceResult = AM.getResult<AFLGoBasicBlockDistanceAnalysis>(M);
+  using BBToDistanceTy = BBDistanceEngine::BBToDistanceTy;
 
-  for (auto &F : M) {
-    if (F.isDeclaration()) {
-      continue;
+  Optional<DistanceFileWriter> Writer;
+  if (!OutputFile.empty()) {
+    Writer.emplace();
+  }
+
+  FunctionAnalysisManager &FAM =
+      AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  unsigned int NumProbes = 0;
+  unsigned int NumProbedBBs = 0;
+
+  auto EmitProbe = [&](BasicBlock &BB, uint64_t DistanceSum,
+                       uint64_t DistanceCount) {
+    IRBuilder<> IRB(&*BB.getFirstInsertionPt());
+    if (Probe) {
+      Probe->emit(IRB, {DistanceSum, DistanceCount});
+    } else if (DistanceCount == 1) {
+      IRB.CreateCall(AFLGoTraceBBDistance, {IRB.getInt64(DistanceSum)});
+    } else {
+      IRB.CreateCall(AFLGoTraceBBDistances,
+                     {IRB.getInt64(DistanceSum), IRB.getInt64(DistanceCount)});
     }
 
-    auto BBDistances = BBDistanceResult.computeBBDistances(F);
+    ++NumProbes;
+    NumProbedBBs += DistanceCount;
+  };
+
+  auto Instrument = [&](Function &F, BBToDistanceTy &BBDistances) {
+    DenseMap<BasicBlock *, uint64_t> Distances;
     for (auto &BB : F) {
       if (BBDistances.find(&BB) == BBDistances.end()) {
         continue;
       }
 
+      // Before instrumenting, so that the key is the same as when reading.
+      if (Writer) {
+        Writer->addBasicBlock(BB, BBDistances[&BB]);
+      }
+
       auto Distance =
           static_cast<uint64_t>(BBDistances[&BB] * DistanceResolution);
-      auto *DistanceValue = ConstantInt::get(Int64Ty, Distance);
-      IRBuilder<> IRB(&*BB.getFirstInsertionPt());
-      IRB.CreateCall(AFLGoTraceBBDistance, {DistanceValue});
+      if (Probes == ProbeKind::GuardTable) {
+        setGuardWeight(BB, Distance);
+      } else if (!SparseProbes) {
+        EmitProbe(BB, Distance, 1);
+      } else {
+        Distances[&BB] = Distance;
+      }
+    }
+
+    if (Distances.empty()) {
+      return;
+    }
+
+    // Blocks in irreducible cycles may run more often than the blocks they
+    // would be grouped with, so they get a probe each.
+    auto &LI = FAM.getResult<LoopAnalysis>(F);
+    ReversePostOrderTraversal<Function *> RPOT(&F);
+    if (containsIrreducibleCFG<const BasicBlock *>(RPOT, LI)) {
+      for (auto &BB : F) {
+        auto DistanceIt = Distances.find(&BB);
+        if (DistanceIt != Distances.end()) {
+          EmitProbe(BB, DistanceIt->second, 1);
+        }
+      }
+      return;
+    }
+
+    auto Groups = groupEquivalentBlocks(
+        F, Distances, FAM.getResult<DominatorTreeAnalysis>(F),
+        FAM.getResult<PostDominatorTreeAnalysis>(F), LI);
+    for (auto &Members : Groups) {
+      uint64_t DistanceSum = 0;
+      for (auto *Member : Members) {
+        DistanceSum += Distances[Member];
+      }
+      EmitProbe(*Members.front(), DistanceSum, Members.size());
+    }
+  };
+
+  SmallVector<Function *, 0> Functions;
+  for (auto &F : M) {
+    if (!F.isDeclaration()) {
+      Functions.push_back(&F);
+    }
+  }
+
+  if (Threads == 1) {
+    for (auto *F : Functions) {
+      auto BBDistances = BBDistanceResult.computeBBDistances(*F);
+      Instrument(*F, BBDistances);
     }
+  } else {
+    // Distances of different functions are independent and only read the IR,
+    // so they are all computed concurrently before instrumenting anything.
+    std::vector<BBToDistanceTy> FunctionBBDistances(Functions.size());
+
+    ThreadPool Pool(hardware_concurrency(Threads));
+    auto NumWorkers = Pool.getThreadCount();
+    for (unsigned int Worker = 0; Worker < NumWorkers; ++Worker) {
+      Pool.async([&, Worker] {
+        BBDistanceEngine Engine;
+        for (auto Idx = Worker; Idx < Functions.size(); Idx += NumWorkers) {
+          FunctionBBDistances[Idx] =
+              BBDistanceResult.computeBBDistances(*Functions[Idx], Engine);
+        }
+      });
+    }
+    Pool.wait();
+
+    for (unsigned int Idx = 0; Idx < Functions.size(); ++Idx) {
+      Instrument(*Functions[Idx], FunctionBBDistances[Idx]);
+    }
+  }
+
+  if (SparseProbes && Probes != ProbeKind::GuardTable) {
+    errs() << formatv("[AFLGo] sparse distance probes: {0} probes for {1} "
+                      "basic blocks\n",
+                      NumProbes, NumProbedBBs);
+  }
+
+  if (Writer) {
+    for (auto &Entry : AM.getResult<AFLGoFunctionDistanceAnalysis>(M)) {
+      Writer->addFunction(*Entry.first, Entry.second);
+    }
+
+    std::error_code EC;
+    raw_fd_ostream Out(OutputFile, EC);
+    if (EC) {
+      std::string ErrorMessage =
+          formatv("can't open distance output file '{0}': {1}", OutputFile,
+                  EC.message());
+      report_fatal_error(Twine(ErrorMessage));
+    }
+
+    errs() << "[AFLGo] distance output file: " << OutputFile << '\n';
+    Writer->write(Out);
   }
 
   return PreservedAnalyses::none();
-}
\ No newline at end of file
+}
@@ -1,34 +1,74 @@
 #include <AFLGoLinker/FunctionDistanceInstrumentation.hpp>
+#include <AFLGoLinker/InlineProbes.hpp>
+#include <Analysis/CompactCallGraph.hpp>
+#include <Analysis/DistanceCache.hpp>
 #include <Analysis/FunctionDistance.hpp>
 #include <Analysis/TargetDetection.hpp>
 
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/PassManager.h>
 
+#include <cmath>
+#include <limits>
+
 using namespace llvm;
 
-const char *AFLGoTraceFunDistanceName = "__aflgo_trace_fun_distance";
+const char *AFLGoTraceFunSimilarityName = "__aflgo_trace_fun_similarity";
+
+// XXX: this should be kept in sync with libaflgo_targets/src/similarity.rs
+const auto SimilarityResolution = 1e3;
+
+// Increment of the similarity sum for a function distance, computed as the
+// runtime does, including the saturation of Rust float to integer casts.
+static uint64_t getSimilarityIncrement(double FunDistance) {
+  auto Increment = std::trunc(1.0 / FunDistance * SimilarityResolution);
+  if (std::isnan(Increment) || Increment <= 0) {
+    return 0;
+  }
+  if (Increment >= 0x1p64) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return static_cast<uint64_t>(Increment);
+}
 
 PreservedAnalyses FunctionDistancePass::run(Module &M,
                                             ModuleAnalysisManager &MAM) {
   auto &C = M.getContext();
   auto *VoidTy = Type::getVoidTy(C);
-  auto *DoubleTy = Type::getDoubleTy(C);
-  auto AFLGoTraceFunDistance =
-      M.getOrInsertFunction(AFLGoTraceFunDistanceName, VoidTy, DoubleTy);
+  auto *Int64Ty = Type::getInt64Ty(C);
+  FunctionCallee AFLGoTraceFunSimilarity;
+  Optional<InlineStatsProbe> Probe;
+  if (InlineProbes) {
+    // Similarity increment sum and count
+    Probe.emplace(M, InlineStatsProbe::SimilarityStatsName, 2);
+  } else {
+    AFLGoTraceFunSimilarity =
+        M.getOrInsertFunction(AFLGoTraceFunSimilarityName, VoidTy, Int64Ty);
+  }
 
   auto FunctionDistances = MAM.getResult<AFLGoFunctionDistanceAnalysis>(M);
   for (auto &Entry : FunctionDistances) {
     auto *Function = Entry.first;
     auto FunDistance = Entry.second;
 
-    auto *FunDistanceValue = ConstantFP::get(DoubleTy, FunDistance);
+    // The increment only depends on the distance, so the runtime just sums it.
+    auto Increment = getSimilarityIncrement(FunDistance);
     IRBuilder<> IRB(&*Function->getEntryBlock().getFirstInsertionPt());
-    IRB.CreateCall(AFLGoTraceFunDistance, {FunDistanceValue});
+    if (Probe) {
+      Probe->emit(IRB, {Increment, 1});
+      continue;
+    }
+
+    IRB.CreateCall(AFLGoTraceFunSimilarity, {IRB.getInt64(Increment)});
   }
 
   PreservedAnalyses PA;
   PA.preserve<AFLGoTargetDetectionAnalysis>();
   PA.preserve<AFLGoFunctionDistanceAnalysis>();
-  return PreservedAnalyses::none();
+  // Only used for distances, which do not change with the added calls. This
+  // way neither the extended call graph nor the pointer analysis needs to run
+  // again, e.g., for basic block distances.
+  PA.preserve<CompactCallGraphAnalysis>();
+  PA.preserve<DistanceCacheAnalysis>();
+  return PA;
 }
\ No newline at end of file
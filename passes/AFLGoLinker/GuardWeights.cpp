@@ -0,0 +1,190 @@
+#include <AFLGoLinker/GuardWeights.hpp>
+#include <AFLGoLinker/TargetInjectionFixup.hpp>
+
+#include <llvm/ADT/MapVector.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+
+using namespace llvm;
+
+static const char *const GuardWeightMDName = "aflgo.guard.weight";
+static const char *const SanCovTracePCGuardName =
+    "__sanitizer_cov_trace_pc_guard";
+
+void llvm::setGuardWeight(BasicBlock &BB, uint64_t Weight) {
+  auto &C = BB.getContext();
+  auto *WeightMD =
+      ConstantAsMetadata::get(ConstantInt::get(Type::getInt64Ty(C), Weight));
+  // The terminator stays in BB when SanitizerCoverage splits its edges.
+  BB.getTerminator()->setMetadata(GuardWeightMDName, MDNode::get(C, WeightMD));
+}
+
+static Optional<uint64_t> takeGuardWeight(BasicBlock &BB) {
+  auto *Term = BB.getTerminator();
+  if (!Term) {
+    return None;
+  }
+
+  auto *WeightMD = Term->getMetadata(GuardWeightMDName);
+  if (!WeightMD) {
+    return None;
+  }
+
+  Term->setMetadata(GuardWeightMDName, nullptr);
+  return mdconst::extract<ConstantInt>(WeightMD->getOperand(0))
+      ->getZExtValue();
+}
+
+// SanitizerCoverage passes guard Idx of a function as
+// inttoptr(ptrtoint(@Guards) + 4 * Idx), which is folded to @Guards when Idx is
+// 0.
+static GlobalVariable *getGuards(Value *Guard, const DataLayout &DL,
+                                 uint64_t &Idx) {
+  uint64_t Offset = 0;
+  auto *Base = Guard->stripPointerCasts();
+  auto *IntToPtr = dyn_cast<ConstantExpr>(Base);
+  if (IntToPtr && IntToPtr->getOpcode() == Instruction::IntToPtr) {
+    Base = IntToPtr->getOperand(0);
+
+    auto *Add = dyn_cast<ConstantExpr>(Base);
+    if (Add && Add->getOpcode() == Instruction::Add) {
+      auto *AddOffset = dyn_cast<ConstantInt>(Add->getOperand(1));
+      if (!AddOffset) {
+        return nullptr;
+      }
+      Offset = AddOffset->getZExtValue();
+      Base = Add->getOperand(0);
+    }
+
+    auto *PtrToInt = dyn_cast<ConstantExpr>(Base);
+    if (!PtrToInt || PtrToInt->getOpcode() != Instruction::PtrToInt) {
+      return nullptr;
+    }
+    Base = PtrToInt->getOperand(0);
+  }
+
+  APInt GEPOffset(DL.getIndexTypeSizeInBits(Base->getType()), 0);
+  Base = Base->stripAndAccumulateConstantOffsets(DL, GEPOffset,
+                                                 /*AllowNonInbounds=*/true);
+  auto *Guards = dyn_cast<GlobalVariable>(Base);
+  if (!Guards) {
+    return nullptr;
+  }
+
+  auto *GuardsTy = dyn_cast<ArrayType>(Guards->getValueType());
+  if (!GuardsTy) {
+    return nullptr;
+  }
+
+  Offset += GEPOffset.getZExtValue();
+  Idx = Offset / DL.getTypeAllocSize(GuardsTy->getElementType());
+  if (Idx >= GuardsTy->getNumElements()) {
+    return nullptr;
+  }
+
+  return Guards;
+}
+
+PreservedAnalyses AFLGoGuardWeightsPass::run(Module &M,
+                                             ModuleAnalysisManager &) {
+  auto &C = M.getContext();
+  auto &DL = M.getDataLayout();
+  auto *TracePCGuard = M.getFunction(SanCovTracePCGuardName);
+
+  // Weights of the guards of each function with at least one weight
+  MapVector<GlobalVariable *, SmallVector<uint64_t, 0>> FunctionWeights;
+  unsigned int Unguarded = 0;
+  for (auto &F : M) {
+    for (auto &BB : F) {
+      auto Weight = takeGuardWeight(BB);
+      if (!Weight) {
+        continue;
+      }
+
+      GlobalVariable *Guards = nullptr;
+      uint64_t Idx = 0;
+      for (auto &I : BB) {
+        auto *Call = dyn_cast<CallBase>(&I);
+        if (TracePCGuard && Call && Call->getCalledFunction() == TracePCGuard) {
+          Guards = getGuards(Call->getArgOperand(0), DL, Idx);
+          break;
+        }
+      }
+
+      if (!Guards) {
+        ++Unguarded;
+        continue;
+      }
+
+      auto &Weights = FunctionWeights[Guards];
+      if (Weights.empty()) {
+        auto *GuardsTy = cast<ArrayType>(Guards->getValueType());
+        Weights.assign(GuardsTy->getNumElements(), NoWeight);
+      }
+      Weights[Idx] = *Weight;
+    }
+  }
+
+  if (Unguarded > 0) {
+    errs() << formatv("[AFLGo] {0} weighted basic blocks without a guard\n",
+                      Unguarded);
+  }
+
+  if (FunctionWeights.empty()) {
+    return PreservedAnalyses::all();
+  }
+
+  auto *VoidTy = Type::getVoidTy(C);
+  auto *Int64Ty = Type::getInt64Ty(C);
+  auto *Int32PtrTy = Type::getInt32PtrTy(C);
+  auto *Int64PtrTy = Type::getInt64PtrTy(C);
+
+  // Guards of a function and their number, the weights of all the guards
+  // follow the order of the tables.
+  auto *TableTy = StructType::get(Int32PtrTy, Int64Ty);
+  SmallVector<Constant *, 0> Tables;
+  SmallVector<uint64_t, 0> Weights;
+  for (auto &Entry : FunctionWeights) {
+    Tables.push_back(ConstantStruct::get(
+        TableTy, {ConstantExpr::getPointerCast(Entry.first, Int32PtrTy),
+                  ConstantInt::get(Int64Ty, Entry.second.size())}));
+    Weights.append(Entry.second.begin(), Entry.second.end());
+  }
+
+  auto *TablesTy = ArrayType::get(TableTy, Tables.size());
+  auto *TablesGV = new GlobalVariable(
+      M, TablesTy, /*isConstant=*/true, GlobalValue::PrivateLinkage,
+      ConstantArray::get(TablesTy, Tables), "__aflgo_guard_tables");
+  auto *WeightsInit = ConstantDataArray::get(C, Weights);
+  auto *WeightsGV = new GlobalVariable(
+      M, WeightsInit->getType(), /*isConstant=*/true,
+      GlobalValue::PrivateLinkage, WeightsInit, "__aflgo_guard_weights");
+
+  auto *TablePtrTy = PointerType::getUnqual(TableTy);
+  auto Register = M.getOrInsertFunction(RegisterName, VoidTy, TablePtrTy,
+                                        Int64Ty, Int64PtrTy);
+
+  // The runtime reads the guard IDs only when fuzzing starts, so it does not
+  // matter whether this runs before the constructor of SanitizerCoverage.
+  auto *Ctor = Function::Create(FunctionType::get(VoidTy, false),
+                                GlobalValue::InternalLinkage,
+                                "aflgo.module_ctor_guard_weights", M);
+  IRBuilder<> IRB(BasicBlock::Create(C, "", Ctor));
+  IRB.CreateCall(Register,
+                 {ConstantExpr::getPointerCast(TablesGV, TablePtrTy),
+                  IRB.getInt64(Tables.size()),
+                  ConstantExpr::getPointerCast(WeightsGV, Int64PtrTy)});
+  IRB.CreateRetVoid();
+  appendToGlobalCtors(M, Ctor,
+                      AFLGoTargetInjectionFixupPass::RegisterCtorPriority);
+
+  return PreservedAnalyses::none();
+}
@@ -0,0 +1,54 @@
+#include <AFLGoLinker/InlineProbes.hpp>
+#include <AFLGoLinker/TargetInjectionFixup.hpp>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+
+using namespace llvm;
+
+// Lets the runtime know that the module updates the stats in place, so that it
+// refuses to replace them with shared ones. Once per module.
+static void registerInlineProbes(Module &M) {
+  constexpr StringRef CtorName = "aflgo.module_ctor_inline_probes";
+  if (M.getFunction(CtorName)) {
+    return;
+  }
+
+  auto &C = M.getContext();
+  auto *VoidTy = Type::getVoidTy(C);
+  auto Register = M.getOrInsertFunction(InlineStatsProbe::RegisterName, VoidTy);
+
+  auto *Ctor = Function::Create(FunctionType::get(VoidTy, false),
+                                GlobalValue::InternalLinkage, CtorName, M);
+  IRBuilder<> IRB(BasicBlock::Create(C, "", Ctor));
+  IRB.CreateCall(Register);
+  IRB.CreateRetVoid();
+  appendToGlobalCtors(M, Ctor,
+                      AFLGoTargetInjectionFixupPass::RegisterCtorPriority);
+}
+
+InlineStatsProbe::InlineStatsProbe(Module &M, StringRef StatsName,
+                                   unsigned int NumCounters) {
+  auto *Int64Ty = Type::getInt64Ty(M.getContext());
+  auto *StatsTy = ArrayType::get(Int64Ty, NumCounters);
+  Stats = cast<GlobalVariable>(M.getOrInsertGlobal(StatsName, StatsTy));
+  Stats->setAlignment(Align(8));
+
+  registerInlineProbes(M);
+}
+
+void InlineStatsProbe::emit(IRBuilder<> &IRB,
+                            ArrayRef<uint64_t> Increments) const {
+  auto *Int64Ty = IRB.getInt64Ty();
+  for (unsigned int Idx = 0; Idx < Increments.size(); ++Idx) {
+    auto *Counter =
+        IRB.CreateConstInBoundsGEP2_64(Stats->getValueType(), Stats, 0, Idx);
+
+    auto *Load = IRB.CreateAlignedLoad(Int64Ty, Counter, Align(8));
+    Load->setAtomic(AtomicOrdering::Monotonic);
+    auto *Sum = IRB.CreateAdd(Load, IRB.getInt64(Increments[Idx]));
+    auto *Store = IRB.CreateAlignedStore(Sum, Counter, Align(8));
+    Store->setAtomic(AtomicOrdering::Monotonic);
+  }
+}
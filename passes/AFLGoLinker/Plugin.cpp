@@ -1,13 +1,20 @@
+#include <AFLGoLinker/CoveragePruning.hpp>
 #include <AFLGoLinker/DAFL.hpp>
 #include <AFLGoLinker/DistanceInstrumentation.hpp>
 #include <AFLGoLinker/DuplicateTargetRemoval.hpp>
 #include <AFLGoLinker/FunctionDistanceInstrumentation.hpp>
+#include <AFLGoLinker/GuardWeights.hpp>
+#include <AFLGoLinker/InlineProbes.hpp>
 #include <AFLGoLinker/TargetInjectionFixup.hpp>
 
 #include <Analysis/BasicBlockDistance.hpp>
+#include <Analysis/CompactCallGraph.hpp>
 #include <Analysis/DAFL.hpp>
+#include <Analysis/DistanceCache.hpp>
+#include <Analysis/DistanceFile.hpp>
 #include <Analysis/ExtendedCallGraph.hpp>
 #include <Analysis/FunctionDistance.hpp>
+#include <Analysis/PointerAnalysis.hpp>
 #include <Analysis/TargetDetection.hpp>
 
 #include <llvm/IR/PassManager.h>
@@ -23,11 +30,74 @@ static cl::opt<bool> ClExtendCG(
     cl::desc("Extend call graph with indirect edges through pointer analysis"),
     cl::init(false));
 
+static cl::opt<std::string> ClSVFCacheDir(
+    "svf-cache-dir",
+    cl::desc("Directory where pointer analysis results are cached across "
+             "links of the same module"),
+    cl::value_desc("directory"));
+
+static cl::opt<IndirectCallResolver> ClExtendCGResolver(
+    "extend-cg-resolver",
+    cl::desc("Resolver of indirect calls used to extend the call graph"),
+    cl::values(clEnumValN(IndirectCallResolver::Andersen, "andersen",
+                          "Andersen pointer analysis"),
+               clEnumValN(IndirectCallResolver::Type, "type",
+                          "Function signatures and class hierarchies")),
+    cl::init(IndirectCallResolver::Andersen));
+
 static cl::opt<bool>
     ClHawkeyeDistance("use-hawkeye-distance",
                       cl::desc("Use Hawkeye function distance definition"),
                       cl::init(false));
 
+static cl::opt<unsigned int> ClDistanceThreads(
+    "distance-threads",
+    cl::desc("Number of threads used to compute distances (0 uses all "
+             "available threads)"),
+    cl::init(1));
+
+static cl::opt<std::string> ClDistanceCacheDir(
+    "distance-cache-dir",
+    cl::desc("Directory where distances are cached across links, so that only "
+             "the ones affected by a change are computed again"),
+    cl::value_desc("directory"));
+
+static cl::opt<std::string> ClDistanceInputFile(
+    "distance-input-file",
+    cl::desc("Input file with precomputed distances, which are used instead "
+             "of running the distance analyses"),
+    cl::value_desc("filename"));
+
+static cl::opt<std::string>
+    ClDistanceOutputFile("distance-output-file",
+                         cl::desc("Output file for distance analysis results"),
+                         cl::value_desc("filename"));
+
+static cl::opt<bool> ClInlineDistanceProbes(
+    "inline-distance-probes",
+    cl::desc("Update the distance, DAFL and similarity stats with inline "
+             "loads and stores instead of calls to the runtime"),
+    cl::init(false));
+
+static cl::opt<bool> ClSparseDistanceProbes(
+    "sparse-distance-probes",
+    cl::desc("Probe one basic block for each group of blocks with a distance "
+             "that run the same number of times"),
+    cl::init(false));
+
+static cl::opt<bool> ClGuardWeightTables(
+    "guard-weight-tables",
+    cl::desc("Compute the distance or DAFL relevance of test cases from the "
+             "SanitizerCoverage hit counts and per-guard weight tables "
+             "instead of probing basic blocks"),
+    cl::init(false));
+
+static cl::opt<bool> ClPruneUnreachableCoverage(
+    "prune-unreachable-coverage",
+    cl::desc("Disable coverage instrumentation in functions that cannot reach "
+             "any target"),
+    cl::init(false));
+
 static cl::opt<bool>
     ClTraceFunctionDistance("trace-function-distance",
                             cl::desc("Add function distance tracing callbacks"),
@@ -60,24 +130,55 @@ static cl::opt<std::string>
                      cl::desc("Output file for DAFL analysis results"),
                      cl::value_desc("filename"));
 
+static cl::opt<bool> ClDAFLTextOutput(
+    "dafl-text-output",
+    cl::desc("Write DAFL analysis results in the text format instead of the "
+             "binary one"),
+    cl::init(false));
+
+// Guard tables replace the basic block probes, inline or not, while function
+// probes are not affected.
+static ProbeKind getBBProbeKind() {
+  if (ClGuardWeightTables) {
+    return ProbeKind::GuardTable;
+  }
+
+  return ClInlineDistanceProbes ? ProbeKind::Inline : ProbeKind::Call;
+}
+
 static void addPasses(ModulePassManager &MPM) {
   MPM.addPass(DuplicateTargetRemovalPass());
 
   if (ClDAFL) {
-    MPM.addPass(DAFLInstrumentationPass(ClDAFLOutputFile));
+    MPM.addPass(DAFLInstrumentationPass(ClDAFLOutputFile, ClDAFLTextOutput,
+                                        getBBProbeKind()));
   } else {
     if (ClTraceFunctionDistance) {
-      MPM.addPass(FunctionDistancePass());
+      MPM.addPass(FunctionDistancePass(ClInlineDistanceProbes));
+    }
+    // DAFL builds already prune functions without a score.
+    if (ClPruneUnreachableCoverage) {
+      MPM.addPass(AFLGoCoveragePruningPass());
     }
-    MPM.addPass(AFLGoDistanceInstrumentationPass());
+    MPM.addPass(AFLGoDistanceInstrumentationPass(
+        ClDistanceThreads, ClDistanceOutputFile, getBBProbeKind(),
+        ClSparseDistanceProbes));
   }
 
   SanitizerCoverageOptions Options;
   Options.CoverageType = SanitizerCoverageOptions::SCK_Edge;
   Options.TracePCGuard = true;
   Options.TraceCmp = true;
+  // Each weighted block needs its own guard.
+  Options.NoPrune = ClGuardWeightTables;
   MPM.addPass(ModuleSanitizerCoveragePass(Options));
 
+  if (ClGuardWeightTables) {
+    MPM.addPass(AFLGoGuardWeightsPass(
+        ClDAFL ? AFLGoGuardWeightsPass::RegisterDAFLName
+               : AFLGoGuardWeightsPass::RegisterDistancesName));
+  }
+
   MPM.addPass(AFLGoTargetInjectionFixupPass());
 }
 
@@ -94,12 +195,22 @@ llvm::PassPluginLibraryInfo getAFLGoLinkerPluginInfo() {
             return DAFLAnalysis(ClDAFLInputFile, ClDAFLNoTargetsNoError,
                                 ClDAFLDebug, ClDAFLVerbose);
           });
-          MAM.registerPass([] { return ExtendedCallGraphAnalysis(); });
           MAM.registerPass([] {
-            return AFLGoFunctionDistanceAnalysis(ClExtendCG, ClHawkeyeDistance);
+            return SVFPointerAnalysis(ClDAFLVerbose || ClDAFLDebug,
+                                      ClSVFCacheDir);
           });
           MAM.registerPass(
-              [] { return AFLGoBasicBlockDistanceAnalysis(ClExtendCG); });
+              [] { return ExtendedCallGraphAnalysis(ClExtendCGResolver); });
+          MAM.registerPass([] { return CompactCallGraphAnalysis(ClExtendCG); });
+          MAM.registerPass(
+              [] { return DistanceCacheAnalysis(ClDistanceCacheDir); });
+          MAM.registerPass(
+              [] { return DistanceFileAnalysis(ClDistanceInputFile); });
+          MAM.registerPass([] {
+            return AFLGoFunctionDistanceAnalysis(ClHawkeyeDistance,
+                                                 ClDistanceThreads);
+          });
+          MAM.registerPass([] { return AFLGoBasicBlockDistanceAnalysis(); });
         });
 
         PB.registerFullLinkTimeOptimizationLastEPCallback(
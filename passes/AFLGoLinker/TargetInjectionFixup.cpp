@@ -1,11 +1,39 @@
 #include <AFLGoLinker/TargetInjectionFixup.hpp>
+#include <Analysis/DIFilePathCache.hpp>
 #include <Analysis/TargetDetection.hpp>
 
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/PassManager.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
 
 using namespace llvm;
 
+// Prefers the location of the target instructions, which are the ones listed
+// in the targets file, over the one of any other instruction of BB.
+static DILocation *getTargetLocation(BasicBlock &BB,
+                                     ArrayRef<Instruction *> TargetIs) {
+  for (auto *I : TargetIs) {
+    auto *Loc = I->getDebugLoc().get();
+    if (I->getParent() == &BB && Loc && Loc->getLine() > 0) {
+      return Loc;
+    }
+  }
+
+  for (auto &I : BB) {
+    auto *Loc = I.getDebugLoc().get();
+    if (Loc && Loc->getLine() > 0) {
+      return Loc;
+    }
+  }
+
+  return nullptr;
+}
+
 PreservedAnalyses
 AFLGoTargetInjectionFixupPass::run(Module &M, ModuleAnalysisManager &MAM) {
   auto &C = M.getContext();
@@ -13,6 +41,9 @@ AFLGoTargetInjectionFixupPass::run(Module &M, ModuleAnalysisManager &MAM) {
   FunctionAnalysisManager &FAM =
       MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
 
+  DIFilePathCache Paths(/*RealPath=*/false);
+  SmallVector<std::string, 16> Locations;
+
   for (auto &F : M) {
     if (F.isDeclaration()) {
       continue;
@@ -27,11 +58,61 @@ AFLGoTargetInjectionFixupPass::run(Module &M, ModuleAnalysisManager &MAM) {
 
       CB->setArgOperand(0, NewArg);
 
+      auto *Loc = getTargetLocation(*TargetPair.first, Targets.Is);
+      if (Loc && Loc->getFile()) {
+        Locations.push_back(
+            formatv("{0}:{1}", Paths.getPath(*Loc->getFile()), Loc->getLine())
+                .str());
+      } else {
+        Locations.push_back(UnknownLocation);
+      }
+
       TargetCounter++;
     }
   }
 
   PreservedAnalyses PA;
   PA.preserve<AFLGoTargetDetectionAnalysis>();
+  if (Locations.empty()) {
+    return PA;
+  }
+
+  auto *VoidTy = Type::getVoidTy(C);
+  auto *Int32Ty = Type::getInt32Ty(C);
+  auto *Int8PtrTy = Type::getInt8PtrTy(C);
+  auto *Int8PtrPtrTy = PointerType::getUnqual(Int8PtrTy);
+
+  // The runtime sizes the targets map with the number of IDs assigned above
+  // and reports the location of each target when it is first hit.
+  auto *Ctor = Function::Create(FunctionType::get(VoidTy, false),
+                                GlobalValue::InternalLinkage,
+                                "aflgo.module_ctor_targets", M);
+  IRBuilder<> IRB(BasicBlock::Create(C, "", Ctor));
+
+  SmallVector<Constant *, 16> LocationPtrs;
+  for (auto &Location : Locations) {
+    LocationPtrs.push_back(
+        IRB.CreateGlobalStringPtr(Location, "__aflgo_target_location"));
+  }
+
+  auto *LocationsTy = ArrayType::get(Int8PtrTy, LocationPtrs.size());
+  auto *LocationsGV = new GlobalVariable(
+      M, LocationsTy, /*isConstant=*/true, GlobalValue::PrivateLinkage,
+      ConstantArray::get(LocationsTy, LocationPtrs),
+      "__aflgo_target_locations");
+  auto *CountGV = new GlobalVariable(
+      M, Int32Ty, /*isConstant=*/true, GlobalValue::PrivateLinkage,
+      ConstantInt::get(Int32Ty, TargetCounter), "__aflgo_targets_count");
+
+  auto Register =
+      M.getOrInsertFunction(RegisterName, VoidTy, Int32Ty, Int8PtrPtrTy);
+  IRB.CreateCall(Register,
+                 {IRB.CreateLoad(Int32Ty, CountGV),
+                  ConstantExpr::getPointerCast(LocationsGV, Int8PtrPtrTy)});
+  IRB.CreateRetVoid();
+
+  // Targets may be hit by other constructors, so the map must be sized first.
+  appendToGlobalCtors(M, Ctor, CtorPriority);
+
   return PA;
-}
\ No newline at end of file
+}
@@ -1,13 +1,18 @@
 #include <Analysis/BasicBlockDistance.hpp>
-#include <Analysis/ExtendedCallGraph.hpp>
+#include <Analysis/CompactCallGraph.hpp>
+#include <Analysis/DistanceCache.hpp>
+#include <Analysis/DistanceFile.hpp>
 #include <Analysis/FunctionDistance.hpp>
 #include <Analysis/TargetDetection.hpp>
 
-#include <llvm/ADT/BreadthFirstIterator.h>
-#include <llvm/Analysis/CallGraph.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/CFG.h>
 #include <llvm/IR/PassManager.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+#include <algorithm>
 
 using namespace llvm;
 
@@ -15,17 +20,57 @@ const double FunctionDistanceMagnificationFactor = 10;
 
 AnalysisKey AFLGoBasicBlockDistanceAnalysis::Key;
 
+// Hash of everything the distances of a function depend on: the shape of its
+// CFG and the distances of its origin blocks. Blocks are numbered in function
+// order and returned in Blocks.
+static uint64_t
+getCacheKey(Function &F, const BBDistanceEngine::BBToDistanceTy &OriginBBs,
+            SmallVectorImpl<BasicBlock *> &Blocks) {
+  DenseMap<const BasicBlock *, uint32_t> Numbers;
+  for (auto &BB : F) {
+    Numbers[&BB] = Blocks.size();
+    Blocks.push_back(&BB);
+  }
+
+  SmallVector<char, 0> Buffer;
+  raw_svector_ostream OS(Buffer);
+  support::endian::Writer W(OS, support::little);
+
+  W.write<uint32_t>(Blocks.size());
+  for (auto *BB : Blocks) {
+    W.write<uint32_t>(succ_size(BB));
+    for (auto *Succ : successors(BB)) {
+      W.write<uint32_t>(Numbers[Succ]);
+    }
+  }
+
+  // The origins map is unordered.
+  SmallVector<std::pair<uint32_t, double>, 16> Origins;
+  for (auto &OriginBBPair : OriginBBs) {
+    Origins.push_back({Numbers[OriginBBPair.first], OriginBBPair.second});
+  }
+  llvm::sort(Origins);
+
+  W.write<uint32_t>(Origins.size());
+  for (auto &Origin : Origins) {
+    W.write<uint32_t>(Origin.first);
+    W.write<double>(Origin.second);
+  }
+
+  return xxHash64(StringRef(Buffer.data(), Buffer.size()));
+}
+
 AFLGoBasicBlockDistanceAnalysis::Result
 AFLGoBasicBlockDistanceAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  auto &Imported = MAM.getResult<DistanceFileAnalysis>(M);
+  if (Imported) {
+    return Result::imported(Imported->BasicBlocks, Imported->Functions);
+  }
+
   AFLGoBasicBlockDistanceAnalysis::Result::FunctionToOriginBBsMapTy
       FunctionToOriginBBs;
 
-  CallGraph *CG = nullptr;
-  if (!UseExtendedCG) {
-    CG = &MAM.getResult<CallGraphAnalysis>(M);
-  } else {
-    CG = &MAM.getResult<ExtendedCallGraphAnalysis>(M);
-  }
+  auto &CCG = MAM.getResult<CompactCallGraphAnalysis>(M);
 
   auto &FunctionDistances = MAM.getResult<AFLGoFunctionDistanceAnalysis>(M);
   FunctionAnalysisManager &FAM =
@@ -44,16 +89,13 @@ AFLGoBasicBlockDistanceAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
       OriginBBs[TargetBB] = 0;
     }
 
-    auto *CGNode = (*CG)[&F];
-    for (auto &CallEdge : *CGNode) {
-      auto &CallInstOpt = CallEdge.first;
-      if (!CallInstOpt) {
+    for (auto &CallEdge : CCG.callees(CCG.getId(F))) {
+      auto *CallInst = CallEdge.Call;
+      if (!CallInst) {
         continue;
       }
-      CallBase *CallInst = cast<CallBase>(*CallInstOpt);
 
-      auto *CalleeNode = CallEdge.second;
-      auto *CalledFunction = CalleeNode->getFunction();
+      auto *CalledFunction = CCG.getFunction(CallEdge.Node);
       if (FunctionDistances.find(CalledFunction) == FunctionDistances.end()) {
         continue;
       }
@@ -73,45 +115,140 @@ AFLGoBasicBlockDistanceAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
     FunctionToOriginBBs[&F] = OriginBBs;
   }
 
-  return Result{FunctionToOriginBBs, FunctionDistances};
+  auto &Cache = MAM.getResult<DistanceCacheAnalysis>(M);
+  return Result{std::move(FunctionToOriginBBs), FunctionDistances,
+                Cache.get()};
 }
 
-AFLGoBasicBlockDistanceAnalysis::Result::BBToDistanceTy
-AFLGoBasicBlockDistanceAnalysis::Result::computeBBDistances(Function &F) {
-  auto OriginBBs = FunctionToOriginBBs[&F];
+void BBDistanceEngine::numberBlocks(Function &F) {
+  Numbers.clear();
+  Blocks.clear();
+  for (auto &BB : F) {
+    Numbers[&BB] = Blocks.size();
+    Blocks.push_back(&BB);
+  }
+
+  PredOffsets.clear();
+  Preds.clear();
+  for (auto *BB : Blocks) {
+    PredOffsets.push_back(Preds.size());
+    for (auto *Pred : predecessors(BB)) {
+      Preds.push_back(Numbers[Pred]);
+    }
+  }
+  PredOffsets.push_back(Preds.size());
+
+  // Stamps of previous functions may be stale, start over.
+  Visited.assign(Blocks.size(), 0);
+  Epoch = 0;
+}
+
+void BBDistanceEngine::nextEpoch() {
+  if (++Epoch == 0) {
+    std::fill(Visited.begin(), Visited.end(), 0);
+    Epoch = 1;
+  }
+}
+
+BBDistanceEngine::BBToDistanceTy
+BBDistanceEngine::compute(Function &F, const BBToDistanceTy &OriginBBs) {
+  numberBlocks(F);
+
+  auto NumBlocks = Blocks.size();
+  IsOrigin.assign(NumBlocks, false);
+  ReciprocalSums.assign(NumBlocks, 0);
+  Counts.assign(NumBlocks, 0);
+
+  for (auto &OriginBBPair : OriginBBs) {
+    IsOrigin[Numbers[OriginBBPair.first]] = true;
+  }
+
+  auto DistanceMap = BBToDistanceTy();
 
-  auto DistanceMap = AFLGoBasicBlockDistanceAnalysis::Result::BBToDistanceTy();
-  std::map<BasicBlock *, std::vector<double>> DistancesFromOrigins;
+  // Origins are visited in the same order as the map, so that floating point
+  // sums do not depend on the engine.
   for (auto &OriginBBPair : OriginBBs) {
     auto *OriginBB = OriginBBPair.first;
     auto OriginBBDistance = OriginBBPair.second;
     DistanceMap[OriginBB] = OriginBBDistance;
 
-    auto InverseOriginBB = static_cast<Inverse<BasicBlock *>>(OriginBB);
-    for (auto BFIter = bf_begin(InverseOriginBB);
-         BFIter != bf_end(InverseOriginBB); ++BFIter) {
-      if (OriginBBs.find(*BFIter) != OriginBBs.end()) {
-        // This basic block is either a target or performs an external call.
-        continue;
+    // Breadth-first search over predecessors, as levels matter.
+    nextEpoch();
+    auto Origin = Numbers[OriginBB];
+    Visited[Origin] = Epoch;
+    Queue.clear();
+    Queue.push_back({Origin, 0});
+
+    for (size_t Head = 0; Head < Queue.size(); ++Head) {
+      auto Current = Queue[Head].first;
+      auto Level = Queue[Head].second;
+
+      // Basic blocks that are either a target or perform an external call keep
+      // their own distance, but the search continues through them.
+      if (!IsOrigin[Current]) {
+        ReciprocalSums[Current] += 1.0 / (OriginBBDistance + Level);
+        ++Counts[Current];
+      }
+
+      for (auto PredIdx = PredOffsets[Current],
+                PredEnd = PredOffsets[Current + 1];
+           PredIdx < PredEnd; ++PredIdx) {
+        auto Pred = Preds[PredIdx];
+        if (Visited[Pred] != Epoch) {
+          Visited[Pred] = Epoch;
+          Queue.push_back({Pred, Level + 1});
+        }
       }
+    }
+  }
 
-      DistancesFromOrigins[*BFIter].push_back(OriginBBDistance +
-                                              BFIter.getLevel());
+  for (unsigned int Block = 0; Block < NumBlocks; ++Block) {
+    if (Counts[Block] > 0) {
+      DistanceMap[Blocks[Block]] = Counts[Block] / ReciprocalSums[Block];
     }
   }
 
-  for (auto &DistancesFromOriginPair : DistancesFromOrigins) {
-    auto &Distances = DistancesFromOriginPair.second;
+  return DistanceMap;
+}
+
+AFLGoBasicBlockDistanceAnalysis::Result::BBToDistanceTy
+AFLGoBasicBlockDistanceAnalysis::Result::computeBBDistances(
+    Function &F, BBDistanceEngine &Engine) const {
+  auto OriginBBsIt = FunctionToOriginBBs.find(&F);
+  if (OriginBBsIt == FunctionToOriginBBs.end()) {
+    return BBToDistanceTy();
+  }
+
+  if (Imported) {
+    return OriginBBsIt->second;
+  }
 
-    double HarmonicMean = 0;
-    for (auto Distance : Distances) {
-      HarmonicMean += 1.0 / Distance;
+  if (!Cache) {
+    return Engine.compute(F, OriginBBsIt->second);
+  }
+
+  SmallVector<BasicBlock *, 0> Blocks;
+  auto CacheKey = getCacheKey(F, OriginBBsIt->second, Blocks);
+
+  DistanceCache::BBDistancesTy Cached;
+  if (Cache->lookupBBDistances(CacheKey, Cached)) {
+    auto DistanceMap = BBToDistanceTy();
+    for (auto &Record : Cached) {
+      DistanceMap[Blocks[Record.first]] = Record.second;
     }
-    HarmonicMean = Distances.size() / HarmonicMean;
+    return DistanceMap;
+  }
 
-    auto *BB = DistancesFromOriginPair.first;
-    DistanceMap[BB] = HarmonicMean;
+  auto DistanceMap = Engine.compute(F, OriginBBsIt->second);
+
+  DenseMap<const BasicBlock *, uint32_t> Numbers;
+  for (unsigned int Block = 0; Block < Blocks.size(); ++Block) {
+    Numbers[Blocks[Block]] = Block;
+  }
+  for (auto &DistanceEntry : DistanceMap) {
+    Cached.push_back({Numbers[DistanceEntry.first], DistanceEntry.second});
   }
+  Cache->storeBBDistances(CacheKey, std::move(Cached));
 
   return DistanceMap;
-}
\ No newline at end of file
+}
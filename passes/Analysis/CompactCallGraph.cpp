@@ -0,0 +1,179 @@
+#include <Analysis/CompactCallGraph.hpp>
+#include <Analysis/ExtendedCallGraph.hpp>
+
+#include <llvm/Analysis/CallGraph.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Module.h>
+
+#include <algorithm>
+
+using namespace llvm;
+
+AnalysisKey CompactCallGraphAnalysis::Key;
+
+CompactCallGraph::CompactCallGraph(const CallGraph &CG) {
+  for (auto &F : CG.getModule()) {
+    Ids[&F] = Functions.size();
+    Functions.push_back(&F);
+  }
+
+  for (auto *F : Functions) {
+    CalleeOffsets.push_back(Callees.size());
+
+    // Debug intrinsics are left out of the call graph.
+    if (isDbgInfoIntrinsic(F->getIntrinsicID())) {
+      continue;
+    }
+
+    for (auto &CallRecord : *CG[F]) {
+      auto *CalleeF = CallRecord.second->getFunction();
+      if (!CalleeF) {
+        // Ignore external nodes
+        continue;
+      }
+
+      CallBase *Call = nullptr;
+      if (CallRecord.first) {
+        Call = dyn_cast_or_null<CallBase>(*CallRecord.first);
+      }
+      Callees.push_back({Call, Ids[CalleeF]});
+    }
+  }
+  CalleeOffsets.push_back(Callees.size());
+
+  // Reverse edges, bucketed by callee.
+  CallerOffsets.assign(size() + 1, 0);
+  for (auto &Callee : Callees) {
+    ++CallerOffsets[Callee.Node + 1];
+  }
+  for (unsigned int Id = 0; Id < size(); ++Id) {
+    CallerOffsets[Id + 1] += CallerOffsets[Id];
+  }
+
+  Callers.resize(Callees.size());
+  SmallVector<unsigned int, 0> Next(CallerOffsets.begin(),
+                                    CallerOffsets.end() - 1);
+  for (unsigned int Id = 0; Id < size(); ++Id) {
+    for (auto &Callee : callees(Id)) {
+      Callers[Next[Callee.Node]++] = {Callee.Call, Id};
+    }
+  }
+
+  computeSCCs();
+  condenseSCCs();
+}
+
+// Iterative Tarjan's algorithm, so that deep call chains do not overflow the
+// stack.
+void CompactCallGraph::computeSCCs() {
+  constexpr unsigned int Unvisited = ~0U;
+
+  SmallVector<unsigned int, 0> Index(size(), Unvisited);
+  SmallVector<unsigned int, 0> LowLink(size());
+  SmallVector<bool, 0> OnStack(size(), false);
+  SmallVector<unsigned int, 0> Stack;
+  // Node and next forward edge to explore
+  SmallVector<std::pair<unsigned int, unsigned int>, 0> DFS;
+  unsigned int NextIndex = 0;
+
+  SCCs.assign(size(), 0);
+  SCCOffsets.assign(1, 0);
+  SCCMembers.clear();
+
+  auto Visit = [&](unsigned int Id) {
+    Index[Id] = LowLink[Id] = NextIndex++;
+    Stack.push_back(Id);
+    OnStack[Id] = true;
+    DFS.push_back({Id, CalleeOffsets[Id]});
+  };
+
+  for (unsigned int Root = 0; Root < size(); ++Root) {
+    if (Index[Root] != Unvisited) {
+      continue;
+    }
+
+    Visit(Root);
+    while (!DFS.empty()) {
+      auto Id = DFS.back().first;
+      auto &EdgeIdx = DFS.back().second;
+      if (EdgeIdx < CalleeOffsets[Id + 1]) {
+        auto Callee = Callees[EdgeIdx++].Node;
+        if (Index[Callee] == Unvisited) {
+          Visit(Callee);
+        } else if (OnStack[Callee]) {
+          LowLink[Id] = std::min(LowLink[Id], Index[Callee]);
+        }
+        continue;
+      }
+
+      DFS.pop_back();
+      if (!DFS.empty()) {
+        auto Parent = DFS.back().first;
+        LowLink[Parent] = std::min(LowLink[Parent], LowLink[Id]);
+      }
+
+      if (LowLink[Id] != Index[Id]) {
+        continue;
+      }
+
+      auto SCC = getNumSCCs();
+      unsigned int Member;
+      do {
+        Member = Stack.pop_back_val();
+        OnStack[Member] = false;
+        SCCs[Member] = SCC;
+        SCCMembers.push_back(Member);
+      } while (Member != Id);
+      SCCOffsets.push_back(SCCMembers.size());
+    }
+  }
+}
+
+void CompactCallGraph::condenseSCCs() {
+  auto NumSCCs = getNumSCCs();
+
+  // Last SCC that added each SCC as a callee, to drop duplicate edges.
+  SmallVector<unsigned int, 0> LastCaller(NumSCCs, ~0U);
+  SCCCalleeOffsets.clear();
+  SCCCallees.clear();
+  for (unsigned int SCC = 0; SCC < NumSCCs; ++SCC) {
+    SCCCalleeOffsets.push_back(SCCCallees.size());
+    for (auto Member : sccMembers(SCC)) {
+      for (auto &Callee : callees(Member)) {
+        auto CalleeSCC = SCCs[Callee.Node];
+        if (CalleeSCC != SCC && LastCaller[CalleeSCC] != SCC) {
+          LastCaller[CalleeSCC] = SCC;
+          SCCCallees.push_back(CalleeSCC);
+        }
+      }
+    }
+  }
+  SCCCalleeOffsets.push_back(SCCCallees.size());
+
+  SCCCallerOffsets.assign(NumSCCs + 1, 0);
+  for (auto CalleeSCC : SCCCallees) {
+    ++SCCCallerOffsets[CalleeSCC + 1];
+  }
+  for (unsigned int SCC = 0; SCC < NumSCCs; ++SCC) {
+    SCCCallerOffsets[SCC + 1] += SCCCallerOffsets[SCC];
+  }
+
+  SCCCallers.resize(SCCCallees.size());
+  SmallVector<unsigned int, 0> Next(SCCCallerOffsets.begin(),
+                                    SCCCallerOffsets.end() - 1);
+  for (unsigned int SCC = 0; SCC < NumSCCs; ++SCC) {
+    for (auto CalleeSCC : sccCallees(SCC)) {
+      SCCCallers[Next[CalleeSCC]++] = SCC;
+    }
+  }
+}
+
+CompactCallGraphAnalysis::Result
+CompactCallGraphAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  if (!UseExtendedCG) {
+    return CompactCallGraph(MAM.getResult<CallGraphAnalysis>(M));
+  }
+
+  return CompactCallGraph(MAM.getResult<ExtendedCallGraphAnalysis>(M));
+}
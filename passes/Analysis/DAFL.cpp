@@ -1,13 +1,16 @@
 #include <Analysis/DAFL.hpp>
+#include <Analysis/DIFilePathCache.hpp>
+#include <Analysis/LocationScores.hpp>
+#include <Analysis/PointerAnalysis.hpp>
 #include <Analysis/TargetDetection.hpp>
 
-#include "Graphs/IRGraph.h"
-#include "Graphs/VFG.h"
+#include "Graphs/SVFG.h"
 #include "Graphs/VFGEdge.h"
 #include "Graphs/VFGNode.h"
-#include "SVF-LLVM/SVFIRBuilder.h"
-#include "WPA/Andersen.h"
+#include "SVF-LLVM/LLVMModule.h"
+#include "SVFIR/SVFIR.h"
 
+#include <llvm/ADT/ArrayRef.h>
 #include <llvm/ADT/SmallSet.h>
 #include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/StringMap.h>
@@ -15,14 +18,15 @@
 #include <llvm/ADT/StringSet.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Intrinsics.h>
 #include <llvm/Support/Error.h>
 #include <llvm/Support/FormatVariadic.h>
-#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/LineIterator.h>
 
-#include <map>
-#include <set>
+#include <deque>
+#include <limits>
 #include <string>
 #include <utility>
 #include <vector>
@@ -31,34 +35,91 @@ using namespace llvm;
 
 AnalysisKey DAFLAnalysis::Key;
 
-typedef long long NodeID;
+namespace {
+
+// Graph in compressed sparse row layout: the edges of node N are
+// Edges[Offsets[N]..Offsets[N + 1]). Nodes are added in order, together with
+// all of their edges.
+class CSRGraph {
+public:
+  struct Edge {
+    uint32_t Target;
+    uint32_t Weight;
+  };
+
+private:
+  std::vector<uint32_t> Offsets{0};
+  std::vector<Edge> Edges;
+
+public:
+  // Adds an edge to the node currently being built.
+  void addEdge(uint32_t Target, uint32_t Weight) {
+    Edges.push_back({Target, Weight});
+  }
+
+  // Completes the current node; the next edges belong to the next node.
+  void finishNode() { Offsets.push_back(Edges.size()); }
 
-struct Edge {
-  const NodeID Target;
-  const DAFLAnalysis::WeightTy Weight;
+  uint32_t size() const { return Offsets.size() - 1; }
+
+  ArrayRef<Edge> edges(uint32_t N) const {
+    return makeArrayRef(Edges.data() + Offsets[N],
+                        Edges.data() + Offsets[N + 1]);
+  }
 };
 
-DAFLAnalysis::Result
-DAFLAnalysis::readFromFile(Module &M, std::unique_ptr<MemoryBuffer> &Buffer) {
-  SmallVector<StringRef, 0> AllLines;
-  Buffer->getBuffer().split(AllLines, '\n');
+// Shortest distances from Source to all nodes. Edge weights must be either 0
+// or 1, so a double-ended queue replaces the priority queue of Dijkstra.
+std::vector<DAFLAnalysis::WeightTy> computeDistances(const CSRGraph &G,
+                                                      uint32_t Source) {
+  std::vector<DAFLAnalysis::WeightTy> Dist(
+      G.size(), std::numeric_limits<DAFLAnalysis::WeightTy>::max());
+  std::deque<uint32_t> Q;
 
-  // The input file may contain multiple scores for the same file:line. This can
-  // happen for example with ternary operators written in a single line. It
-  // could also happen when linking multiple programs in parallel against the
-  // same target library (i.e. specified target locations are in the library);
-  // in this case make sure to use a unique DAFL file for each linker
-  // invocation.
+  Dist[Source] = 0;
+  Q.push_back(Source);
 
-  // A single line can have multiple function names for cloned functions.
+  while (!Q.empty()) {
+    auto U = Q.front();
+    Q.pop_front();
 
-  // Map from file:line to function names and scores.
-  StringMap<std::pair<StringSet<>, SmallVector<WeightTy>>> LineToScores;
+    for (const auto &E : G.edges(U)) {
+      auto D = Dist[U] + E.Weight;
+      if (D >= Dist[E.Target]) {
+        continue;
+      }
 
-  for (auto &Line : AllLines) {
-    if (Line.empty() || Line[0] == '#') {
-      continue;
+      Dist[E.Target] = D;
+      if (E.Weight == 0) {
+        Q.push_front(E.Target);
+      } else {
+        Q.push_back(E.Target);
+      }
     }
+  }
+
+  return Dist;
+}
+
+// Maximum score of each line of a source file
+using LineScoresTy = DenseMap<unsigned int, DAFLAnalysis::WeightTy>;
+
+} // namespace
+
+static void addLineScore(StringMap<LineScoresTy> &FileScores, StringRef File,
+                         unsigned int Line, DAFLAnalysis::WeightTy Score) {
+  auto &LineScore = FileScores[File][Line];
+  LineScore = std::max(LineScore, Score);
+}
+
+static void readTextScores(MemoryBufferRef Buffer,
+                           StringMap<LineScoresTy> &FileScores, bool Verbose) {
+  // A single line can have multiple function names for cloned functions.
+  StringMap<StringSet<>> LineFnNames;
+
+  for (line_iterator LineIt(Buffer, /*SkipBlanks=*/true, '#');
+       !LineIt.is_at_eof(); ++LineIt) {
+    auto Line = *LineIt;
 
     SmallVector<StringRef, 3> LineSplit;
     Line.split(LineSplit, ',');
@@ -72,25 +133,52 @@ DAFLAnalysis::readFromFile(Module &M, std::unique_ptr<MemoryBuffer> &Buffer) {
     auto FnName = LineSplit[1];
     auto FileLine = LineSplit[2];
 
-    auto LS = LineToScores.find(FileLine);
-    if (LS == LineToScores.end()) {
-      LineToScores[FileLine] = {{FnName}, {Score}};
-      continue;
+    auto FileLineSplit = FileLine.rsplit(':');
+    unsigned int LineNum;
+    if (FileLineSplit.second.getAsInteger(10, LineNum)) {
+      auto Err = formatv("Invalid DAFL input file format: bad location {0}",
+                         FileLine);
+      report_fatal_error(Err);
     }
 
-    auto &LSV = LS->getValue();
-    auto &LineFnNames = LSV.first;
-    auto &LineScores = LSV.second;
+    addLineScore(FileScores, FileLineSplit.first, LineNum, Score);
 
-    auto NewFnName = LineFnNames.insert(FnName).second;
-    if (Verbose && NewFnName && LineFnNames.size() > 1) {
-      // Static inline functions defined in header files may be cloned.
-      // Otherwise, you might have inlining turned on.
-      errs() << "[DAFL] Multiple functions for line " << FileLine << ": "
-             << FnName << '\n';
+    if (Verbose) {
+      auto &FnNames = LineFnNames[FileLine];
+      if (FnNames.insert(FnName).second && FnNames.size() > 1) {
+        // Static inline functions defined in header files may be cloned.
+        // Otherwise, you might have inlining turned on.
+        errs() << "[DAFL] Multiple functions for line " << FileLine << ": "
+               << FnName << '\n';
+      }
     }
+  }
+}
 
-    LineScores.push_back(Score);
+DAFLAnalysis::Result
+DAFLAnalysis::readFromFile(Module &M, std::unique_ptr<MemoryBuffer> &Buffer) {
+  // The input file may contain multiple scores for the same file:line. This can
+  // happen for example with ternary operators written in a single line. It
+  // could also happen when linking multiple programs in parallel against the
+  // same target library (i.e. specified target locations are in the library);
+  // in this case make sure to use a unique DAFL file for each linker
+  // invocation. Only the maximum score of each line is relevant.
+  StringMap<LineScoresTy> FileScores;
+
+  auto BufferRef = Buffer->getMemBufferRef();
+  if (hasLocationScoresMagic(BufferRef, BinaryMagic)) {
+    auto Err = readLocationScores(
+        BufferRef, BinaryMagic,
+        [&FileScores](unsigned int, const LocationScore &Score) {
+          addLineScore(FileScores, Score.File, Score.Line, Score.Value);
+        });
+    if (Err) {
+      auto ErrorMessage = formatv("Invalid DAFL input file: {0}",
+                                  toString(std::move(Err)));
+      report_fatal_error(ErrorMessage);
+    }
+  } else {
+    readTextScores(BufferRef, FileScores, Verbose);
   }
 
   DenseMap<const BasicBlock *, WeightTy> Res;
@@ -100,14 +188,14 @@ DAFLAnalysis::readFromFile(Module &M, std::unique_ptr<MemoryBuffer> &Buffer) {
   // out of a BB); hence there might be multiple scores per basic block. We keep
   // the maximum.
 
-  // Keep track of seen file:line for each basic block to avoid counting the
-  // same score multiple times.
-  StringSet<> BBFileLines;
+  // Resolving paths requires syscalls, so look up the scores of each DIFile
+  // only once.
+  DIFilePathCache Paths(/*RealPath=*/true);
+  DenseMap<const DIFile *, const LineScoresTy *> FileScoresCache;
 
   for (auto &F : M) {
     for (auto &BB : F) {
       WeightTy MaxScore = 0;
-      BBFileLines.clear();
 
       for (auto &I : BB) {
         auto *Loc = I.getDebugLoc().get();
@@ -115,21 +203,24 @@ DAFLAnalysis::readFromFile(Module &M, std::unique_ptr<MemoryBuffer> &Buffer) {
           continue;
         }
 
-        auto AbsolutePath = SmallString<128>(Loc->getFilename());
-        sys::fs::make_absolute(Loc->getDirectory(), AbsolutePath);
-        auto RealPath = SmallString<128>();
-        sys::fs::real_path(AbsolutePath, RealPath);
+        auto CacheIt = FileScoresCache.find(Loc->getFile());
+        if (CacheIt == FileScoresCache.end()) {
+          const LineScoresTy *LineScores = nullptr;
+          auto ScoresIt = FileScores.find(Paths.getPath(*Loc->getFile()));
+          if (ScoresIt != FileScores.end()) {
+            LineScores = &ScoresIt->second;
+          }
+          CacheIt = FileScoresCache.insert({Loc->getFile(), LineScores}).first;
+        }
 
-        auto FileLine = SmallString<256>(RealPath);
-        FileLine += ':' + std::to_string(Loc->getLine());
+        const auto *LineScores = CacheIt->second;
+        if (!LineScores) {
+          continue;
+        }
 
-        auto LS = LineToScores.find(FileLine);
-        if (LS != LineToScores.end() && BBFileLines.insert(FileLine).second) {
-          auto &Scores = LS->second.second;
-          auto Score = *std::max_element(Scores.begin(), Scores.end());
-          if (Score > MaxScore) {
-            MaxScore = Score;
-          }
+        auto ScoreIt = LineScores->find(Loc->getLine());
+        if (ScoreIt != LineScores->end()) {
+          MaxScore = std::max(MaxScore, ScoreIt->second);
         }
       }
 
@@ -145,8 +236,9 @@ DAFLAnalysis::readFromFile(Module &M, std::unique_ptr<MemoryBuffer> &Buffer) {
 DAFLAnalysis::Result DAFLAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
 
   if (!InputFile.empty()) {
-    auto VFS = vfs::getRealFileSystem();
-    auto BufferOrErr = VFS->getBufferForFile(InputFile);
+    // The binary format is read in place, so have the file memory mapped.
+    auto BufferOrErr = MemoryBuffer::getFile(
+        InputFile, /*IsText=*/false, /*RequiresNullTerminator=*/false);
     if (auto EC = BufferOrErr.getError()) {
       auto ErrorMessage = formatv("can't open DAFL input file '{0}': {1}",
                                   InputFile, EC.message());
@@ -172,38 +264,17 @@ DAFLAnalysis::Result DAFLAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
     report_fatal_error("No target instructions found from target detection");
   }
 
-  // Enable SVF debug output if requested
-  auto &PrintOption = const_cast<Option<bool> &>(SVF::Options::PStat);
-  PrintOption.setValue(Verbose || DebugFiles);
-
-  auto *LLVMModuleSet = SVF::LLVMModuleSet::getLLVMModuleSet();
-  auto *SVFModule = LLVMModuleSet->buildSVFModule(M);
+  auto &PTA = MAM.getResult<SVFPointerAnalysis>(M);
+  auto *LLVMModuleSet = &PTA.getModuleSet();
 
   if (DebugFiles) {
     LLVMModuleSet->dumpModulesToFile(".svf.bc");
-  }
-
-  SVF::SVFIRBuilder Builder(SVFModule);
-  auto *PAG = Builder.build();
-
-  if (DebugFiles) {
-    PAG->dump("pag");
+    PTA.getPAG().dump("pag");
     outs() << '\n';
   }
 
-  auto *Andersen = SVF::AndersenWaveDiff::createAndersenWaveDiff(PAG);
-
-  /// Call Graph
-  // SVF::PTACallGraph *Callgraph = Andersen->getPTACallGraph();
-
-  /// Value-Flow Graph (VFG)
-  // SVF::VFG *VFG = new SVF::VFG(Callgraph);
-
   /// Sparse value-flow graph (SVFG)
-  SVF::SVFGBuilder SvfBuilder(true);
-  SVF::SVFG *SVFG = SvfBuilder.buildFullSVFG(Andersen);
-  // updateCallGraph() is called in buildFullSVFG()->build() if true is passed
-  // to SVFGBuilder constructor
+  auto *SVFG = &PTA.getSVFG();
 
   if (DebugFiles) {
     SVFG->dump("svfg");
@@ -306,35 +377,64 @@ DAFLAnalysis::Result DAFLAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
     report_fatal_error("No target instructions left after filtering");
   }
 
+  auto GetLLVMValue = [LLVMModuleSet](const SVF::VFGNode *Node) {
+    auto *SVFVal = Node->getValue();
+    return SVFVal ? LLVMModuleSet->getLLVMValue(SVFVal) : nullptr;
+  };
+
   // track which instructions are present in SVFG
   SmallSet<const Instruction *, 32> SeenTargetIs;
 
-  // adjacency list from node to its defs
-  std::map<NodeID, std::vector<Edge>> G;
-  // use a dummy node to connect to target instructions
-  auto SentinelNode = -1;
+  // Only nodes that reach a target backward get a score, so the graph is the
+  // backward slice from the target nodes. Slice nodes are numbered in
+  // discovery order, with the sentinel node connected to the target nodes
+  // taking number 0.
+  constexpr uint32_t SentinelNode = 0;
+  std::vector<const SVF::VFGNode *> SliceNodes{nullptr};
+  DenseMap<SVF::NodeID, uint32_t> SliceIds;
+
+  auto GetSliceId = [&SliceNodes, &SliceIds](const SVF::VFGNode *Node) {
+    auto Inserted = SliceIds.insert({Node->getId(), SliceNodes.size()});
+    if (Inserted.second) {
+      SliceNodes.push_back(Node);
+    }
+    return Inserted.first->second;
+  };
+
+  CSRGraph G;
 
+  // connect sentinel node to target nodes
   for (auto SVFGNodeIt = SVFG->begin(), SVFGNodeItEnd = SVFG->end();
        SVFGNodeIt != SVFGNodeItEnd; ++SVFGNodeIt) {
     auto *Node = SVFGNodeIt->second;
+    auto *NodeInst = dyn_cast_or_null<Instruction>(GetLLVMValue(Node));
+    if (NodeInst && TargetIs.count(NodeInst)) {
+      SeenTargetIs.insert(NodeInst);
+      G.addEdge(GetSliceId(Node), 0);
+    }
+  }
+  G.finishNode();
 
-    auto *NodeSVFVal = Node->getValue();
-    auto *NodeVal =
-        NodeSVFVal ? LLVMModuleSet->getLLVMValue(NodeSVFVal) : nullptr;
-    auto *NodeInst = dyn_cast_or_null<Instruction>(NodeVal);
-    auto *NodeGEP = dyn_cast_or_null<GetElementPtrInst>(NodeVal);
-
-    if (NodeInst) {
-      for (auto *TargetI : TargetIs) {
-        if (NodeInst == TargetI) {
-          SeenTargetIs.insert(NodeInst);
-          // connect sentinel node to target node
-          G[SentinelNode].push_back({Node->getId(), 0});
-        }
-      }
+  auto HasAllTargets = true;
+  for (auto *TargetI : TargetIs) {
+    if (SeenTargetIs.find(TargetI) == SeenTargetIs.end()) {
+      HasAllTargets = false;
+      errs() << "Target not found in SVFG: " << *TargetI << "\n";
     }
+  }
 
-    G[Node->getId()] = std::vector<Edge>();
+  if (!HasAllTargets) {
+    report_fatal_error("Not all targets found in SVFG");
+  }
+
+  // Nodes are visited in the same order they are numbered, so each node gets
+  // its edges to its defs right after the previous one.
+  for (uint32_t SliceId = 1; SliceId < SliceNodes.size(); ++SliceId) {
+    auto *Node = SliceNodes[SliceId];
+
+    auto *NodeVal = GetLLVMValue(Node);
+    auto *NodeInst = dyn_cast_or_null<Instruction>(NodeVal);
+    auto *NodeGEP = dyn_cast_or_null<GetElementPtrInst>(NodeVal);
 
     for (auto InEdgeIt = Node->InEdgeBegin(), InEdgeItEnd = Node->InEdgeEnd();
          InEdgeIt != InEdgeItEnd; ++InEdgeIt) {
@@ -343,101 +443,43 @@ DAFLAnalysis::Result DAFLAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
 
       // thin slicing: skip base pointer dereferences
       if (NodeGEP) {
-        auto *DefSVFVal = DefNode->getValue();
-        auto *DefVal =
-            DefSVFVal ? LLVMModuleSet->getLLVMValue(DefSVFVal) : nullptr;
+        auto *DefVal = GetLLVMValue(DefNode);
         if (DefVal && DefVal == NodeGEP->getPointerOperand()) {
           continue;
         }
       }
 
-      WeightTy Weight = 1;
+      uint32_t Weight = 1;
       if (!NodeInst) {
         Weight = 0;
       }
 
-      G[Node->getId()].push_back({DefNode->getId(), Weight});
+      G.addEdge(GetSliceId(DefNode), Weight);
     }
-  }
 
-  auto HasAllTargets = true;
-  for (auto *TargetI : TargetIs) {
-    if (SeenTargetIs.find(TargetI) == SeenTargetIs.end()) {
-      HasAllTargets = false;
-      errs() << "Target not found in SVFG: " << *TargetI << "\n";
-    }
+    G.finishNode();
   }
 
-  if (!HasAllTargets) {
-    report_fatal_error("Not all targets found in SVFG");
-  }
-
-  // compute distance from sentinel node to all other nodes
-  std::map<NodeID, WeightTy> Dist;
-  std::map<NodeID, NodeID> Pred;
-  auto UnreachableDist = std::numeric_limits<WeightTy>::max();
-  for (auto &KV : G) {
-    Dist[KV.first] = UnreachableDist;
-    Pred[KV.first] = -1;
-  }
-
-  Dist[SentinelNode] = 0;
-  std::set<std::pair<WeightTy, NodeID>> Q;
-
-  Q.insert({Dist[SentinelNode], SentinelNode});
-
-  while (!Q.empty()) {
-    auto It = Q.begin();
-    auto D = It->first;
-    auto U = It->second;
-    Q.erase(It);
-
-    for (auto &Edge : G[U]) {
-      auto V = Edge.Target;
-      auto W = Edge.Weight;
-      if (D + W < Dist[V]) {
-        Q.erase({Dist[V], V});
-        Dist[V] = D + W;
-        Pred[V] = U;
-        Q.insert({Dist[V], V});
-      }
-    }
-  }
+  // compute distance from sentinel node to all other nodes, which are all
+  // reachable by construction
+  auto Dist = computeDistances(G, SentinelNode);
 
   WeightTy MaxDist = 0;
-  for (auto &KV : Dist) {
-    if (KV.first == SentinelNode || KV.second == UnreachableDist) {
-      continue;
-    }
-    MaxDist = std::max(MaxDist, KV.second);
+  for (uint32_t SliceId = 1; SliceId < G.size(); ++SliceId) {
+    MaxDist = std::max(MaxDist, Dist[SliceId]);
   }
 
   Result Res = Result::value_type();
-  for (auto &KV : Dist) {
-    if (KV.first == SentinelNode || KV.second == UnreachableDist) {
-      continue;
-    }
-
-    auto *Node = SVFG->getVFGNode(KV.first);
-    auto *SVFVal = Node->getValue();
-    auto *LLVMVal = SVFVal ? LLVMModuleSet->getLLVMValue(SVFVal) : nullptr;
+  for (uint32_t SliceId = 1; SliceId < G.size(); ++SliceId) {
+    auto *LLVMVal = GetLLVMValue(SliceNodes[SliceId]);
     if (auto *I = dyn_cast_or_null<Instruction>(LLVMVal)) {
       // score is proximity to target; higher is better
-      auto Score = (MaxDist - KV.second) + 1;
+      auto Score = (MaxDist - Dist[SliceId]) + 1;
       auto *BB = I->getParent();
-      if (Res->find(BB) == Res->end()) {
-        Res->insert({BB, Score});
-      } else {
-        (*Res)[BB] = std::max(Score, (*Res)[BB]);
-      }
+      auto &BBScore = (*Res)[BB];
+      BBScore = std::max(Score, BBScore);
     }
   }
 
-  // clean up memory
-  SVF::AndersenWaveDiff::releaseAndersenWaveDiff();
-  SVF::SVFIR::releaseSVFIR();
-
-  SVF::LLVMModuleSet::releaseLLVMModuleSet();
-
   return Res;
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include <Analysis/DIFilePathCache.hpp>
+
+#include <llvm/Support/FileSystem.h>
+
+using namespace llvm;
+
+SmallString<128> llvm::resolveSourcePath(const DIFile &File, bool RealPath) {
+  auto AbsolutePath = SmallString<128>(File.getFilename());
+  sys::fs::make_absolute(File.getDirectory(), AbsolutePath);
+  if (!RealPath) {
+    return AbsolutePath;
+  }
+
+  auto ResolvedPath = SmallString<128>();
+  sys::fs::real_path(AbsolutePath, ResolvedPath);
+  return ResolvedPath;
+}
+
+StringRef DIFilePathCache::getPath(const DIFile &File) {
+  auto It = Paths.find(&File);
+  if (It != Paths.end()) {
+    return It->second;
+  }
+
+  auto Path = Saver.save(resolveSourcePath(File, RealPath).str());
+  Paths[&File] = Path;
+  return Path;
+}
@@ -0,0 +1,225 @@
+#include <Analysis/DistanceCache.hpp>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/bit.h>
+#include <llvm/Support/BinaryByteStream.h>
+#include <llvm/Support/BinaryStreamReader.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+// Layout of the cache file, all integers are little-endian:
+//
+//   magic      char[8]
+//   functions  u32 count, count x (u64 key, f64 distance)
+//   blocks     u32 count, count x (u64 key, u32 records,
+//                                  records x (u32 block, f64 distance))
+static const char *const CacheMagic = "AFLGODC2";
+
+static Error readDouble(BinaryStreamReader &Reader, double &Value) {
+  uint64_t Bits;
+  if (auto Err = Reader.readInteger(Bits)) {
+    return Err;
+  }
+  Value = bit_cast<double>(Bits);
+  return Error::success();
+}
+
+AnalysisKey DistanceCacheAnalysis::Key;
+
+DistanceCache::DistanceCache(std::string Path) : Path(Path) { read(); }
+
+DistanceCache::~DistanceCache() {
+  if (Hits || Misses) {
+    errs() << formatv("[AFLGo] distance cache: {0} hits, {1} misses\n", Hits,
+                      Misses);
+  }
+
+  if (Dirty || UsedFunctionDistances.size() != StoredFunctionDistances.size() ||
+      UsedBBDistances.size() != StoredBBDistances.size()) {
+    write();
+  }
+}
+
+void DistanceCache::read() {
+  auto BufferOrErr = MemoryBuffer::getFile(Path, false, false);
+  if (!BufferOrErr) {
+    // No previous link
+    return;
+  }
+
+  BinaryByteStream Stream(arrayRefFromStringRef((*BufferOrErr)->getBuffer()),
+                          support::little);
+  BinaryStreamReader Reader(Stream);
+
+  auto ReadEntries = [&]() -> Error {
+    StringRef Magic;
+    if (auto Err = Reader.readFixedString(Magic, strlen(CacheMagic))) {
+      return Err;
+    }
+    if (Magic != CacheMagic) {
+      return createStringError(inconvertibleErrorCode(),
+                               formatv("unexpected magic '{0}'", Magic));
+    }
+
+    uint32_t NumFunctions;
+    if (auto Err = Reader.readInteger(NumFunctions)) {
+      return Err;
+    }
+    for (uint32_t Entry = 0; Entry < NumFunctions; ++Entry) {
+      uint64_t Key;
+      double Distance;
+      if (auto Err = Reader.readInteger(Key)) {
+        return Err;
+      }
+      if (auto Err = readDouble(Reader, Distance)) {
+        return Err;
+      }
+      StoredFunctionDistances[Key] = Distance;
+    }
+
+    uint32_t NumEntries;
+    if (auto Err = Reader.readInteger(NumEntries)) {
+      return Err;
+    }
+    for (uint32_t Entry = 0; Entry < NumEntries; ++Entry) {
+      uint64_t Key;
+      uint32_t NumRecords;
+      if (auto Err = Reader.readInteger(Key)) {
+        return Err;
+      }
+      if (auto Err = Reader.readInteger(NumRecords)) {
+        return Err;
+      }
+
+      auto &Distances = StoredBBDistances[Key];
+      Distances.resize(NumRecords);
+      for (auto &Record : Distances) {
+        if (auto Err = Reader.readInteger(Record.first)) {
+          return Err;
+        }
+        if (auto Err = readDouble(Reader, Record.second)) {
+          return Err;
+        }
+      }
+    }
+
+    return Error::success();
+  };
+
+  if (auto Err = ReadEntries()) {
+    // A stale cache is never an error, the distances are just computed again.
+    errs() << formatv("[AFLGo] ignoring distance cache {0}: {1}\n", Path,
+                      toString(std::move(Err)));
+    StoredFunctionDistances.clear();
+    StoredBBDistances.clear();
+  }
+}
+
+void DistanceCache::write() {
+  std::string TmpPath =
+      formatv("{0}.tmp{1}", Path, sys::Process::getProcessId());
+
+  {
+    std::error_code EC;
+    raw_fd_ostream OS(TmpPath, EC);
+    if (EC) {
+      errs() << formatv("[AFLGo] can't store distances in {0}: {1}\n", TmpPath,
+                        EC.message());
+      return;
+    }
+
+    OS << CacheMagic;
+    support::endian::Writer W(OS, support::little);
+    W.write<uint32_t>(UsedFunctionDistances.size());
+    for (auto &Entry : UsedFunctionDistances) {
+      W.write<uint64_t>(Entry.first);
+      W.write<double>(Entry.second);
+    }
+
+    W.write<uint32_t>(UsedBBDistances.size());
+    for (auto &Entry : UsedBBDistances) {
+      W.write<uint64_t>(Entry.first);
+      W.write<uint32_t>(Entry.second.size());
+      for (auto &Record : Entry.second) {
+        W.write<uint32_t>(Record.first);
+        W.write<double>(Record.second);
+      }
+    }
+  }
+
+  if (auto EC = sys::fs::rename(TmpPath, Path)) {
+    errs() << formatv("[AFLGo] can't store distances in {0}: {1}\n", Path,
+                      EC.message());
+    sys::fs::remove(TmpPath);
+  }
+}
+
+bool DistanceCache::lookupFunctionDistance(uint64_t Key, double &Distance) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+
+  auto It = StoredFunctionDistances.find(Key);
+  if (It == StoredFunctionDistances.end()) {
+    ++Misses;
+    return false;
+  }
+
+  ++Hits;
+  Distance = It->second;
+  UsedFunctionDistances.insert({Key, It->second});
+  return true;
+}
+
+void DistanceCache::storeFunctionDistance(uint64_t Key, double Distance) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+
+  UsedFunctionDistances.insert({Key, Distance});
+  Dirty = true;
+}
+
+bool DistanceCache::lookupBBDistances(uint64_t Key, BBDistancesTy &Distances) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+
+  auto It = StoredBBDistances.find(Key);
+  if (It == StoredBBDistances.end()) {
+    ++Misses;
+    return false;
+  }
+
+  ++Hits;
+  Distances = It->second;
+  UsedBBDistances.insert({Key, It->second});
+  return true;
+}
+
+void DistanceCache::storeBBDistances(uint64_t Key, BBDistancesTy Distances) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+
+  UsedBBDistances.insert({Key, std::move(Distances)});
+  Dirty = true;
+}
+
+DistanceCacheAnalysis::Result
+DistanceCacheAnalysis::run(Module &M, ModuleAnalysisManager &) {
+  if (CacheDir.empty()) {
+    return nullptr;
+  }
+
+  if (auto EC = sys::fs::create_directories(CacheDir)) {
+    std::string ErrorMessage =
+        formatv("can't create distance cache directory '{0}': {1}", CacheDir,
+                EC.message());
+    report_fatal_error(Twine(ErrorMessage));
+  }
+
+  auto Path = SmallString<128>(CacheDir);
+  sys::path::append(Path, "distances");
+  return std::make_unique<DistanceCache>(Path.str().str());
+}
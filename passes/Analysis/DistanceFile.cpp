@@ -0,0 +1,167 @@
+#include <Analysis/DistanceFile.hpp>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/bit.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <algorithm>
+
+using namespace llvm;
+
+AnalysisKey DistanceFileAnalysis::Key;
+
+// First instruction of BB with a line
+static const DILocation *getFirstLocation(const BasicBlock &BB) {
+  for (auto &I : BB) {
+    auto *Loc = I.getDebugLoc().get();
+    if (Loc && !Loc->getFilename().empty() && Loc->getLine() > 0) {
+      return Loc;
+    }
+  }
+
+  return nullptr;
+}
+
+void DistanceFileWriter::addBasicBlock(const BasicBlock &BB, double Distance) {
+  if (auto *Loc = getFirstLocation(BB)) {
+    Writer.add(DistanceFileAnalysis::BasicBlockTable,
+               Paths.getPath(*Loc->getFile()), Loc->getLine(),
+               bit_cast<uint64_t>(Distance));
+  }
+}
+
+void DistanceFileWriter::addFunction(const Function &F, double Distance) {
+  auto *SP = F.getSubprogram();
+  if (SP && SP->getFile() && SP->getLine() > 0) {
+    Writer.add(DistanceFileAnalysis::FunctionTable,
+               Paths.getPath(*SP->getFile()), SP->getLine(),
+               bit_cast<uint64_t>(Distance));
+  }
+}
+
+void DistanceFileWriter::write(raw_ostream &OS) const {
+  Writer.write(OS, DistanceFileAnalysis::BinaryMagic);
+}
+
+namespace {
+
+// Minimum distance of each line of a source file
+using LineDistancesTy = DenseMap<unsigned int, double>;
+
+// Distances of one table, looked up by debug location. Resolving paths
+// requires syscalls, so the distances of each DIFile are looked up only once.
+class LocationDistances {
+  DIFilePathCache &Paths;
+  StringMap<LineDistancesTy> FileDistances;
+  DenseMap<const DIFile *, const LineDistancesTy *> Cache;
+
+public:
+  explicit LocationDistances(DIFilePathCache &Paths) : Paths(Paths) {}
+
+  void add(StringRef File, unsigned int Line, double Distance) {
+    auto Inserted = FileDistances[File].insert({Line, Distance});
+    if (!Inserted.second) {
+      Inserted.first->second = std::min(Inserted.first->second, Distance);
+    }
+  }
+
+  Optional<double> find(const DIFile &File, unsigned int Line) {
+    auto CacheIt = Cache.find(&File);
+    if (CacheIt == Cache.end()) {
+      const LineDistancesTy *LineDistances = nullptr;
+      auto DistancesIt = FileDistances.find(Paths.getPath(File));
+      if (DistancesIt != FileDistances.end()) {
+        LineDistances = &DistancesIt->second;
+      }
+      CacheIt = Cache.insert({&File, LineDistances}).first;
+    }
+
+    if (!CacheIt->second) {
+      return None;
+    }
+
+    auto LineIt = CacheIt->second->find(Line);
+    if (LineIt == CacheIt->second->end()) {
+      return None;
+    }
+
+    return LineIt->second;
+  }
+};
+
+} // namespace
+
+DistanceFileAnalysis::Result
+DistanceFileAnalysis::run(Module &M, ModuleAnalysisManager &) {
+  if (InputFile.empty()) {
+    return None;
+  }
+
+  // The file is read in place, so have it memory mapped.
+  auto BufferOrErr = MemoryBuffer::getFile(InputFile, /*IsText=*/false,
+                                           /*RequiresNullTerminator=*/false);
+  if (auto EC = BufferOrErr.getError()) {
+    std::string ErrorMessage =
+        formatv("can't open distance input file '{0}': {1}", InputFile,
+                EC.message());
+    report_fatal_error(Twine(ErrorMessage));
+  }
+
+  errs() << "[AFLGo] distance input file: " << InputFile << '\n';
+
+  DIFilePathCache Paths(/*RealPath=*/true);
+  LocationDistances BBDistances(Paths);
+  LocationDistances FunctionDistances(Paths);
+
+  auto Err = readLocationScores(
+      (*BufferOrErr)->getMemBufferRef(), BinaryMagic,
+      [&](unsigned int Table, const LocationScore &Score) {
+        auto Distance = bit_cast<double>(Score.Value);
+        if (Table == BasicBlockTable) {
+          BBDistances.add(Score.File, Score.Line, Distance);
+        } else if (Table == FunctionTable) {
+          FunctionDistances.add(Score.File, Score.Line, Distance);
+        }
+      });
+  if (Err) {
+    std::string ErrorMessage = formatv("invalid distance input file '{0}': {1}",
+                                       InputFile, toString(std::move(Err)));
+    report_fatal_error(Twine(ErrorMessage));
+  }
+
+  Distances Res;
+  for (auto &F : M) {
+    if (F.isDeclaration()) {
+      continue;
+    }
+
+    auto *SP = F.getSubprogram();
+    if (SP && SP->getFile()) {
+      auto Distance = FunctionDistances.find(*SP->getFile(), SP->getLine());
+      if (Distance) {
+        Res.Functions[&F] = *Distance;
+      }
+    }
+
+    auto &FunctionBBDistances = Res.BasicBlocks[&F];
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        auto *Loc = I.getDebugLoc().get();
+        if (!Loc || Loc->getFilename().empty() || Loc->getLine() == 0) {
+          continue;
+        }
+
+        auto Distance = BBDistances.find(*Loc->getFile(), Loc->getLine());
+        if (Distance) {
+          FunctionBBDistances[&BB] = *Distance;
+          break;
+        }
+      }
+    }
+  }
+
+  return Res;
+}
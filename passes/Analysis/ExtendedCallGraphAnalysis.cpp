@@ -1,36 +1,37 @@
 #include <Analysis/ExtendedCallGraph.hpp>
+#include <Analysis/PointerAnalysis.hpp>
 
 #include "SVF-LLVM/LLVMModule.h"
-#include "SVF-LLVM/SVFIRBuilder.h"
-#include "SVFIR/SVFIR.h"
-#include "Util/Options.h"
 #include "WPA/Andersen.h"
 
+#include <llvm/ADT/APInt.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/SetVector.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Demangle/Demangle.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Metadata.h>
+
 #include <memory>
 #include <utility>
+#include <vector>
 
 using namespace llvm;
 
 AnalysisKey ExtendedCallGraphAnalysis::Key;
 
-ExtendedCallGraphAnalysis::Result
-ExtendedCallGraphAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
-  // There is no other way to disable printing inside SVF.
-  auto &PrintOption = const_cast<Option<bool> &>(SVF::Options::PStat);
-  PrintOption.setValue(false);
-
-  // We need to modify our own copy of the call graph to avoid breaking other
-  // LLVM passes. This call graph is useful only to us anyway.
-  auto LLVMCallGraph = CallGraph(M);
-
-  auto *LLVMModuleSet = SVF::LLVMModuleSet::getLLVMModuleSet();
-  auto *SVFModule = LLVMModuleSet->buildSVFModule(M);
-
-  SVF::SVFIRBuilder Builder(SVFModule);
-  auto *PAG = Builder.build();
-
-  auto *Andersen = SVF::AndersenWaveDiff::createAndersenWaveDiff(PAG);
-  auto *SVFCallGraph = Andersen->getPTACallGraph();
+static void addAndersenEdges(Module &M, ModuleAnalysisManager &MAM,
+                             CallGraph &LLVMCallGraph) {
+  auto &PTA = MAM.getResult<SVFPointerAnalysis>(M);
+  auto *LLVMModuleSet = &PTA.getModuleSet();
+  auto *SVFCallGraph = PTA.getAndersen().getPTACallGraph();
 
   auto &IndCallMap = SVFCallGraph->getIndCallMap();
   for (auto &IndCallEntry : IndCallMap) {
@@ -48,10 +49,383 @@ ExtendedCallGraphAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
                                         LLVMCallGraph[LLVMCallee]);
     }
   }
+}
+
+// Function type with all pointers replaced by i8*: with typed pointers,
+// functions are often called through pointers cast to a different type.
+static FunctionType *getErasedType(FunctionType *FTy) {
+  auto *PtrTy = Type::getInt8PtrTy(FTy->getContext());
+  auto Erase = [PtrTy](Type *T) { return T->isPointerTy() ? PtrTy : T; };
+
+  SmallVector<Type *, 8> Params;
+  for (auto *ParamTy : FTy->params()) {
+    Params.push_back(Erase(ParamTy));
+  }
+
+  return FunctionType::get(Erase(FTy->getReturnType()), Params,
+                           FTy->isVarArg());
+}
+
+// Clang marks loads of vtable pointers with a dedicated TBAA type.
+static bool isVTablePointerLoad(const LoadInst &Load) {
+  auto *Tag = Load.getMetadata(LLVMContext::MD_tbaa);
+  if (!Tag || Tag->getNumOperands() < 2) {
+    return false;
+  }
+
+  auto *BaseTy = dyn_cast<MDNode>(Tag->getOperand(0));
+  if (!BaseTy || BaseTy->getNumOperands() < 1) {
+    return false;
+  }
+
+  auto *Name = dyn_cast<MDString>(BaseTy->getOperand(0));
+  return Name && Name->getString() == "vtable pointer";
+}
+
+// Returns the vtable pointer load and the offset in bytes of the callee from
+// the vtable pointer if CB is a virtual call, i.e., if the callee is loaded at
+// a constant offset from a vtable pointer.
+static Optional<std::pair<const LoadInst *, uint64_t>>
+getVirtualCall(const CallBase &CB, const DataLayout &DL) {
+  auto *FnLoad =
+      dyn_cast<LoadInst>(CB.getCalledOperand()->stripPointerCasts());
+  if (!FnLoad) {
+    return None;
+  }
+
+  auto *FnPtr = FnLoad->getPointerOperand();
+  APInt Offset(DL.getIndexTypeSizeInBits(FnPtr->getType()), 0);
+  auto *VTable = FnPtr->stripAndAccumulateConstantOffsets(
+      DL, Offset, /*AllowNonInbounds=*/false);
+
+  auto *VTableLoad = dyn_cast<LoadInst>(VTable);
+  if (!VTableLoad || !isVTablePointerLoad(*VTableLoad) ||
+      Offset.isNegative()) {
+    return None;
+  }
+
+  return std::pair<const LoadInst *, uint64_t>(VTableLoad,
+                                              Offset.getZExtValue());
+}
+
+// Type identifier that -fwhole-program-vtables checks a vtable pointer
+// against before a virtual call, e.g., _ZTS4Base.
+static const MDString *getCheckedTypeId(const Value &VTable) {
+  for (const auto *U : VTable.users()) {
+    if (isa<BitCastInst>(U)) {
+      if (auto *TypeId = getCheckedTypeId(*U)) {
+        return TypeId;
+      }
+      continue;
+    }
+
+    auto *Call = dyn_cast<CallInst>(U);
+    auto *Callee = Call ? Call->getCalledFunction() : nullptr;
+    if (!Callee || (Callee->getName() != "llvm.type.test" &&
+                    Callee->getName() != "llvm.public.type.test")) {
+      continue;
+    }
+
+    auto *TypeId = cast<MetadataAsValue>(Call->getArgOperand(1));
+    return dyn_cast<MDString>(TypeId->getMetadata());
+  }
+
+  return nullptr;
+}
+
+// Name of the class of the object a vtable pointer is loaded from, e.g.,
+// ns::Base for %"class.ns::Base". Only typed pointers carry it.
+static Optional<StringRef> getReceiverClassName(const LoadInst &VTableLoad) {
+  auto *PtrTy = VTableLoad.getPointerOperand()->stripPointerCasts()->getType();
+  if (PtrTy->isOpaquePointerTy()) {
+    return None;
+  }
+
+  auto *STy = dyn_cast<StructType>(PtrTy->getNonOpaquePointerElementType());
+  if (!STy || !STy->hasName()) {
+    return None;
+  }
+
+  auto Name = STy->getName();
+  if (!Name.consume_front("class.") && !Name.consume_front("struct.")) {
+    return None;
+  }
+
+  // Types renamed on a name clash get a numeric suffix.
+  auto Suffix = Name.rsplit('.').second;
+  if (!Suffix.empty() && all_of(Suffix, isDigit)) {
+    Name = Name.drop_back(Suffix.size() + 1);
+  }
+  return Name;
+}
+
+// Returns the function at Offset bytes in the initializer of a vtable group.
+static Function *getFunctionAt(Constant *C, uint64_t Offset,
+                               const DataLayout &DL) {
+  while (true) {
+    if (auto *CS = dyn_cast<ConstantStruct>(C)) {
+      auto *Layout = DL.getStructLayout(CS->getType());
+      if (Offset >= Layout->getSizeInBytes()) {
+        return nullptr;
+      }
+      auto Idx = Layout->getElementContainingOffset(Offset);
+      Offset -= Layout->getElementOffset(Idx);
+      C = CS->getOperand(Idx);
+    } else if (auto *CA = dyn_cast<ConstantArray>(C)) {
+      auto ElemSize =
+          DL.getTypeAllocSize(CA->getType()->getElementType()).getFixedSize();
+      auto Idx = Offset / ElemSize;
+      if (Idx >= CA->getNumOperands()) {
+        return nullptr;
+      }
+      Offset -= Idx * ElemSize;
+      C = CA->getOperand(Idx);
+    } else {
+      return Offset ? nullptr : dyn_cast<Function>(C->stripPointerCasts());
+    }
+  }
+}
+
+namespace {
+
+// Candidate callees of virtual calls by class hierarchy analysis. Calls
+// checked against a type identifier (-fwhole-program-vtables) may call the
+// functions at the same offset in the vtables with that type. Otherwise, a
+// call through an object of class C may call the functions in the same slot
+// of the vtables of C and of the classes derived from C, following the base
+// classes recorded in the RTTI. When the class of the object is unknown, e.g.,
+// with opaque pointers or without RTTI, the slot of every vtable is used.
+class VirtualCallees {
+  // Functions that may be found in each vtable slot, counting slots from the
+  // address point as virtual calls do.
+  using SlotVector = std::vector<SmallSetVector<Function *, 4>>;
+
+  const DataLayout &DL;
+  SlotVector AllSlots;
+  // Keyed by mangled class name, e.g., 4Base for _ZTV4Base.
+  StringMap<SlotVector> ClassSlots;
+  StringMap<SmallVector<StringRef, 4>> DerivedClasses;
+  // Classes with type information, to which the hierarchy is restricted
+  StringSet<> ClassesWithRTTI;
+  // Mangled class names by demangled name
+  StringMap<StringRef> MangledNames;
+  // Vtable groups and the offsets of their address points by type identifier
+  DenseMap<const MDString *,
+           SmallVector<std::pair<GlobalVariable *, uint64_t>, 4>>
+      TypeIdVTables;
+
+  void addClassName(StringRef MangledName);
+  void addVTable(const GlobalVariable &GV, StringRef MangledName);
+
+public:
+  explicit VirtualCallees(Module &M);
+
+  // Adds the functions that may be called at Offset bytes from the vtable
+  // pointer loaded by VTableLoad.
+  void find(const LoadInst &VTableLoad, uint64_t Offset,
+            SmallSetVector<Function *, 8> &Callees) const;
+};
+
+} // namespace
+
+VirtualCallees::VirtualCallees(Module &M) : DL(M.getDataLayout()) {
+  for (auto &GV : M.globals()) {
+    SmallVector<MDNode *, 2> Types;
+    GV.getMetadata(LLVMContext::MD_type, Types);
+    for (auto *Type : Types) {
+      auto *Offset = mdconst::dyn_extract<ConstantInt>(Type->getOperand(0));
+      auto *TypeId = dyn_cast<MDString>(Type->getOperand(1));
+      if (Offset && TypeId && GV.hasInitializer()) {
+        TypeIdVTables[TypeId].push_back({&GV, Offset->getZExtValue()});
+      }
+    }
+
+    if (!GV.hasInitializer()) {
+      continue;
+    }
+
+    auto Name = GV.getName();
+    if (Name.consume_front("_ZTV")) {
+      addVTable(GV, Name);
+    } else if (Name.consume_front("_ZTI")) {
+      // Type information of classes with bases (__si_class_type_info and
+      // __vmi_class_type_info) refers to that of the direct bases.
+      addClassName(Name);
+      ClassesWithRTTI.insert(Name);
+      for (const auto &Op : GV.getInitializer()->operands()) {
+        auto *Base = dyn_cast<GlobalVariable>(Op->stripPointerCasts());
+        if (Base && Base != &GV && Base->getName().startswith("_ZTI")) {
+          DerivedClasses[Base->getName().drop_front(4)].push_back(Name);
+        }
+      }
+    }
+  }
+}
+
+void VirtualCallees::addClassName(StringRef MangledName) {
+  StringRef Prefix = "vtable for ";
+  auto Demangled = demangle(("_ZTV" + MangledName).str());
+  if (StringRef(Demangled).startswith(Prefix)) {
+    MangledNames[Demangled.substr(Prefix.size())] = MangledName;
+  }
+}
+
+void VirtualCallees::addVTable(const GlobalVariable &GV,
+                               StringRef MangledName) {
+  addClassName(MangledName);
+  auto &Slots = ClassSlots[MangledName];
+
+  // Itanium ABI vtable groups are structs with one array per vtable.
+  SmallVector<const ConstantArray *, 4> VTables;
+  auto *Init = GV.getInitializer();
+  if (auto *CA = dyn_cast<ConstantArray>(Init)) {
+    VTables.push_back(CA);
+  } else if (auto *CS = dyn_cast<ConstantStruct>(Init)) {
+    for (const auto &Op : CS->operands()) {
+      if (auto *CA = dyn_cast<ConstantArray>(Op)) {
+        VTables.push_back(CA);
+      }
+    }
+  }
+
+  for (auto *CA : VTables) {
+    // Offsets and RTTI come before the address point, virtual functions
+    // (including __cxa_pure_virtual) after it.
+    Optional<unsigned int> AddressPoint;
+    for (unsigned int Idx = 0; Idx < CA->getNumOperands(); ++Idx) {
+      auto *F = dyn_cast<Function>(CA->getOperand(Idx)->stripPointerCasts());
+      if (!F) {
+        continue;
+      }
+
+      if (!AddressPoint) {
+        AddressPoint = Idx;
+      }
+
+      auto Slot = Idx - *AddressPoint;
+      for (auto *S : {&AllSlots, &Slots}) {
+        if (Slot >= S->size()) {
+          S->resize(Slot + 1);
+        }
+        (*S)[Slot].insert(F);
+      }
+    }
+  }
+}
+
+void VirtualCallees::find(const LoadInst &VTableLoad, uint64_t Offset,
+                          SmallSetVector<Function *, 8> &Callees) const {
+  if (auto *TypeId = getCheckedTypeId(VTableLoad)) {
+    auto VTablesIt = TypeIdVTables.find(TypeId);
+    if (VTablesIt != TypeIdVTables.end()) {
+      for (auto &VTable : VTablesIt->second) {
+        auto *Init = VTable.first->getInitializer();
+        if (auto *F = getFunctionAt(Init, VTable.second + Offset, DL)) {
+          Callees.insert(F);
+        }
+      }
+      return;
+    }
+  }
+
+  auto Slot = Offset / DL.getPointerSize();
+  auto AddSlot = [&](const SlotVector &Slots) {
+    if (Slot < Slots.size()) {
+      Callees.insert(Slots[Slot].begin(), Slots[Slot].end());
+    }
+  };
+
+  auto ClassName = getReceiverClassName(VTableLoad);
+  auto MangledIt =
+      ClassName ? MangledNames.find(*ClassName) : MangledNames.end();
+  if (MangledIt == MangledNames.end() ||
+      !ClassesWithRTTI.contains(MangledIt->second)) {
+    AddSlot(AllSlots);
+    return;
+  }
+
+  SmallVector<StringRef, 8> Worklist = {MangledIt->second};
+  StringSet<> Visited;
+  while (!Worklist.empty()) {
+    auto Class = Worklist.pop_back_val();
+    if (!Visited.insert(Class).second) {
+      continue;
+    }
 
-  SVF::AndersenWaveDiff::releaseAndersenWaveDiff();
-  SVF::SVFIR::releaseSVFIR();
-  SVF::LLVMModuleSet::releaseLLVMModuleSet();
+    auto SlotsIt = ClassSlots.find(Class);
+    if (SlotsIt != ClassSlots.end()) {
+      AddSlot(SlotsIt->second);
+    }
+
+    auto DerivedIt = DerivedClasses.find(Class);
+    if (DerivedIt != DerivedClasses.end()) {
+      Worklist.append(DerivedIt->second.begin(), DerivedIt->second.end());
+    }
+  }
+}
+
+static void addTypeEdges(Module &M, CallGraph &LLVMCallGraph) {
+  const auto &DL = M.getDataLayout();
+
+  DenseMap<FunctionType *, SmallVector<Function *, 4>> AddressTakenByType;
+  for (auto &F : M) {
+    if (F.hasAddressTaken(nullptr, /*IgnoreCallbackUses=*/false,
+                          /*IgnoreAssumeLikeCalls=*/true,
+                          /*IgnoreLLVMUsed=*/true)) {
+      AddressTakenByType[getErasedType(F.getFunctionType())].push_back(&F);
+    }
+  }
+
+  VirtualCallees Virtual(M);
+
+  for (auto &F : M) {
+    auto *CallerNode = LLVMCallGraph[&F];
+
+    for (auto &I : instructions(F)) {
+      auto *CB = dyn_cast<CallBase>(&I);
+      if (!CB || !CB->isIndirectCall()) {
+        continue;
+      }
+
+      auto *CallTy = getErasedType(CB->getFunctionType());
+
+      if (auto Call = getVirtualCall(*CB, DL)) {
+        SmallSetVector<Function *, 8> Callees;
+        Virtual.find(*Call->first, Call->second, Callees);
+        for (auto *Callee : Callees) {
+          if (getErasedType(Callee->getFunctionType()) == CallTy) {
+            CallerNode->addCalledFunction(CB, LLVMCallGraph[Callee]);
+          }
+        }
+        continue;
+      }
+
+      auto CalleesIt = AddressTakenByType.find(CallTy);
+      if (CalleesIt == AddressTakenByType.end()) {
+        continue;
+      }
+
+      for (auto *Callee : CalleesIt->second) {
+        CallerNode->addCalledFunction(CB, LLVMCallGraph[Callee]);
+      }
+    }
+  }
+}
+
+ExtendedCallGraphAnalysis::Result
+ExtendedCallGraphAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  // We need to modify our own copy of the call graph to avoid breaking other
+  // LLVM passes. This call graph is useful only to us anyway.
+  auto LLVMCallGraph = CallGraph(M);
+
+  switch (Resolver) {
+  case IndirectCallResolver::Andersen:
+    addAndersenEdges(M, MAM, LLVMCallGraph);
+    break;
+  case IndirectCallResolver::Type:
+    addTypeEdges(M, LLVMCallGraph);
+    break;
+  }
 
   return LLVMCallGraph;
-}
\ No newline at end of file
+}
@@ -1,238 +1,400 @@
-#include <Analysis/ExtendedCallGraph.hpp>
+#include <Analysis/CompactCallGraph.hpp>
+#include <Analysis/DistanceCache.hpp>
+#include <Analysis/DistanceFile.hpp>
 #include <Analysis/FunctionDistance.hpp>
 #include <Analysis/TargetDetection.hpp>
 
-#include <llvm/ADT/BreadthFirstIterator.h>
-#include <llvm/ADT/GraphTraits.h>
-#include <llvm/Analysis/CallGraph.h>
-
-#include <memory>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/MapVector.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+#include <algorithm>
+#include <queue>
 #include <utility>
+#include <vector>
 
 using namespace llvm;
 
 namespace {
 
-class InvertedCallGraphNode {
-public:
-  using CallRecord =
-      std::pair<Optional<WeakTrackingVH>, InvertedCallGraphNode *>;
-
-private:
-  friend class InvertedCallGraph;
+// Distances of all functions from a single target, indexed by node ID.
+using DistanceVector = std::vector<double>;
 
-  const std::unique_ptr<CallGraphNode> &Inner;
-  std::vector<CallRecord> Callers; // Non-owning pointers
+constexpr double UnreachableDistance = -1.0;
 
+// Callers of each function with the length of the call edge, with all the calls
+// between two functions merged into one edge.
+class WeightedCallers {
 public:
-  using iterator = std::vector<CallRecord>::iterator;
-  using const_iterator = std::vector<CallRecord>::const_iterator;
+  struct Edge {
+    unsigned int Caller;
+    double Weight;
+  };
 
-  inline iterator begin() { return Callers.begin(); }
-  inline iterator end() { return Callers.end(); }
-  inline const_iterator begin() const { return Callers.begin(); }
-  inline const_iterator end() const { return Callers.end(); }
+private:
+  SmallVector<unsigned int, 0> Offsets;
+  SmallVector<Edge, 0> Edges;
 
-  InvertedCallGraphNode(const std::unique_ptr<CallGraphNode> &Inner)
-      : Inner(Inner) {}
+public:
+  WeightedCallers(const CompactCallGraph &CCG, bool UseHawkeyeDistance);
 
-  const std::unique_ptr<CallGraphNode> &getInner() const { return Inner; }
+  ArrayRef<Edge> callers(unsigned int Id) const {
+    return makeArrayRef(Edges).slice(Offsets[Id],
+                                     Offsets[Id + 1] - Offsets[Id]);
+  }
 };
 
-class InvertedCallGraph {
-  using FunctionMapTy =
-      std::map<const Function *, std::unique_ptr<InvertedCallGraphNode>>;
+} // namespace
 
-  FunctionMapTy FunctionMap;
+WeightedCallers::WeightedCallers(const CompactCallGraph &CCG,
+                                 bool UseHawkeyeDistance) {
+  for (unsigned int Id = 0; Id < CCG.size(); ++Id) {
+    Offsets.push_back(Edges.size());
 
-public:
-  InvertedCallGraph(const CallGraph &CG) {
-    // Construct all nodes
-    for (auto &CGEntry : CG) {
-      auto *F = CGEntry.first;
-      auto &CGNode = CGEntry.second;
-      FunctionMap[F] = std::make_unique<InvertedCallGraphNode>(CGNode);
-    }
-
-    // Fill caller references
-    for (auto &CGEntry : CG) {
-      auto *F = CGEntry.first;
-      auto &CGNode = CGEntry.second;
-      for (auto &CGNodePair : *CGNode) {
-        auto &CallSite = CGNodePair.first;
-        auto *Callee = CGNodePair.second;
-        Function *CalleeF = Callee->getFunction();
-        if (!CalleeF) {
-          // Ignore external nodes
-          continue;
+    if (!UseHawkeyeDistance) {
+      SmallDenseSet<unsigned int, 16> Seen;
+      for (auto &Edge : CCG.callers(Id)) {
+        if (Seen.insert(Edge.Node).second) {
+          Edges.push_back({Edge.Node, 1.0});
         }
-
-        FunctionMap[CalleeF]->Callers.push_back(
-            std::make_pair(CallSite, FunctionMap[F].get()));
       }
+      continue;
     }
-  }
-
-  inline const InvertedCallGraphNode *operator[](const Function *F) const {
-    const auto I = FunctionMap.find(F);
-    return I->second.get();
-  }
-};
 
-} // namespace
+    // Number of calls and of distinct calling basic blocks for each caller;
+    // edges without a call site are ignored.
+    SmallMapVector<unsigned int, std::pair<double, double>, 16> Calls;
 
-template <> struct GraphTraits<const InvertedCallGraphNode *> {
-  using NodeRef = const InvertedCallGraphNode *;
-  using CGNPairTy = InvertedCallGraphNode::CallRecord;
-  using EdgeRef = const InvertedCallGraphNode::CallRecord &;
+    SmallPtrSet<BasicBlock *, 16> Seen;
+    for (auto &Edge : CCG.callers(Id)) {
+      if (!Edge.Call) {
+        continue;
+      }
+      Calls[Edge.Node].first++;
 
-  static NodeRef getEntryNode(const InvertedCallGraphNode *StartICGNode) {
-    return StartICGNode;
-  }
+      auto *BB = Edge.Call->getParent();
+      if (Seen.insert(BB).second) {
+        Calls[Edge.Node].second++;
+      }
+    }
 
-  static NodeRef getValue(CGNPairTy P) { return P.second; }
-  using ChildIteratorType =
-      mapped_iterator<InvertedCallGraphNode::const_iterator,
-                      decltype(&getValue)>;
+    for (auto &Entry : Calls) {
+      auto CallerId = Entry.first;
+      auto &CallerCounts = Entry.second;
 
-  // NOLINTNEXTLINE(readability-identifier-naming)
-  static ChildIteratorType child_begin(NodeRef N) {
-    return ChildIteratorType(N->begin(), &getValue);
-  }
+      float CallSiteCoeff =
+          (2 * CallerCounts.first + 1) / (2 * CallerCounts.first);
+      float CallBBCoeff =
+          (2 * CallerCounts.second + 1) / (2 * CallerCounts.second);
+      float EdgeDistance = CallSiteCoeff * CallBBCoeff;
 
-  // NOLINTNEXTLINE(readability-identifier-naming)
-  static ChildIteratorType child_end(NodeRef N) {
-    return ChildIteratorType(N->end(), &getValue);
+      Edges.push_back({CallerId, EdgeDistance});
+    }
   }
-};
+  Offsets.push_back(Edges.size());
+}
 
-std::map<Function *, double>
-getHawkeyeDistancesFromFunction(Function &TargetFunction,
-                                InvertedCallGraph &ICG) {
-  using QueueItem = std::pair<double, const InvertedCallGraphNode *>;
+// Shortest distances from all functions to the target, walking the condensed
+// call graph from callees to callers. Since SCCs are numbered callees first,
+// the distances of an SCC are final once the SCCs before it are done, so each
+// one is visited once and a priority queue is only needed within recursive
+// clusters.
+static void getDistancesFromFunction(unsigned int TargetId,
+                                     const CompactCallGraph &CCG,
+                                     const WeightedCallers &Callers,
+                                     DistanceVector &Distances) {
+  using QueueItem = std::pair<double, unsigned int>;
   using QueueType = std::priority_queue<QueueItem, SmallVector<QueueItem>,
                                         std::greater<QueueItem>>;
 
-  QueueType Queue;
+  Distances.assign(CCG.size(), UnreachableDistance);
+  Distances[TargetId] = 0;
 
-  auto *TargetFunctionNode = ICG[&TargetFunction];
-  Queue.emplace(0.0, TargetFunctionNode);
+  auto Relax = [&Distances](unsigned int Id, double Distance) {
+    auto &Current = Distances[Id];
+    if (Current == UnreachableDistance || Distance < Current) {
+      Current = Distance;
+      return true;
+    }
+    return false;
+  };
 
-  std::map<Function *, double> DistancesFromTarget;
-  while (!Queue.empty()) {
-    auto CurrentDistance = Queue.top().first;
-    auto *CurrentNode = Queue.top().second;
-    Queue.pop();
+  auto TargetSCC = CCG.getSCC(TargetId);
+  std::vector<bool> Reaching(CCG.getNumSCCs(), false);
+  Reaching[TargetSCC] = true;
 
-    auto *CurrentFunction = CurrentNode->getInner()->getFunction();
-    if (DistancesFromTarget.find(CurrentFunction) !=
-        DistancesFromTarget.end()) {
+  QueueType Queue;
+  for (auto SCC = TargetSCC; SCC < CCG.getNumSCCs(); ++SCC) {
+    if (!Reaching[SCC]) {
       continue;
     }
-    DistancesFromTarget[CurrentFunction] = CurrentDistance;
-
-    std::map<InvertedCallGraphNode *, std::pair<double, double>> Calls;
+    for (auto CallerSCC : CCG.sccCallers(SCC)) {
+      Reaching[CallerSCC] = true;
+    }
 
-    std::set<BasicBlock *> Seen;
-    for (auto &Edge : *CurrentNode) {
-      auto &Call = Edge.first;
-      auto *CallerNode = Edge.second;
-      if (!Call) {
-        continue;
+    auto Members = CCG.sccMembers(SCC);
+    if (Members.size() > 1) {
+      for (auto Id : Members) {
+        if (Distances[Id] != UnreachableDistance) {
+          Queue.emplace(Distances[Id], Id);
+        }
       }
-      Calls[CallerNode].first++;
 
-      auto *CB = cast<CallBase>(*Call);
-      auto *BB = CB->getParent();
-      if (Seen.find(BB) == Seen.end()) {
-        Calls[CallerNode].second++;
-        Seen.insert(BB);
+      while (!Queue.empty()) {
+        auto CurrentDistance = Queue.top().first;
+        auto CurrentId = Queue.top().second;
+        Queue.pop();
+        if (CurrentDistance != Distances[CurrentId]) {
+          continue;
+        }
+
+        for (auto &Edge : Callers.callers(CurrentId)) {
+          if (CCG.getSCC(Edge.Caller) == SCC &&
+              Relax(Edge.Caller, CurrentDistance + Edge.Weight)) {
+            Queue.emplace(Distances[Edge.Caller], Edge.Caller);
+          }
+        }
       }
     }
 
-    for (auto &Entry : Calls) {
-      auto *CallerNode = Entry.first;
-      auto &CallerNodeCounts = Entry.second;
-
-      float CallSiteCoeff =
-          (2 * CallerNodeCounts.first + 1) / (2 * CallerNodeCounts.first);
-      float CallBBCoeff =
-          (2 * CallerNodeCounts.second + 1) / (2 * CallerNodeCounts.second);
-      float EdgeDistance = CallSiteCoeff * CallBBCoeff;
+    for (auto Id : Members) {
+      if (Distances[Id] == UnreachableDistance) {
+        continue;
+      }
+      for (auto &Edge : Callers.callers(Id)) {
+        if (CCG.getSCC(Edge.Caller) != SCC) {
+          Relax(Edge.Caller, Distances[Id] + Edge.Weight);
+        }
+      }
+    }
+  }
+}
 
-      Queue.emplace(CurrentDistance + EdgeDistance, CallerNode);
+// Hash of what the distance of a function depends on besides its callees: the
+// function itself, whether it is a target and its calls, including which calls
+// share a basic block for Hawkeye. Callees are referred to by name, node IDs
+// change whenever a function is added or removed.
+static uint64_t getLocalHash(const CompactCallGraph &CCG, unsigned int Id,
+                             bool IsTarget) {
+  SmallVector<char, 0> Buffer;
+  raw_svector_ostream OS(Buffer);
+  support::endian::Writer W(OS, support::little);
+
+  auto WriteName = [&](const Function &F) {
+    W.write<uint32_t>(F.getName().size());
+    OS << F.getName();
+  };
+
+  WriteName(*CCG.getFunction(Id));
+  W.write<uint8_t>(IsTarget);
+
+  // Calling blocks numbered by first call, which is stable across edits of
+  // blocks without calls.
+  DenseMap<const BasicBlock *, uint32_t> BlockNumbers;
+  auto Callees = CCG.callees(Id);
+  W.write<uint32_t>(Callees.size());
+  for (auto &Edge : Callees) {
+    WriteName(*CCG.getFunction(Edge.Node));
+    if (!Edge.Call) {
+      W.write<uint32_t>(~0U);
+      continue;
     }
+    auto *BB = Edge.Call->getParent();
+    W.write<uint32_t>(
+        BlockNumbers.try_emplace(BB, BlockNumbers.size()).first->second);
   }
 
-  return DistancesFromTarget;
+  return xxHash64(StringRef(Buffer.data(), Buffer.size()));
 }
 
-std::map<Function *, double>
-getAFLGoDistancesFromFunction(Function &TargetFunction,
-                              InvertedCallGraph &ICG) {
-  auto *TargetFunctionNode = ICG[&TargetFunction];
+// Cache keys of the distances of all functions. The distance of a function only
+// depends on the functions it can reach, so its key combines its own hash with
+// a hash of its call graph cone. Cone hashes are computed on the condensed
+// call graph, callees first, from the sorted hashes of the members of each SCC
+// and the cone hashes of the SCCs it calls. An edit thus only invalidates the
+// distances of the edited function and of its transitive callers.
+static std::vector<uint64_t> getCacheKeys(const CompactCallGraph &CCG,
+                                          const std::vector<bool> &IsTarget,
+                                          bool UseHawkeyeDistance) {
+  std::vector<uint64_t> LocalHashes(CCG.size());
+  for (unsigned int Id = 0; Id < CCG.size(); ++Id) {
+    LocalHashes[Id] = getLocalHash(CCG, Id, IsTarget[Id]);
+  }
+
+  SmallVector<char, 0> Buffer;
+  raw_svector_ostream OS(Buffer);
+  support::endian::Writer W(OS, support::little);
+
+  auto WriteSorted = [&W](SmallVectorImpl<uint64_t> &Hashes) {
+    llvm::sort(Hashes);
+    W.write<uint32_t>(Hashes.size());
+    for (auto Hash : Hashes) {
+      W.write<uint64_t>(Hash);
+    }
+  };
 
-  std::map<Function *, double> DistancesFromTarget;
-  for (auto BFIter = bf_begin(TargetFunctionNode);
-       BFIter != bf_end(TargetFunctionNode); ++BFIter) {
-    DistancesFromTarget[BFIter->getInner()->getFunction()] = BFIter.getLevel();
+  std::vector<uint64_t> ConeHashes(CCG.getNumSCCs());
+  SmallVector<uint64_t, 16> Hashes;
+  for (unsigned int SCC = 0; SCC < CCG.getNumSCCs(); ++SCC) {
+    Buffer.clear();
+
+    Hashes.clear();
+    for (auto Id : CCG.sccMembers(SCC)) {
+      Hashes.push_back(LocalHashes[Id]);
+    }
+    WriteSorted(Hashes);
+
+    Hashes.clear();
+    for (auto CalleeSCC : CCG.sccCallees(SCC)) {
+      Hashes.push_back(ConeHashes[CalleeSCC]);
+    }
+    WriteSorted(Hashes);
+
+    ConeHashes[SCC] = xxHash64(StringRef(Buffer.data(), Buffer.size()));
   }
 
-  return DistancesFromTarget;
+  std::vector<uint64_t> Keys(CCG.size());
+  for (unsigned int Id = 0; Id < CCG.size(); ++Id) {
+    Buffer.clear();
+    W.write<uint8_t>(UseHawkeyeDistance);
+    W.write<uint64_t>(LocalHashes[Id]);
+    W.write<uint64_t>(ConeHashes[CCG.getSCC(Id)]);
+    Keys[Id] = xxHash64(StringRef(Buffer.data(), Buffer.size()));
+  }
+
+  return Keys;
 }
 
 AnalysisKey AFLGoFunctionDistanceAnalysis::Key;
 
 AFLGoFunctionDistanceAnalysis::Result
 AFLGoFunctionDistanceAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  auto &Imported = MAM.getResult<DistanceFileAnalysis>(M);
+  if (Imported) {
+    return Imported->Functions;
+  }
+
   FunctionAnalysisManager &FAM =
       MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
 
-  CallGraph *CG = nullptr;
-  if (!UseExtendedCG) {
-    CG = &MAM.getResult<CallGraphAnalysis>(M);
-  } else {
-    CG = &MAM.getResult<ExtendedCallGraphAnalysis>(M);
-  }
-
-  InvertedCallGraph ICG{*CG};
+  auto &CCG = MAM.getResult<CompactCallGraphAnalysis>(M);
 
-  std::map<Function *, std::vector<double>> DistancesFromTargets;
+  SmallVector<unsigned int, 16> Targets;
+  std::vector<bool> IsTarget(CCG.size(), false);
   for (auto &F : M) {
-    auto Targets = FAM.getResult<AFLGoTargetDetectionAnalysis>(F);
-    if (Targets.BBs.empty()) {
-      // F is not a target.
-      continue;
+    auto &FTargets = FAM.getResult<AFLGoTargetDetectionAnalysis>(F);
+    if (!FTargets.BBs.empty()) {
+      Targets.push_back(CCG.getId(F));
+      IsTarget[Targets.back()] = true;
     }
+  }
 
-    std::map<Function *, double> Distances;
-    if (!UseHawkeyeDistance) {
-      Distances = getAFLGoDistancesFromFunction(F, ICG);
-    } else {
-      Distances = getHawkeyeDistancesFromFunction(F, ICG);
+  // Distances of functions with a cache hit; declarations are never reachable,
+  // so they are not looked up.
+  auto &Cache = MAM.getResult<DistanceCacheAnalysis>(M);
+  std::vector<uint64_t> CacheKeys;
+  DistanceVector CachedDistances(CCG.size(), UnreachableDistance);
+  std::vector<bool> Cached(CCG.size(), false);
+  if (Cache) {
+    CacheKeys = getCacheKeys(CCG, IsTarget, UseHawkeyeDistance);
+
+    for (unsigned int Id = 0; Id < CCG.size(); ++Id) {
+      Cached[Id] = CCG.getFunction(Id)->isDeclaration() ||
+                   Cache->lookupFunctionDistance(CacheKeys[Id],
+                                                 CachedDistances[Id]);
     }
 
-    for (auto &DistanceEntry : Distances) {
-      DistancesFromTargets[DistanceEntry.first].push_back(DistanceEntry.second);
+    // Only the targets in the cones of functions without a cached distance
+    // are searched from. SCCs are visited callers first to mark the cones.
+    std::vector<bool> InCone(CCG.getNumSCCs(), false);
+    for (auto SCC = CCG.getNumSCCs(); SCC-- > 0;) {
+      for (auto Id : CCG.sccMembers(SCC)) {
+        InCone[SCC] = InCone[SCC] || !Cached[Id];
+      }
+      if (InCone[SCC]) {
+        for (auto CalleeSCC : CCG.sccCallees(SCC)) {
+          InCone[CalleeSCC] = true;
+        }
+      }
     }
+    llvm::erase_if(Targets, [&](unsigned int TargetId) {
+      return !InCone[CCG.getSCC(TargetId)];
+    });
   }
 
-  auto DistanceMap = DenseMap<Function *, double>();
-  for (auto &DistancesFromTargetPair : DistancesFromTargets) {
-    auto *Function = DistancesFromTargetPair.first;
-    if (!Function)
-      continue;
+  WeightedCallers Callers(CCG, UseHawkeyeDistance);
+  auto GetDistances = [&CCG, &Callers](unsigned int TargetId,
+                                       DistanceVector &Distances) {
+    getDistancesFromFunction(TargetId, CCG, Callers, Distances);
+  };
+
+  // The harmonic mean of the distances from all targets is accumulated online
+  // as a sum of reciprocals and a count.
+  std::vector<double> ReciprocalSums(CCG.size(), 0.0);
+  std::vector<unsigned int> Counts(CCG.size(), 0);
+  auto Accumulate = [&ReciprocalSums,
+                     &Counts](const DistanceVector &Distances) {
+    for (unsigned int Id = 0; Id < Distances.size(); ++Id) {
+      if (Distances[Id] != UnreachableDistance) {
+        ReciprocalSums[Id] += 1.0 / Distances[Id];
+        ++Counts[Id];
+      }
+    }
+  };
 
-    auto &Distances = DistancesFromTargetPair.second;
+  if (Threads == 1) {
+    DistanceVector Distances;
+    for (auto Target : Targets) {
+      GetDistances(Target, Distances);
+      Accumulate(Distances);
+    }
+  } else {
+    ThreadPool Pool(hardware_concurrency(Threads));
+    auto BatchSize = Pool.getThreadCount();
+
+    std::vector<DistanceVector> Batch(BatchSize);
+    for (size_t Begin = 0; Begin < Targets.size(); Begin += BatchSize) {
+      auto End = std::min(Begin + BatchSize, Targets.size());
+      for (auto Idx = Begin; Idx < End; ++Idx) {
+        Pool.async([&, Idx, Begin] {
+          GetDistances(Targets[Idx], Batch[Idx - Begin]);
+        });
+      }
+      Pool.wait();
 
-    double HarmonicMean = 0;
-    for (auto Distance : Distances) {
-      HarmonicMean += 1.0 / Distance;
+      // Always sum in target order, so that the result does not depend on
+      // scheduling.
+      for (auto Idx = Begin; Idx < End; ++Idx) {
+        Accumulate(Batch[Idx - Begin]);
+      }
     }
-    HarmonicMean = Distances.size() / HarmonicMean;
+  }
 
-    DistanceMap[Function] = HarmonicMean;
+  // A function without a cached distance can only reach the targets that were
+  // searched from, so its sums are the same as with all the targets.
+  auto DistanceMap = DenseMap<Function *, double>();
+  for (unsigned int Id = 0; Id < CCG.size(); ++Id) {
+    auto Distance = CachedDistances[Id];
+    if (!Cached[Id]) {
+      if (Counts[Id] > 0) {
+        Distance = Counts[Id] / ReciprocalSums[Id];
+      }
+      if (Cache) {
+        Cache->storeFunctionDistance(CacheKeys[Id], Distance);
+      }
+    }
+
+    if (Distance != UnreachableDistance) {
+      DistanceMap[CCG.getFunction(Id)] = Distance;
+    }
   }
 
   return DistanceMap;
-}
\ No newline at end of file
+}
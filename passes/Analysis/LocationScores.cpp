@@ -0,0 +1,125 @@
+#include <Analysis/LocationScores.hpp>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/BinaryByteStream.h>
+#include <llvm/Support/BinaryStreamReader.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/FormatVariadic.h>
+
+using namespace llvm;
+
+namespace {
+
+// On-disk layout of a record, see LocationScores.hpp
+struct PackedRecord {
+  support::ulittle32_t File;
+  support::ulittle32_t Line;
+  support::ulittle64_t Value;
+};
+
+static_assert(sizeof(PackedRecord) == 16, "unexpected record padding");
+
+} // namespace
+
+void LocationScoresWriter::add(unsigned int Table, StringRef File,
+                               uint32_t Line, uint64_t Value) {
+  auto Inserted = FileIndices.insert({File, Files.size()});
+  if (Inserted.second) {
+    Files.push_back(Inserted.first->getKey());
+  }
+
+  Tables[Table].push_back({Inserted.first->getValue(), Line, Value});
+}
+
+void LocationScoresWriter::write(raw_ostream &OS, StringRef Magic) const {
+  assert(Magic.size() == 8 && "magic must be 8 bytes long");
+  OS << Magic;
+
+  support::endian::Writer W(OS, support::little);
+  W.write<uint32_t>(Files.size());
+  for (auto File : Files) {
+    W.write<uint32_t>(File.size());
+    OS << File;
+  }
+
+  W.write<uint32_t>(Tables.size());
+  for (const auto &Table : Tables) {
+    W.write<uint32_t>(Table.size());
+    for (const auto &Rec : Table) {
+      W.write<uint32_t>(Rec.File);
+      W.write<uint32_t>(Rec.Line);
+      W.write<uint64_t>(Rec.Value);
+    }
+  }
+}
+
+bool llvm::hasLocationScoresMagic(MemoryBufferRef Buffer, StringRef Magic) {
+  return Buffer.getBuffer().startswith(Magic);
+}
+
+Error llvm::readLocationScores(
+    MemoryBufferRef Buffer, StringRef Magic,
+    function_ref<void(unsigned int Table, const LocationScore &Score)>
+        Callback) {
+  BinaryByteStream Stream(arrayRefFromStringRef(Buffer.getBuffer()),
+                          support::little);
+  BinaryStreamReader Reader(Stream);
+
+  StringRef FileMagic;
+  if (auto Err = Reader.readFixedString(FileMagic, Magic.size())) {
+    return Err;
+  }
+  if (FileMagic != Magic) {
+    return createStringError(inconvertibleErrorCode(),
+                             formatv("unexpected magic '{0}'", FileMagic));
+  }
+
+  uint32_t NumFiles;
+  if (auto Err = Reader.readInteger(NumFiles)) {
+    return Err;
+  }
+
+  std::vector<StringRef> Files;
+  for (uint32_t FileIdx = 0; FileIdx < NumFiles; ++FileIdx) {
+    uint32_t PathLength;
+    StringRef Path;
+    if (auto Err = Reader.readInteger(PathLength)) {
+      return Err;
+    }
+    if (auto Err = Reader.readFixedString(Path, PathLength)) {
+      return Err;
+    }
+    Files.push_back(Path);
+  }
+
+  uint32_t NumTables;
+  if (auto Err = Reader.readInteger(NumTables)) {
+    return Err;
+  }
+
+  for (uint32_t Table = 0; Table < NumTables; ++Table) {
+    uint32_t NumRecords;
+    if (auto Err = Reader.readInteger(NumRecords)) {
+      return Err;
+    }
+
+    // Records are fixed-size, so they can be used in place.
+    ArrayRef<PackedRecord> Records;
+    if (auto Err = Reader.readArray(Records, NumRecords)) {
+      return Err;
+    }
+
+    for (const auto &Rec : Records) {
+      if (Rec.File >= Files.size()) {
+        return createStringError(
+            inconvertibleErrorCode(),
+            formatv("invalid file index {0}", uint32_t(Rec.File)));
+      }
+
+      Callback(Table, {Files[Rec.File], Rec.Line, Rec.Value});
+    }
+  }
+
+  return Error::success();
+}
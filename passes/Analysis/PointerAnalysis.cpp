@@ -0,0 +1,166 @@
+#include <Analysis/PointerAnalysis.hpp>
+
+#include "Graphs/SVFG.h"
+#include "MSSA/SVFGBuilder.h"
+#include "SVF-LLVM/LLVMModule.h"
+#include "SVF-LLVM/SVFIRBuilder.h"
+#include "SVFIR/SVFIR.h"
+#include "Util/Options.h"
+#include "WPA/Andersen.h"
+
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+using namespace llvm;
+
+AnalysisKey SVFPointerAnalysis::Key;
+
+namespace {
+
+// A file in the cache directory, read and written by SVF itself through a pair
+// of its options. Entries are written to a temporary file and moved in place
+// once complete, so that concurrent links never read partial entries.
+class SVFCacheEntry {
+  std::string Path;
+  std::string TmpPath;
+  Option<std::string> &ReadOption;
+  Option<std::string> &WriteOption;
+
+public:
+  SVFCacheEntry(std::string Path, const Option<std::string> &ReadOption,
+                const Option<std::string> &WriteOption)
+      : Path(Path), ReadOption(const_cast<Option<std::string> &>(ReadOption)),
+        WriteOption(const_cast<Option<std::string> &>(WriteOption)) {
+    if (sys::fs::exists(Path)) {
+      errs() << "[AFLGo] reading SVF results from " << Path << '\n';
+      this->ReadOption.setValue(Path);
+      return;
+    }
+
+    TmpPath = formatv("{0}.tmp{1}", Path, sys::Process::getProcessId());
+    this->WriteOption.setValue(TmpPath);
+  }
+
+  ~SVFCacheEntry() {
+    ReadOption.setValue("");
+    WriteOption.setValue("");
+
+    if (TmpPath.empty()) {
+      return;
+    }
+
+    if (auto EC = sys::fs::rename(TmpPath, Path)) {
+      errs() << "[AFLGo] can't store SVF results in " << Path << ": "
+             << EC.message() << '\n';
+      sys::fs::remove(TmpPath);
+    }
+  }
+
+  bool isHit() const { return TmpPath.empty(); }
+};
+
+} // namespace
+
+static std::string getCacheKey(const Module &M) {
+  SmallVector<char, 0> Bitcode;
+  raw_svector_ostream OS(Bitcode);
+  WriteBitcodeToFile(M, OS);
+  auto Hash = xxHash64(StringRef(Bitcode.data(), Bitcode.size()));
+  return formatv("{0:x-16}", Hash);
+}
+
+SVFPointerAnalysis::Result::Result(SVF::LLVMModuleSet *ModuleSet,
+                                   SVF::SVFIR *PAG,
+                                   SVF::AndersenWaveDiff *Andersen,
+                                   std::string SVFGCachePath)
+    : ModuleSet(ModuleSet), PAG(PAG), Andersen(Andersen),
+      SVFGCachePath(SVFGCachePath) {}
+
+SVFPointerAnalysis::Result::Result(Result &&Other)
+    : ModuleSet(Other.ModuleSet), PAG(Other.PAG), Andersen(Other.Andersen),
+      SVFGBuilder(std::move(Other.SVFGBuilder)), SVFG(Other.SVFG),
+      SVFGCachePath(std::move(Other.SVFGCachePath)) {
+  Other.ModuleSet = nullptr;
+}
+
+SVFPointerAnalysis::Result::~Result() {
+  if (!ModuleSet) {
+    // moved from
+    return;
+  }
+
+  SVFGBuilder.reset();
+  SVF::AndersenWaveDiff::releaseAndersenWaveDiff();
+  SVF::SVFIR::releaseSVFIR();
+  SVF::LLVMModuleSet::releaseLLVMModuleSet();
+}
+
+SVF::SVFG &SVFPointerAnalysis::Result::getSVFG() {
+  if (SVFG) {
+    return *SVFG;
+  }
+
+  Optional<SVFCacheEntry> CacheEntry;
+  if (!SVFGCachePath.empty()) {
+    CacheEntry.emplace(SVFGCachePath, SVF::Options::ReadSVFG,
+                       SVF::Options::WriteSVFG);
+  }
+
+  // updateCallGraph() is called in buildFullSVFG()->build() if true is
+  // passed to SVFGBuilder constructor
+  SVFGBuilder = std::make_unique<SVF::SVFGBuilder>(true);
+  SVFG = SVFGBuilder->buildFullSVFG(Andersen);
+
+  return *SVFG;
+}
+
+SVFPointerAnalysis::Result SVFPointerAnalysis::run(Module &M,
+                                                   ModuleAnalysisManager &) {
+  // There is no other way to control printing inside SVF.
+  auto &PrintOption = const_cast<Option<bool> &>(SVF::Options::PStat);
+  PrintOption.setValue(Verbose);
+
+  std::string CachePrefix;
+  if (!CacheDir.empty()) {
+    if (auto EC = sys::fs::create_directories(CacheDir)) {
+      auto ErrorMessage =
+          formatv("can't create SVF cache directory '{0}': {1}", CacheDir,
+                  EC.message());
+      report_fatal_error(ErrorMessage);
+    }
+
+    auto Prefix = SmallString<128>(CacheDir);
+    sys::path::append(Prefix, getCacheKey(M));
+    CachePrefix = Prefix.str();
+  }
+
+  // The PAG is needed to map the cached results back to the module, so it is
+  // always built.
+  auto *LLVMModuleSet = SVF::LLVMModuleSet::getLLVMModuleSet();
+  auto *SVFModule = LLVMModuleSet->buildSVFModule(M);
+
+  SVF::SVFIRBuilder Builder(SVFModule);
+  auto *PAG = Builder.build();
+
+  if (CachePrefix.empty()) {
+    auto *Andersen = SVF::AndersenWaveDiff::createAndersenWaveDiff(PAG);
+    return Result(LLVMModuleSet, PAG, Andersen, "");
+  }
+
+  SVFCacheEntry CacheEntry(CachePrefix + ".ander", SVF::Options::ReadAnder,
+                           SVF::Options::WriteAnder);
+  auto *Andersen = SVF::AndersenWaveDiff::createAndersenWaveDiff(PAG);
+  if (CacheEntry.isHit()) {
+    // Only points-to sets are stored, resolve indirect calls with them.
+    Andersen->updateCallGraph(Andersen->getIndirectCallsites());
+  }
+
+  return Result(LLVMModuleSet, PAG, Andersen, CachePrefix + ".svfg");
+}
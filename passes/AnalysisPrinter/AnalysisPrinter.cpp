@@ -1,10 +1,16 @@
 #include <Analysis/BasicBlockDistance.hpp>
+#include <Analysis/CompactCallGraph.hpp>
 #include <Analysis/DAFL.hpp>
+#include <Analysis/DistanceCache.hpp>
+#include <Analysis/DistanceFile.hpp>
 #include <Analysis/ExtendedCallGraph.hpp>
 #include <Analysis/FunctionDistance.hpp>
+#include <Analysis/PointerAnalysis.hpp>
 #include <Analysis/TargetDetection.hpp>
 
+#include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/Analysis/CallGraph.h>
+#include <llvm/IR/InstIterator.h>
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Passes/PassPlugin.h>
 #include <llvm/Support/FormatVariadic.h>
@@ -18,11 +24,26 @@ static cl::opt<bool> ClExtendCG(
     cl::desc("Extend call graph with indirect edges through pointer analysis"),
     cl::init(false));
 
+static cl::opt<IndirectCallResolver> ClExtendCGResolver(
+    "extend-cg-resolver",
+    cl::desc("Resolver of indirect calls used to extend the call graph"),
+    cl::values(clEnumValN(IndirectCallResolver::Andersen, "andersen",
+                          "Andersen pointer analysis"),
+               clEnumValN(IndirectCallResolver::Type, "type",
+                          "Function signatures and class hierarchies")),
+    cl::init(IndirectCallResolver::Andersen));
+
 static cl::opt<bool>
     ClHawkeyeDistance("use-hawkeye-distance",
                       cl::desc("Use Hawkeye function distance definition"),
                       cl::init(false));
 
+static cl::opt<unsigned int> ClDistanceThreads(
+    "distance-threads",
+    cl::desc("Number of threads used to compute distances (0 uses all "
+             "available threads)"),
+    cl::init(1));
+
 static cl::opt<bool>
     ClDAFLDebug("dafl-debug",
                 cl::desc("Save debug files for DAFL instrumentation"),
@@ -85,7 +106,7 @@ public:
   explicit AFLGoBasicBlockDistancePrinterPass(raw_ostream &OS) : OS(OS) {}
 
   PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM) {
-    auto BBDistanceResult = MAM.getResult<AFLGoBasicBlockDistanceAnalysis>(M);
+    auto &BBDistanceResult = MAM.getResult<AFLGoBasicBlockDistanceAnalysis>(M);
 
     OS << "function_name,basic_block_name,distance\n";
     for (auto &F : M) {
@@ -133,6 +154,77 @@ public:
   }
 };
 
+class ExtendedCallGraphStatsPrinterPass
+    : public PassInfoMixin<ExtendedCallGraphStatsPrinterPass> {
+  raw_ostream &OS;
+
+public:
+  explicit ExtendedCallGraphStatsPrinterPass(raw_ostream &OS) : OS(OS) {}
+
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM) {
+    unsigned int IndirectCalls = 0;
+    for (auto &F : M) {
+      for (auto &I : instructions(F)) {
+        auto *CB = dyn_cast<CallBase>(&I);
+        if (CB && CB->isIndirectCall()) {
+          ++IndirectCalls;
+        }
+      }
+    }
+
+    OS << "resolver,indirect_calls,resolved_calls,indirect_edges\n";
+    for (auto Resolver :
+         {IndirectCallResolver::Andersen, IndirectCallResolver::Type}) {
+      auto CG = ExtendedCallGraphAnalysis(Resolver).run(M, MAM);
+
+      SmallPtrSet<const CallBase *, 32> ResolvedCalls;
+      unsigned int IndirectEdges = 0;
+      for (auto &CGEntry : CG) {
+        for (auto &CallRecord : *CGEntry.second) {
+          if (!CallRecord.first || !CallRecord.second->getFunction()) {
+            continue;
+          }
+
+          auto *CB = dyn_cast_or_null<CallBase>(*CallRecord.first);
+          if (CB && CB->isIndirectCall()) {
+            ResolvedCalls.insert(CB);
+            ++IndirectEdges;
+          }
+        }
+      }
+
+      auto *Name = Resolver == IndirectCallResolver::Andersen ? "andersen"
+                                                               : "type";
+      OS << formatv("{0},{1},{2},{3}\n", Name, IndirectCalls,
+                    ResolvedCalls.size(), IndirectEdges);
+    }
+
+    return PreservedAnalyses::all();
+  }
+};
+
+class CompactCallGraphPrinterPass
+    : public PassInfoMixin<CompactCallGraphPrinterPass> {
+  raw_ostream &OS;
+
+public:
+  explicit CompactCallGraphPrinterPass(raw_ostream &OS) : OS(OS) {}
+
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM) {
+    auto &CCG = MAM.getResult<CompactCallGraphAnalysis>(M);
+
+    OS << "function_name,scc,scc_size,callees,callers\n";
+    for (unsigned int Id = 0; Id < CCG.size(); ++Id) {
+      auto SCC = CCG.getSCC(Id);
+      OS << formatv("{0},{1},{2},{3},{4}\n", CCG.getFunction(Id)->getName(),
+                    SCC, CCG.sccMembers(SCC).size(), CCG.callees(Id).size(),
+                    CCG.callers(Id).size());
+    }
+
+    return PreservedAnalyses::all();
+  }
+};
+
 llvm::PassPluginLibraryInfo getAFLGoAnalysisPrinterPluginInfo() {
   return {
       LLVM_PLUGIN_API_VERSION, "AFLGoAnalysisPrinter", LLVM_VERSION_STRING,
@@ -143,12 +235,19 @@ llvm::PassPluginLibraryInfo getAFLGoAnalysisPrinterPluginInfo() {
             });
 
         PB.registerAnalysisRegistrationCallback([](ModuleAnalysisManager &MAM) {
-          MAM.registerPass([] { return ExtendedCallGraphAnalysis(); });
           MAM.registerPass([] {
-            return AFLGoFunctionDistanceAnalysis(ClExtendCG, ClHawkeyeDistance);
+            return SVFPointerAnalysis(ClDAFLVerbose || ClDAFLDebug);
           });
           MAM.registerPass(
-              [] { return AFLGoBasicBlockDistanceAnalysis(ClExtendCG); });
+              [] { return ExtendedCallGraphAnalysis(ClExtendCGResolver); });
+          MAM.registerPass([] { return CompactCallGraphAnalysis(ClExtendCG); });
+          MAM.registerPass([] { return DistanceCacheAnalysis(); });
+          MAM.registerPass([] { return DistanceFileAnalysis(); });
+          MAM.registerPass([] {
+            return AFLGoFunctionDistanceAnalysis(ClHawkeyeDistance,
+                                                 ClDistanceThreads);
+          });
+          MAM.registerPass([] { return AFLGoBasicBlockDistanceAnalysis(); });
           MAM.registerPass([] {
             return DAFLAnalysis("", false, ClDAFLDebug, ClDAFLVerbose);
           });
@@ -172,6 +271,16 @@ llvm::PassPluginLibraryInfo getAFLGoAnalysisPrinterPluginInfo() {
                 return true;
               }
 
+              if (Name == "print-compact-call-graph") {
+                MPM.addPass(CompactCallGraphPrinterPass(dbgs()));
+                return true;
+              }
+
+              if (Name == "print-extended-call-graph-stats") {
+                MPM.addPass(ExtendedCallGraphStatsPrinterPass(dbgs()));
+                return true;
+              }
+
               if (Name == "print-dafl-proximity") {
                 MPM.addPass(DAFLProximityPrinterPass(dbgs()));
                 return true;
@@ -0,0 +1,32 @@
+; RUN: %opt_printer -passes='print-compact-call-graph' -disable-output 2>&1 %s | %FileCheck %s
+
+; CHECK: function_name,scc,scc_size,callees,callers
+; CHECK-NEXT: main,1,1,1,0
+; CHECK-NEXT: even,0,2,1,2
+; CHECK-NEXT: odd,0,2,1,1
+; CHECK-NEXT: unused,3,1,1,0
+; CHECK-NEXT: external,2,1,0,1
+
+define dso_local i32 @main() {
+  call void @even(i32 10)
+  ret i32 0
+}
+
+define dso_local void @even(i32 %n) {
+  %dec = sub i32 %n, 1
+  call void @odd(i32 %dec)
+  ret void
+}
+
+define dso_local void @odd(i32 %n) {
+  %dec = sub i32 %n, 1
+  call void @even(i32 %dec)
+  ret void
+}
+
+define dso_local void @unused() {
+  call void @external()
+  ret void
+}
+
+declare void @external()
@@ -1,4 +1,42 @@
 ; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -S %s | %FileCheck %s
+; RUN: rm -rf %t && mkdir -p %t
+; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -distance-cache-dir=%t -S %s 2>%t/first.log | %FileCheck %s
+; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -distance-cache-dir=%t -S %s 2>%t/second.log | %FileCheck %s
+; RUN: %FileCheck --check-prefix=CACHE %s < %t/second.log
+; RUN: sed 's/^declare void @__aflgo_trace_bb_target(i32)$/define void @unrelated() {\n  ret void\n}\n\n&/' %s > %t/edited.ll
+; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -distance-cache-dir=%t -disable-output %t/edited.ll 2>%t/edited.log
+; RUN: %FileCheck --check-prefix=CACHE-EDIT %s < %t/edited.log
+; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -distance-output-file=%t/distances.dst -S %s | %FileCheck %s
+; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -distance-input-file=%t/distances.dst -S %s | %FileCheck %s
+; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -inline-distance-probes -S %s | %FileCheck --check-prefix=INLINE %s
+; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -guard-weight-tables -S %s | %FileCheck --check-prefix=GUARD %s
+
+; CACHE: [AFLGo] distance cache: {{[1-9][0-9]*}} hits, 0 misses
+
+; A new function only misses its own function and basic block distances.
+; CACHE-EDIT: [AFLGo] distance cache: 4 hits, 2 misses
+
+; INLINE-DAG: @__aflgo_distance_stats = external global [2 x i64], align 8
+; INLINE-DAG: @llvm.global_ctors = appending global {{.+}} { i32 102, void ()* @aflgo.module_ctor_inline_probes
+; INLINE-NOT: @__aflgo_trace_bb_distance
+; INLINE-LABEL: @callee(
+; INLINE: [[SUM:%.+]] = load atomic i64, {{.+}} @__aflgo_distance_stats, {{.+}} monotonic, align 8
+; INLINE-NEXT: [[NEWSUM:%.+]] = add i64 [[SUM]], 1000
+; INLINE-NEXT: store atomic i64 [[NEWSUM]], {{.+}} @__aflgo_distance_stats, {{.+}} monotonic, align 8
+; INLINE-NEXT: [[COUNT:%.+]] = load atomic i64, {{.+}} @__aflgo_distance_stats, i64 0, i64 1) monotonic, align 8
+; INLINE-NEXT: [[NEWCOUNT:%.+]] = add i64 [[COUNT]], 1
+; INLINE-NEXT: store atomic i64 [[NEWCOUNT]], {{.+}} @__aflgo_distance_stats, i64 0, i64 1) monotonic, align 8
+; INLINE: define internal void @aflgo.module_ctor_inline_probes()
+; INLINE-NEXT: call void @__aflgo_register_inline_probes()
+
+; Blocks without a distance have weight -1, i.e., UINT64_MAX.
+; GUARD: @__aflgo_guard_tables = private constant [2 x {{.+}} @__sancov_gen_{{.*}}, i64 7 }, {{.+}} @__sancov_gen_{{.*}}, i64 6 }]
+; GUARD: @__aflgo_guard_weights = private constant [13 x i64] [i64 1000, i64 0, {{.*}}i64 12000, i64 11000, i64 10000,
+; GUARD: @llvm.global_ctors = appending global {{.+}} { i32 102, void ()* @aflgo.module_ctor_guard_weights
+; GUARD-NOT: @__aflgo_trace_bb_distance
+; GUARD-NOT: !aflgo.guard.weight
+; GUARD: define internal void @aflgo.module_ctor_guard_weights()
+; GUARD-NEXT: call void @__aflgo_register_guard_distances({{.+}} @__aflgo_guard_tables{{.*}}, i64 2, {{.+}} @__aflgo_guard_weights
 
 ; ModuleID = 'test.c'
 source_filename = "test.c"
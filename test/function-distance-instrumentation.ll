@@ -10,7 +10,7 @@ define dso_local void @target1() #0 !dbg !8 {
 ; CHECK: @target1
 ; CHECK-NEXT: call void @__sanitizer_cov_trace
 ; CHECK-NEXT: call void @__aflgo_trace_bb_distance(i64 0)
-; CHECK-NEXT: call void @__aflgo_trace_fun_distance(double 0.000000e+00)
+; CHECK-NEXT: call void @__aflgo_trace_fun_similarity(i64 -1)
 ; CHECK-NEXT: call void @__aflgo_trace_bb_target(i32 0)
   call void @__aflgo_trace_bb_target(i32 0)
   ret void, !dbg !12, !annotation !22
@@ -21,7 +21,7 @@ define dso_local void @target2() #0 !dbg !13 {
 ; CHECK: @target2
 ; CHECK-NEXT: call void @__sanitizer_cov_trace
 ; CHECK-NEXT: call void @__aflgo_trace_bb_distance(i64 0)
-; CHECK-NEXT: call void @__aflgo_trace_fun_distance(double 0.000000e+00)
+; CHECK-NEXT: call void @__aflgo_trace_fun_similarity(i64 -1)
 ; CHECK-NEXT: call void @__aflgo_trace_bb_target(i32 1)
   call void @__aflgo_trace_bb_target(i32 0)
   ret void, !dbg !14, !annotation !22
@@ -32,7 +32,7 @@ define dso_local void @caller1() #0 !dbg !15 {
 ; CHECK: @caller1
 ; CHECK-NEXT: call void @__sanitizer_cov_trace
 ; CHECK-NEXT: call void @__aflgo_trace_bb_distance(i64 10000)
-; CHECK-NEXT: call void @__aflgo_trace_fun_distance(double 1.000000e+00)
+; CHECK-NEXT: call void @__aflgo_trace_fun_similarity(i64 1000)
   call void @target1(), !dbg !16
   ret void, !dbg !17
 }
@@ -42,7 +42,7 @@ define dso_local void @caller2() #0 !dbg !18 {
 ; CHECK: @caller2
 ; CHECK-NEXT: call void @__sanitizer_cov_trace
 ; CHECK-NEXT: call void @__aflgo_trace_bb_distance(i64 10000)
-; CHECK-NEXT: call void @__aflgo_trace_fun_distance(double 0x3FF5555555555555)
+; CHECK-NEXT: call void @__aflgo_trace_fun_similarity(i64 750)
   call void @caller1(), !dbg !19
   call void @target2(), !dbg !20
   ret void, !dbg !21
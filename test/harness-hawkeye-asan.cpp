@@ -28,7 +28,7 @@ int B::getVal() {
 // CHECK-NEXT: {{.*}} = alloca
 // CHECK-DAG: call void @__sanitizer_cov_trace_pc_guard
 // CHECK-DAG: call void @__aflgo_trace_bb_distance(i64 0)
-// CHECK-DAG: call void @__aflgo_trace_fun_distance(double 0.000000e+00)
+// CHECK-DAG: call void @__aflgo_trace_fun_similarity(i64 -1)
 // CHECK: ret i32
     return 42;
   }
@@ -39,7 +39,7 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
 // CHECK-NEXT-4: {{.*}} = alloca
 // CHECK-DAG: call void @__sanitizer_cov_trace_pc_guard
 // CHECK-DAG: call void @__aflgo_trace_bb_distance(i64 15000)
-// CHECK-DAG: call void @__aflgo_trace_fun_distance(double 2.250000e+00)
+// CHECK-DAG: call void @__aflgo_trace_fun_similarity(i64 444)
 
   int V = 0;
 // CHECK: call void @__sanitizer_cov_trace_const_cmp4(i32 0, i32 {{.+}})
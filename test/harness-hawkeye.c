@@ -10,7 +10,7 @@
 int target1(void) {
 // CHECK-NEXT: entry:
 // CHECK-DAG: call void @__aflgo_trace_bb_distance(i64 0)
-// CHECK-DAG: call void @__aflgo_trace_fun_distance(double 0.000000e+00)
+// CHECK-DAG: call void @__aflgo_trace_fun_similarity(i64 -1)
 // CHECK-DAG: call void @__sanitizer_cov_trace_pc_guard
 	return 1;
 }
@@ -19,7 +19,7 @@ int target1(void) {
 int target2(int X) {
 // CHECK-NEXT: entry:
 // CHECK-DAG: call void @__aflgo_trace_bb_distance(i64 0)
-// CHECK-DAG: call void @__aflgo_trace_fun_distance(double 0.000000e+00)
+// CHECK-DAG: call void @__aflgo_trace_fun_similarity(i64 -1)
 // CHECK-DAG: call void @__sanitizer_cov_trace_pc_guard
 	return X + 2;
 }
@@ -28,7 +28,7 @@ int target2(int X) {
 int intermediate2(void) {
 // CHECK-NEXT: entry:
 // CHECK-DAG: call void @__aflgo_trace_bb_distance(i64 10000)
-// CHECK-DAG: call void @__aflgo_trace_fun_distance(double 2.250000e+00)
+// CHECK-DAG: call void @__aflgo_trace_fun_similarity(i64 444)
 // CHECK-DAG: call void @__sanitizer_cov_trace_pc_guard
 	return target2(1337);
 }
@@ -38,7 +38,7 @@ int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
 // CHECK-NEXT: entry:
 // CHECK-COUNT-4: {{.*}} = alloca
 // CHECK-DAG: call void @__aflgo_trace_bb_distance(i64 12000)
-// CHECK-DAG: call void @__aflgo_trace_fun_distance(double 3.000000e+00)
+// CHECK-DAG: call void @__aflgo_trace_fun_similarity(i64 333)
 // CHECK-DAG: call void @__sanitizer_cov_trace_pc_guard
   typedef int (*val_cb)(void);
 
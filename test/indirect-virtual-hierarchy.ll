@@ -0,0 +1,103 @@
+; RUN: %opt_printer -passes='print-aflgo-function-distance' -extend-cg -extend-cg-resolver=type -disable-output 2>&1 %s | %FileCheck %s
+;
+; Virtual calls only reach the classes derived from the class of the object,
+; following the base classes recorded in the RTTI. Other::get is in the same
+; vtable slot with the same signature as Sub::get, but Other does not derive
+; from Base, so a call through Base does not reach the target through it.
+
+; CHECK: function_name,distance
+
+; ModuleID = 'hierarchy.cpp'
+source_filename = "hierarchy.cpp"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+%class.Base = type { i32 (...)** }
+%class.Sub = type { %class.Base }
+%class.Other = type { i32 (...)** }
+
+@_ZTVN10__cxxabiv117__class_type_infoE = external global i8*
+@_ZTVN10__cxxabiv120__si_class_type_infoE = external global i8*
+@_ZTS4Base = linkonce_odr dso_local constant [6 x i8] c"4Base\00", align 1
+@_ZTI4Base = linkonce_odr dso_local constant { i8*, i8* } { i8* bitcast (i8** getelementptr inbounds (i8*, i8** @_ZTVN10__cxxabiv117__class_type_infoE, i64 2) to i8*), i8* getelementptr inbounds ([6 x i8], [6 x i8]* @_ZTS4Base, i32 0, i32 0) }, align 8
+@_ZTS3Sub = linkonce_odr dso_local constant [5 x i8] c"3Sub\00", align 1
+@_ZTI3Sub = linkonce_odr dso_local constant { i8*, i8*, i8* } { i8* bitcast (i8** getelementptr inbounds (i8*, i8** @_ZTVN10__cxxabiv120__si_class_type_infoE, i64 2) to i8*), i8* getelementptr inbounds ([5 x i8], [5 x i8]* @_ZTS3Sub, i32 0, i32 0), i8* bitcast ({ i8*, i8* }* @_ZTI4Base to i8*) }, align 8
+@_ZTS5Other = linkonce_odr dso_local constant [7 x i8] c"5Other\00", align 1
+@_ZTI5Other = linkonce_odr dso_local constant { i8*, i8* } { i8* bitcast (i8** getelementptr inbounds (i8*, i8** @_ZTVN10__cxxabiv117__class_type_infoE, i64 2) to i8*), i8* getelementptr inbounds ([7 x i8], [7 x i8]* @_ZTS5Other, i32 0, i32 0) }, align 8
+@_ZTV4Base = linkonce_odr dso_local unnamed_addr constant { [3 x i8*] } { [3 x i8*] [i8* null, i8* bitcast ({ i8*, i8* }* @_ZTI4Base to i8*), i8* bitcast (void ()* @__cxa_pure_virtual to i8*)] }, align 8
+@_ZTV3Sub = linkonce_odr dso_local unnamed_addr constant { [3 x i8*] } { [3 x i8*] [i8* null, i8* bitcast ({ i8*, i8*, i8* }* @_ZTI3Sub to i8*), i8* bitcast (i32 (%class.Sub*, i32)* @_ZN3Sub3getEi to i8*)] }, align 8
+@_ZTV5Other = linkonce_odr dso_local unnamed_addr constant { [3 x i8*] } { [3 x i8*] [i8* null, i8* bitcast ({ i8*, i8* }* @_ZTI5Other to i8*), i8* bitcast (i32 (%class.Other*, i32)* @_ZN5Other3getEi to i8*)] }, align 8
+
+; CHECK-DAG: _Z6targeti,0.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local noundef i32 @_Z6targeti(i32 noundef %X) #0 {
+entry:
+  call void @__aflgo_trace_bb_target(i32 0)
+  ret i32 %X, !annotation !6
+}
+
+; CHECK-DAG: _Z4stepi,1.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local noundef i32 @_Z4stepi(i32 noundef %X) #0 {
+entry:
+  %call = call noundef i32 @_Z6targeti(i32 noundef %X)
+  ret i32 %call
+}
+
+; CHECK-DAG: _Z8call_getP4Basei,3.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local noundef i32 @_Z8call_getP4Basei(%class.Base* noundef %B, i32 noundef %X) #0 {
+entry:
+  %0 = bitcast %class.Base* %B to i32 (%class.Base*, i32)***
+  %vtable = load i32 (%class.Base*, i32)**, i32 (%class.Base*, i32)*** %0, align 8, !tbaa !7
+  %1 = load i32 (%class.Base*, i32)*, i32 (%class.Base*, i32)** %vtable, align 8
+  %call = call noundef i32 %1(%class.Base* noundef nonnull align 8 dereferenceable(8) %B, i32 noundef %X)
+  ret i32 %call
+}
+
+; CHECK-DAG: _Z9call_getoP5Otheri,2.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local noundef i32 @_Z9call_getoP5Otheri(%class.Other* noundef %O, i32 noundef %X) #0 {
+entry:
+  %0 = bitcast %class.Other* %O to i32 (%class.Other*, i32)***
+  %vtable = load i32 (%class.Other*, i32)**, i32 (%class.Other*, i32)*** %0, align 8, !tbaa !7
+  %1 = load i32 (%class.Other*, i32)*, i32 (%class.Other*, i32)** %vtable, align 8
+  %call = call noundef i32 %1(%class.Other* noundef nonnull align 8 dereferenceable(8) %O, i32 noundef %X)
+  ret i32 %call
+}
+
+; CHECK-DAG: _ZN3Sub3getEi,2.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define linkonce_odr dso_local noundef i32 @_ZN3Sub3getEi(%class.Sub* noundef nonnull align 8 dereferenceable(8) %this, i32 noundef %X) unnamed_addr #0 align 2 {
+entry:
+  %call = call noundef i32 @_Z4stepi(i32 noundef %X)
+  ret i32 %call
+}
+
+; CHECK-DAG: _ZN5Other3getEi,1.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define linkonce_odr dso_local noundef i32 @_ZN5Other3getEi(%class.Other* noundef nonnull align 8 dereferenceable(8) %this, i32 noundef %X) unnamed_addr #0 align 2 {
+entry:
+  %call = call noundef i32 @_Z6targeti(i32 noundef %X)
+  ret i32 %call
+}
+
+declare void @__aflgo_trace_bb_target(i32)
+
+declare void @__cxa_pure_virtual() unnamed_addr
+
+attributes #0 = { mustprogress noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+
+!llvm.module.flags = !{!0, !1, !2, !3, !4}
+!llvm.ident = !{!5}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{i32 7, !"PIC Level", i32 2}
+!2 = !{i32 7, !"PIE Level", i32 2}
+!3 = !{i32 7, !"uwtable", i32 2}
+!4 = !{i32 7, !"frame-pointer", i32 2}
+!5 = !{!"Ubuntu clang version 15.0.7"}
+!6 = !{!"libaflgo.target"}
+!7 = !{!8, !8, i64 0}
+!8 = !{!"vtable pointer", !9, i64 0}
+!9 = !{!"Simple C++ TBAA"}
@@ -0,0 +1,120 @@
+; RUN: %opt_printer -passes='print-aflgo-function-distance' -extend-cg -extend-cg-resolver=type -disable-output 2>&1 %s | %FileCheck %s
+; RUN: %opt_printer -passes='print-extended-call-graph-stats' -disable-output 2>&1 %s | %FileCheck %s --check-prefix=STATS
+;
+; Virtual calls only reach the functions in the called vtable slot. The target
+; is address-taken with the same signature as the virtual functions, so
+; resolving virtual calls by signature alone would make the callers of both
+; slots direct predecessors of the target, with distance 1.
+;
+; STATS: resolver,indirect_calls,resolved_calls,indirect_edges
+; STATS-DAG: type,2,2,4
+
+; CHECK: function_name,distance
+
+; ModuleID = 'virtual.cpp'
+source_filename = "virtual.cpp"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+%class.Base = type { i32 (...)** }
+%class.Sub1 = type { %class.Base }
+%class.Sub2 = type { %class.Base }
+
+@callback = dso_local global i32 (%class.Base*, i32)* @_Z6targetP4Basei, align 8
+@_ZTV4Base = linkonce_odr dso_local unnamed_addr constant { [4 x i8*] } { [4 x i8*] [i8* null, i8* null, i8* bitcast (void ()* @__cxa_pure_virtual to i8*), i8* bitcast (void ()* @__cxa_pure_virtual to i8*)] }, align 8
+@_ZTV4Sub1 = linkonce_odr dso_local unnamed_addr constant { [4 x i8*] } { [4 x i8*] [i8* null, i8* null, i8* bitcast (i32 (%class.Sub1*, i32)* @_ZN4Sub13getEi to i8*), i8* bitcast (i32 (%class.Sub1*, i32)* @_ZN4Sub15otherEi to i8*)] }, align 8
+@_ZTV4Sub2 = linkonce_odr dso_local unnamed_addr constant { [4 x i8*] } { [4 x i8*] [i8* null, i8* null, i8* bitcast (i32 (%class.Sub2*, i32)* @_ZN4Sub23getEi to i8*), i8* bitcast (i32 (%class.Sub2*, i32)* @_ZN4Sub25otherEi to i8*)] }, align 8
+
+; CHECK-DAG: _Z6targetP4Basei,0.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local noundef i32 @_Z6targetP4Basei(%class.Base* noundef %B, i32 noundef %X) #0 {
+entry:
+  call void @__aflgo_trace_bb_target(i32 0)
+  ret i32 %X, !annotation !6
+}
+
+; CHECK-DAG: _Z4stepP4Basei,1.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local noundef i32 @_Z4stepP4Basei(%class.Base* noundef %B, i32 noundef %X) #0 {
+entry:
+  %call = call noundef i32 @_Z6targetP4Basei(%class.Base* noundef %B, i32 noundef %X)
+  ret i32 %call
+}
+
+; Slot 0
+; CHECK-DAG: _Z8call_getP4Basei,3.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local noundef i32 @_Z8call_getP4Basei(%class.Base* noundef %B, i32 noundef %X) #0 {
+entry:
+  %0 = bitcast %class.Base* %B to i32 (%class.Base*, i32)***
+  %vtable = load i32 (%class.Base*, i32)**, i32 (%class.Base*, i32)*** %0, align 8, !tbaa !7
+  %1 = load i32 (%class.Base*, i32)*, i32 (%class.Base*, i32)** %vtable, align 8
+  %call = call noundef i32 %1(%class.Base* noundef nonnull align 8 dereferenceable(8) %B, i32 noundef %X)
+  ret i32 %call
+}
+
+; Slot 1
+; CHECK-DAG: _Z10call_otherP4Basei,2.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local noundef i32 @_Z10call_otherP4Basei(%class.Base* noundef %B, i32 noundef %X) #0 {
+entry:
+  %0 = bitcast %class.Base* %B to i32 (%class.Base*, i32)***
+  %vtable = load i32 (%class.Base*, i32)**, i32 (%class.Base*, i32)*** %0, align 8, !tbaa !7
+  %vfn = getelementptr inbounds i32 (%class.Base*, i32)*, i32 (%class.Base*, i32)** %vtable, i64 1
+  %1 = load i32 (%class.Base*, i32)*, i32 (%class.Base*, i32)** %vfn, align 8
+  %call = call noundef i32 %1(%class.Base* noundef nonnull align 8 dereferenceable(8) %B, i32 noundef %X)
+  ret i32 %call
+}
+
+; CHECK-DAG: _ZN4Sub13getEi,2.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define linkonce_odr dso_local noundef i32 @_ZN4Sub13getEi(%class.Sub1* noundef nonnull align 8 dereferenceable(8) %this, i32 noundef %X) unnamed_addr #0 align 2 {
+entry:
+  %0 = getelementptr inbounds %class.Sub1, %class.Sub1* %this, i32 0, i32 0
+  %call = call noundef i32 @_Z4stepP4Basei(%class.Base* noundef %0, i32 noundef %X)
+  ret i32 %call
+}
+
+; CHECK-DAG: _ZN4Sub15otherEi,1.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define linkonce_odr dso_local noundef i32 @_ZN4Sub15otherEi(%class.Sub1* noundef nonnull align 8 dereferenceable(8) %this, i32 noundef %X) unnamed_addr #0 align 2 {
+entry:
+  %0 = getelementptr inbounds %class.Sub1, %class.Sub1* %this, i32 0, i32 0
+  %call = call noundef i32 @_Z6targetP4Basei(%class.Base* noundef %0, i32 noundef %X)
+  ret i32 %call
+}
+
+; CHECK-DAG: _ZN4Sub23getEi,2.00
+; Function Attrs: mustprogress noinline nounwind uwtable
+define linkonce_odr dso_local noundef i32 @_ZN4Sub23getEi(%class.Sub2* noundef nonnull align 8 dereferenceable(8) %this, i32 noundef %X) unnamed_addr #0 align 2 {
+entry:
+  %0 = getelementptr inbounds %class.Sub2, %class.Sub2* %this, i32 0, i32 0
+  %call = call noundef i32 @_Z4stepP4Basei(%class.Base* noundef %0, i32 noundef %X)
+  ret i32 %call
+}
+
+; Function Attrs: mustprogress noinline nounwind uwtable
+define linkonce_odr dso_local noundef i32 @_ZN4Sub25otherEi(%class.Sub2* noundef nonnull align 8 dereferenceable(8) %this, i32 noundef %X) unnamed_addr #0 align 2 {
+entry:
+  ret i32 %X
+}
+
+declare void @__aflgo_trace_bb_target(i32)
+
+declare void @__cxa_pure_virtual() unnamed_addr
+
+attributes #0 = { mustprogress noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+
+!llvm.module.flags = !{!0, !1, !2, !3, !4}
+!llvm.ident = !{!5}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{i32 7, !"PIC Level", i32 2}
+!2 = !{i32 7, !"PIE Level", i32 2}
+!3 = !{i32 7, !"uwtable", i32 2}
+!4 = !{i32 7, !"frame-pointer", i32 2}
+!5 = !{!"Ubuntu clang version 15.0.7"}
+!6 = !{!"libaflgo.target"}
+!7 = !{!8, !8, i64 0}
+!8 = !{!"vtable pointer", !9, i64 0}
+!9 = !{!"Simple C++ TBAA"}
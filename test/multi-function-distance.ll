@@ -1,4 +1,5 @@
 ; RUN: %opt_printer -passes='print-aflgo-function-distance' -disable-output 2>&1 %s | %FileCheck %s
+; RUN: %opt_printer -passes='print-aflgo-function-distance' -distance-threads=4 -disable-output 2>&1 %s | %FileCheck %s
 
 ; CHECK: function_name,distance
 
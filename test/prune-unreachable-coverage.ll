@@ -0,0 +1,47 @@
+; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -prune-unreachable-coverage -S %s 2>%t.log | %FileCheck %s
+; RUN: %FileCheck --check-prefix=STATS %s < %t.log
+
+; STATS: [AFLGo] coverage pruned from 1 of 3 functions, 4 edges
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @target() {
+; CHECK-LABEL: @target(
+; CHECK: call void @__sanitizer_cov_trace_pc_guard
+entry:
+  call void @__aflgo_trace_bb_target(i32 0)
+  ret void, !annotation !0
+}
+
+define void @caller() {
+; CHECK-LABEL: @caller(
+; CHECK: call void @__sanitizer_cov_trace_pc_guard
+entry:
+  call void @target()
+  ret void
+}
+
+; Neither edges nor comparisons are traced. entry -> exit is critical, so
+; SanitizerCoverage would split it and instrument 4 edges.
+define i32 @unrelated(i32 %n) {
+; CHECK: define i32 @unrelated(i32 %n) #[[ATTR:[0-9]+]]
+; CHECK-NOT: call void @__sanitizer_cov
+; CHECK: ret i32
+entry:
+  %c = icmp sgt i32 %n, 0
+  br i1 %c, label %then, label %exit
+
+then:
+  br label %exit
+
+exit:
+  %r = phi i32 [ 1, %then ], [ 0, %entry ]
+  ret i32 %r
+}
+
+declare void @__aflgo_trace_bb_target(i32)
+
+; CHECK: attributes #[[ATTR]] = { nosanitize_coverage }
+
+!0 = !{!"libaflgo.target"}
@@ -0,0 +1,109 @@
+; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -sparse-distance-probes -S %s 2>%t.log | %FileCheck %s
+; RUN: %FileCheck --check-prefix=STATS %s < %t.log
+; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -sparse-distance-probes -inline-distance-probes -S %s | %FileCheck --check-prefix=INLINE %s
+
+; STATS: [AFLGo] sparse distance probes: 10 probes for 13 basic blocks
+
+; INLINE-LABEL: @chain(
+; INLINE: then:
+; INLINE: add i64 {{%.+}}, 21000
+; INLINE: add i64 {{%.+}}, 2
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @target(i32 %n) {
+; CHECK-LABEL: @target(
+; CHECK: call void @__aflgo_trace_bb_distance(i64 0)
+entry:
+  call void @__aflgo_trace_bb_target(i32 0)
+  %a = add i32 %n, 1, !annotation !0
+  ret i32 %a
+}
+
+; then and middle are control equivalent, entry is not.
+define i32 @chain(i32 %n) {
+; CHECK-LABEL: @chain(
+; CHECK: call void @__aflgo_trace_bb_distance(i64 12000)
+; CHECK: then:
+; CHECK: call void @__aflgo_trace_bb_distances(i64 21000, i64 2)
+; CHECK: middle:
+; CHECK-NOT: @__aflgo_trace_bb_distance
+; CHECK: join:
+entry:
+  %c = icmp sgt i32 %n, 0
+  br i1 %c, label %then, label %join
+
+then:
+  br label %middle
+
+middle:
+  %r = call i32 @target(i32 %n)
+  br label %join
+
+join:
+  ret i32 0
+}
+
+; body, middle and latch run once per iteration, then does not.
+define void @loop(i32 %n, i1 %x) {
+; CHECK-LABEL: @loop(
+; CHECK: call void @__aflgo_trace_bb_distance(i64 11000)
+; CHECK: body:
+; CHECK: call void @__aflgo_trace_bb_distances(i64 33000, i64 3)
+; CHECK: then:
+; CHECK: call void @__aflgo_trace_bb_distance(i64 13000)
+; CHECK: middle:
+; CHECK-NOT: @__aflgo_trace_bb_distance
+; CHECK: exit:
+entry:
+  br label %body
+
+body:
+  %i = phi i32 [ 0, %entry ], [ %inc, %latch ]
+  %r = call i32 @target(i32 %i)
+  br i1 %x, label %then, label %middle
+
+then:
+  br label %middle
+
+middle:
+  br label %latch
+
+latch:
+  %inc = add i32 %i, 1
+  %c = icmp slt i32 %inc, %n
+  br i1 %c, label %body, label %exit
+
+exit:
+  ret void
+}
+
+; x and y form an irreducible cycle, so y may run many times although it is
+; control equivalent to entry: every block gets its own probe.
+define void @irreducible(i1 %a, i1 %b) {
+; CHECK-LABEL: @irreducible(
+; CHECK: call void @__aflgo_trace_bb_distance(i64 12000)
+; CHECK: x:
+; CHECK: call void @__aflgo_trace_bb_distance(i64 12000)
+; CHECK: y:
+; CHECK: call void @__aflgo_trace_bb_distance(i64 11000)
+; CHECK: z:
+; CHECK: call void @__aflgo_trace_bb_distance(i64 10000)
+entry:
+  br i1 %a, label %x, label %y
+
+x:
+  br label %y
+
+y:
+  br i1 %b, label %x, label %z
+
+z:
+  %r = call i32 @target(i32 0)
+  ret void
+}
+
+declare void @__aflgo_trace_bb_target(i32)
+
+!0 = !{!"libaflgo.target"}
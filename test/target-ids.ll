@@ -1,5 +1,11 @@
 ; RUN: %opt_aflgo_linker -passes='instrument-linker-aflgo' -S %s | %FileCheck %s
 
+; CHECK: @__aflgo_target_location = private {{.*}} c"/home/egeretto/Downloads/ir_test/test.c:1\00"
+; CHECK: @__aflgo_target_location.1 = private {{.*}} c"/home/egeretto/Downloads/ir_test/test.c:2\00"
+; CHECK: @__aflgo_target_locations = private constant [2 x i8*]
+; CHECK: @__aflgo_targets_count = private constant i32 2
+; CHECK: @llvm.global_ctors = appending global {{.+}} { i32 101, void ()* @aflgo.module_ctor_targets, i8* null }
+
 ; ModuleID = 'test.c'
 source_filename = "test.c"
 target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
@@ -46,6 +52,10 @@ define dso_local void @caller2() #0 !dbg !18 {
 
 declare void @__aflgo_trace_bb_target(i32)
 
+; CHECK-LABEL: define internal void @aflgo.module_ctor_targets()
+; CHECK-NEXT: [[COUNT:%.+]] = load i32, i32* @__aflgo_targets_count
+; CHECK-NEXT: call void @__aflgo_register_targets(i32 [[COUNT]], i8** {{.*}}@__aflgo_target_locations
+
 attributes #0 = { noinline nounwind optnone uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
 
 !llvm.dbg.cu = !{!0}